@@ -13,7 +13,106 @@
 #include <cassert>
 #include "cardmatic_cardpos.h"  // header file for methods
 #include "cardmatic_globals.h"  // global variables
+#include "cardmatic_recipe.h"   // standard test recipes
 #include <algorithm>
+#include <type_traits>
+
+
+
+//------------------------------------------------------------------------------
+// Test tables
+//------------------------------------------------------------------------------
+
+// standard recipe of each test, in TestKind order.  See RECIPE_FILE
+static const char* const TEST_RECIPES[TubeTests::NUM_TEST_KINDS] = {
+    "triode", "pentode", "heptode", "knee", "multivibrator", "hv_rectifier",
+    "hv_diode", "hp_detector_diode", "voltage_regulator", "short", "gas",
+};
+
+
+// fault of each RecipeParameter when the tester cannot set its value
+static const unsigned int PARAMETER_FAULTS[NUM_RECIPE_PARAMETERS] = {
+    TEST_FAULT_HEATER, TEST_FAULT_BIAS, TEST_FAULT_BPLUS, TEST_FAULT_GM,
+    TEST_FAULT_METER, TEST_FAULT_LOAD,
+};
+
+
+// helper to look up a standard recipe
+// returns: compiled recipe, or NULL if there is none
+static const SwitchProgram* testProgram(const std::string &recipe)
+{
+    return RecipeCompiler::standard().findProgram(recipe);
+}
+
+
+
+// maximum rated current in mA of the regulated B+ supply, indexed by
+//  B+ / V_REGBPLUS_INC.  Entry 0 is not a B+ step
+static constexpr unsigned int REG_BPLUS_MAX_CURRENT_WE[
+    V_REGBPLUS_MAX / V_REGBPLUS_INC + 1] = {
+    0,
+    69, 72, 75, 76, 80, 82, 86, 90, 95, 100,            // 10 - 100V
+    110, 119, 129, 140, 140, 129, 120, 110, 102, 94,    // 110 - 200V
+    85, 77, 68, 60, 50, 42,                             // 210 - 260V
+};
+
+static constexpr unsigned int REG_BPLUS_MAX_CURRENT_118[
+    V_REGBPLUS_MAX / V_REGBPLUS_INC + 1] = {
+    0,
+    69, 72, 75, 76, 80, 82, 86, 90, 95, 100,            // 10 - 100V
+    110, 120, 130, 140, 138, 129, 120, 110, 102, 94,    // 110 - 200V
+    85, 77, 68, 60, 50, 42,                             // 210 - 260V
+};
+
+// ratings of the model built for
+#if CARDMATIC_MODEL == 118
+static constexpr const unsigned int* REG_BPLUS_MAX_CURRENT =
+    REG_BPLUS_MAX_CURRENT_118;
+#elif CARDMATIC_MODEL == 15784 || CARDMATIC_MODEL == 1234
+static constexpr const unsigned int* REG_BPLUS_MAX_CURRENT =
+    REG_BPLUS_MAX_CURRENT_WE;
+#endif
+
+
+// limits of each tester model
+static const ModelLimits MODEL_LIMITS[] = {
+    {15784, "KS15784", V_BIAS_MAX_WE, REG_BPLUS_MAX_CURRENT_WE,
+        I_NOM_HC_LEAKAGE_150},
+    {1234, "1234", V_BIAS_MAX_WE, REG_BPLUS_MAX_CURRENT_WE,
+        I_NOM_HC_LEAKAGE_150},
+    {118, "USM118", V_BIAS_MAX_118, REG_BPLUS_MAX_CURRENT_118,
+        I_NOM_HC_LEAKAGE_165},
+};
+
+
+
+// decade resistor rows, highest decade first.  Row switches start at ROW_13;
+//  closing a switch shorts its resistor out, opening switch ROW_13 + k puts
+//  (k + 1) * ohms in series
+typedef struct DecadeRow
+{
+    char letter;
+    unsigned int ohms;
+    unsigned int numSwitches;
+    unsigned int maxDigit;
+    const unsigned char* digitSwitches;     // switches opened per digit,
+                                            // bit k = ROW_13 + k
+}DecadeRow;
+
+static const unsigned char DIGIT_SWITCHES_3[7] = {
+    0x0, 0x1, 0x2, 0x4, 0x5, 0x6, 0x7,      // 3, 3+1, 3+2, 3+2+1
+};
+
+static const unsigned char DIGIT_SWITCHES_4[11] = {
+    0x0, 0x1, 0x2, 0x4, 0x8, 0x9, 0xA, 0xC, 0xD, 0xE, 0xF,
+};
+
+static const DecadeRow DECADE_ROWS[] = {
+    {'G', 10000, 3, 6, DIGIT_SWITCHES_3},
+    {'F', 1000, 4, 10, DIGIT_SWITCHES_4},
+    {'E', 100, 4, 10, DIGIT_SWITCHES_4},
+    {'D', 10, 4, 10, DIGIT_SWITCHES_4},
+};
 
 
 
@@ -36,8 +135,7 @@
 //          filMinus - negative filament pin
 //          filCommon - common filament pin`
 //          string socket - socket base type
-// post: member variables m_tubeID, m_sections, m_filament, and m_socket are 
-//          initialized.
+// post: member variables m_tubeID, m_pinout and m_socket are initialized.
 Tube::Tube(const std::string tubeID,
            char grid,
            char cathode,
@@ -50,8 +148,8 @@ Tube::Tube(const std::string tubeID,
            char filCommon,
            const std::string socket) :
     m_tubeID(tubeID),
-    m_sections{ {grid, cathode, screen, suppressor, plate, aux} },
-    m_filament{filPlus, filMinus, filCommon},
+    m_pinout{{{grid, cathode, screen, suppressor, plate, aux}}, 1,
+        {filPlus, filMinus, filCommon}},
     m_socket(socket)
 {
 
@@ -71,8 +169,8 @@ Tube::Tube(const std::string tubeID,
            std::tuple<char, char, char> filament,
            const std::string socket) :                    
     m_tubeID(tubeID),
-    m_sections{ts},
-    m_filament{filament},
+    m_pinout{{ts}, 1, {std::get<FIL_POS>(filament),
+        std::get<FIL_NEG>(filament), std::get<FIL_COM>(filament)}},
     m_socket(socket)
 {
 
@@ -80,20 +178,24 @@ Tube::Tube(const std::string tubeID,
 
 //------------------------------------------------------------------------------
 
-// destructor
-Tube::~Tube()
+// constructor from a pinout
+//i.e. Tube("ECC83", BaseB9A::pinout(...), "B9A")
+Tube::Tube(const std::string tubeID,
+           const TubePinout &pinout,
+           const std::string socket) :
+    m_tubeID(tubeID),
+    m_pinout(pinout),
+    m_socket(socket)
 {
 
 }
 
 //------------------------------------------------------------------------------
 
-// helper to append a non-null string to a string
-// used in tubePinsAreValid() only
-void Tube::appendCharToString(char ch, 
-                              std::string &str)
+// destructor
+Tube::~Tube()
 {
-    if(ch != '\0') { str.push_back(ch); }
+
 }
 
 //------------------------------------------------------------------------------
@@ -105,101 +207,145 @@ void Tube::appendCharToString(char ch,
 //          TUBE_PINS_NOT_UNIQUE, or 
 //          TUBE_NULL_SECTION
 int Tube::tubePinsAreValid()
-{   
-    std::string s;
-    
-    for (size_t j = 0; j < m_sections.size(); j++ )
-    {   
+{
+    return diagnosePins().status;
+}
+
+//------------------------------------------------------------------------------
+
+// Function to check tube pin assignments like tubePinsAreValid(), telling
+//  which pin and roles are at fault.  Each section and the filament are
+//  folded into a mask of pin bits; a repeated pin leaves the mask with fewer
+//  bits than pins
+// returns: diagnostic of the first fault, or status TUBE_PINS_OK
+Tube::PinDiagnostic Tube::diagnosePins() const
+{
+    PinDiagnostic diagnostic = {TUBE_PINS_OK, 0, '\0', 0};
+
+    if (m_pinout.numSections == 0)
+    {
+        diagnostic.status = TUBE_NULL_SECTION;
+        return diagnostic;
+    }
+
+    for (unsigned int j = 0; j < m_pinout.numSections; j++)
+    {
+        const TubeSection &ts = m_pinout.sections[j];
+        const char pins[NUM_PIN_ROLES] = {
+            ts.grid, ts.cathode, ts.screen, ts.suppressor, ts.plate, ts.aux,
+            m_pinout.filament[FIL_POS], m_pinout.filament[FIL_NEG],
+            m_pinout.filament[FIL_COM],
+        };
+
+        diagnostic.section = j;
+
         // make sure that pin cap cannot be a grid, screen plate or aux
-        // as Cardmatic does not allow this
-        if (m_sections.at(j).grid == PIN_CAP || 
-            m_sections.at(j).screen == PIN_CAP || 
-            m_sections.at(j).plate == PIN_CAP || 
-            m_sections.at(j).aux == PIN_9 || 
-            m_sections.at(j).aux == PIN_CAP)
+        // as Cardmatic does not allow this.  Letters must be in set =
+        // {A...K} - {I}
+        uint16_t mask = 0;
+        unsigned int numPins = 0;
+
+        for (unsigned int r = 0; r < NUM_PIN_ROLES; r++)
         {
-            return TUBE_INVALID_PIN_ASSIGN;
+            uint16_t bit = pinBit(pins[r]);
+            bool capNotAllowed = pins[r] == PIN_CAP &&
+                (r == ROLE_GRID || r == ROLE_SCREEN || r == ROLE_PLATE ||
+                 r == ROLE_AUX);
+
+            if ((bit & TUBE_PIN_INVALID) || capNotAllowed ||
+                (r == ROLE_AUX && pins[r] == PIN_9))
+            {
+                diagnostic.status = TUBE_INVALID_PIN_ASSIGN;
+                diagnostic.pin = pins[r];
+                diagnostic.roles = 1 << r;
+                return diagnostic;
+            }
+
+            mask |= bit;
+            numPins += bit != 0;
         }
-    
-    
-    
-        // figure out if there a duplicate pin assignment exists
-        appendCharToString(m_sections.at(j).grid, s);
-        appendCharToString(m_sections.at(j).cathode, s);
-        appendCharToString(m_sections.at(j).screen, s);
-        appendCharToString(m_sections.at(j).suppressor, s);
-        appendCharToString(m_sections.at(j).plate, s);
-        appendCharToString(m_sections.at(j).aux, s);
-        appendCharToString(std::get<FIL_POS>(m_filament), s);
-        appendCharToString(std::get<FIL_NEG>(m_filament), s);
-        appendCharToString(std::get<FIL_COM>(m_filament), s);
-        
-        
-        for (size_t i = 0; i < s.size(); i++)
+
+        if (SwitchMatrix::popCount(mask) == numPins) { continue; }
+
+
+        // find the first repeated pin and every role claiming it
+        uint16_t seen = 0;
+        unsigned int r = 0;
+        while ((seen & pinBit(pins[r])) == 0)
         {
-            // make sure the letters are in set = {A...L} - {I}
-            if (s.at(i) < 'A' && s.at(i) > 'L' && s.at(i) == 'I')
-            { 
-                return TUBE_INVALID_PIN_ASSIGN;  // invalid cardmatic pins
-            }
+            seen |= pinBit(pins[r]);
+            r++;
         }
-        
-//        std::cout << "s contains: " << s << " size = " << s.size() << std::endl;        
-        std::sort(s.begin(), s.end() );        
-//        std::cout << "s contains: " << s << " size = " << s.size() << std::endl;
 
-        if (std::unique(s.begin(), s.end()) == s.end() )
+        diagnostic.status = TUBE_PINS_NOT_UNIQUE;
+        diagnostic.pin = pins[r];
+
+        for (unsigned int k = 0; k < NUM_PIN_ROLES; k++)
         {
-            return TUBE_PINS_OK;
+            if (pins[k] == pins[r]) { diagnostic.roles |= 1 << k; }
         }
-        
-        return TUBE_PINS_NOT_UNIQUE;   // not unique
+
+        return diagnostic;
     }
-    
-    return TUBE_NULL_SECTION;  // invalid section
+
+    return diagnostic;
 }
 
 //------------------------------------------------------------------------------
 
+// returns: name of a role, i.e. "grid"
+const char* Tube::roleName(PinRole role)
+{
+    static const char* const ROLE_NAMES[NUM_PIN_ROLES] = {
+        "grid", "cathode", "screen", "suppressor", "plate", "aux",
+        "heater+", "heater-", "heater centre tap",
+    };
 
-// helper to append a tube section to the vector
+    return role < NUM_PIN_ROLES ? ROLE_NAMES[role] : "unknown";
+}
+
+//------------------------------------------------------------------------------
+
+
+// helper to append a tube section to the pinout
 // pre:     grid = pin 1...9
 //          cathode = pin 1...9, Top cap
 //          screen = pin 1...9
 //          suppressor = pin 1...9, Top cap
 //          plate = pin 1...9
 //          aux = pin 1...8
-//          m_sections.size() >= 1
+//          m_pinout.numSections >= 1
 // param:   grid - grid pin
 //          cathode - cathode pin
 //          screen - screen pin
 //          suppressor - suppressor pin
 //          plate - plate 
 //          aux - auxiliary pin
+// returns: false if the tube already has TUBE_MAX_SECTIONS sections
 // post: contents of tube are updated
-void Tube::appendTubeSection(char grid,
+bool Tube::appendTubeSection(char grid,
                              char cathode,
                              char screen,
                              char suppressor,
                              char plate,
                              char aux)
 {   
-    m_sections.push_back( {grid, cathode, screen, suppressor, plate, aux} );
+    return m_pinout.append({grid, cathode, screen, suppressor, plate, aux});
 }
 
 //------------------------------------------------------------------------------
 
 // alternative version of the above 
 // but a TubeSection struct is passed instead
-void Tube::appendTubeSection(TubeSection ts)
+bool Tube::appendTubeSection(TubeSection ts)
 {
-    m_sections.push_back(ts);
+    return m_pinout.append(ts);
 }
 
 //------------------------------------------------------------------------------
 
 // function to activate switches corresponding to single section of a tube
-// pre: m_sections.size() > 0
+// pre: m_pinout.numSections > 0
 // post: required switches are activated
 // see WE Cardmatic manual, sections 5.43-5.50 for more details
 void Tube::setSingleTubeSectionSwitches(CardReader &switches,
@@ -207,15 +353,15 @@ void Tube::setSingleTubeSectionSwitches(CardReader &switches,
                                         bool hasFilament,
                                         bool isSpecialTube)
 {   
-    char filPlus = std::get<FIL_POS>(m_filament);
-    char filMinus = std::get<FIL_NEG>(m_filament);
-    char filCommon = std::get<FIL_COM>(m_filament);
+    char filPlus = m_pinout.filament[FIL_POS];
+    char filMinus = m_pinout.filament[FIL_NEG];
+    char filCommon = m_pinout.filament[FIL_COM];
 
     if (hasFilament)
     {
         switches.insert(std::make_pair(filPlus, ROW_1));
         
-        if (std::get<FIL_COM>(m_filament) == '\0')  // if no center tap component
+        if (m_pinout.filament[FIL_COM] == '\0')  // if no center tap component
         {
             switches.insert(std::make_pair(filMinus, ROW_2));            
         }
@@ -231,27 +377,27 @@ void Tube::setSingleTubeSectionSwitches(CardReader &switches,
     
     if (tubeType >= DIODE)
     {
-        switches.insert(std::make_pair(m_sections.front().plate, ROW_7));
-        switches.insert(std::make_pair(m_sections.front().cathode, ROW_4));
+        switches.insert(std::make_pair(m_pinout.front().plate, ROW_7));
+        switches.insert(std::make_pair(m_pinout.front().cathode, ROW_4));
         
         if (tubeType >= TRIODE)
         {
-            switches.insert(std::make_pair(m_sections.front().grid, ROW_3));
+            switches.insert(std::make_pair(m_pinout.front().grid, ROW_3));
         }
         
         if (tubeType >= TETRODE)
         {
-            switches.insert(std::make_pair(m_sections.front().screen, ROW_5));
+            switches.insert(std::make_pair(m_pinout.front().screen, ROW_5));
         }
         
         if (tubeType >= PENTODE)
         {
-            switches.insert(std::make_pair(m_sections.front().suppressor, ROW_6));
+            switches.insert(std::make_pair(m_pinout.front().suppressor, ROW_6));
         }
         
         if (isSpecialTube)
         {
-            switches.insert(std::make_pair(m_sections.front().aux, ROW_8));
+            switches.insert(std::make_pair(m_pinout.front().aux, ROW_8));
         }
     }
 }
@@ -260,7 +406,7 @@ void Tube::setSingleTubeSectionSwitches(CardReader &switches,
 
 // function to activate switches corresponding to second section of a tube
 // pre: tube.sections.size() > 0
-// assert: assert(m_sections.front().cathode == m_sections.back().cathode) if common cathode
+// assert: assert(m_pinout.front().cathode == m_pinout.back().cathode) if common cathode
 // post: required switches are activated
 // see WE Cardmatic manual, sections 5.51 for more details
 void Tube::setTwinTubeSectionSwitches(CardReader &switches,
@@ -269,7 +415,7 @@ void Tube::setTwinTubeSectionSwitches(CardReader &switches,
 {
     if (tubeType != DIODE || tubeType != TRIODE) { return; }
     if (isCommonCathode && 
-        m_sections.front().cathode != m_sections.back().cathode) { return; }
+        m_pinout.front().cathode != m_pinout.back().cathode) { return; }
 
     // connection for first section of tube
     setSingleTubeSectionSwitches(switches, tubeType, true, false);
@@ -277,12 +423,12 @@ void Tube::setTwinTubeSectionSwitches(CardReader &switches,
 
     // connection for second section of tube
     // to accomodate buttton No. 4 interchange mapping
-    switches.insert(std::make_pair(m_sections.back().plate, ROW_5));
-    switches.insert(std::make_pair(m_sections.back().cathode, ROW_8));    
+    switches.insert(std::make_pair(m_pinout.back().plate, ROW_5));
+    switches.insert(std::make_pair(m_pinout.back().cathode, ROW_8));    
 
     if (tubeType == TRIODE)
     {
-        switches.insert(std::make_pair(m_sections.back().grid, ROW_6));
+        switches.insert(std::make_pair(m_pinout.back().grid, ROW_6));
     }    
 }
 
@@ -294,54 +440,502 @@ void Tube::setTwinTubeSectionSwitches(CardReader &switches,
 // Public methods
 //------------------------------------------------------------------------------
 
+// the implicit moves keep a std::vector of TubeTests from copying cardreaders
+static_assert(std::is_nothrow_move_constructible<TubeTests>::value &&
+              std::is_nothrow_move_assignable<TubeTests>::value,
+              "TubeTests is not nothrow movable");
+
 TubeTests::TubeTests() :
-    #if CARDMATIC_MODEL == 15784 || CARDMATIC_MODEL == 1234
-    m_regulated_Bplus_maxCurrentParameters{
-        {V_REGBPLUS_MIN, 69}, {20, 72}, {30, 75}, {40, 76},
-        {V_REGBPLUS_50, 80},  {60, 82}, {70, 86}, {80, 90},
-        {90, 95}, {100, 100}, {V_REGBPLUS_110, 110}, {120, 119}, 
-        {130, 129}, {140, 140}, {150, 140}, {V_REGBPLUS_160, 129}, 
-        {170, 120}, {180, 110}, {190, 102}, {200, 94}, 
-        {V_REGBPLUS_210, 85}, {220, 77}, {230, 68}, {240, 60}, 
-        {250, 50}, {V_REGBPLUS_MAX, 42}
+    m_param(),
+    m_program(NULL)
+{
+
+}
+
+
+//------------------------------------------------------------------------------
+
+// triode gm test
+//  1. if fixed bias (cathode grounded), ac + negative bias applied to grid
+//  2. else if self-bias, ac applied to grid.  ground through bias cap and
+//     shunt resistor
+//  3. plate connected to gm bridge, which is connected to B+
+bool TubeTests::triodeTest()
+{
+    return runTest(TRIODE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// pentode gm test, as triode test but screen connected to B+.  Suppressor
+//  follows the pin switches
+bool TubeTests::pentodeTest()
+{
+    return runTest(PENTODE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// heptode conversion gm test, plate to gm bridge, bias and ac signal on the
+//  control grid, screen connected to B+
+bool TubeTests::heptodeTest()
+{
+    return runTest(HEPTODE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// power pentode knee test, plate current at zero bias with screen connected
+//  to B+, plate supply through the limiting resistor
+bool TubeTests::kneeTest()
+{
+    return runTest(KNEE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// computer triode on test, plate current at zero bias
+bool TubeTests::multivibratorTest()
+{
+    return runTest(MULTIVIBRATOR_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// high voltage rectifier test, HT to plate, cathode to load resistor and
+//  filter capacitor, meter in series with load
+bool TubeTests::highVoltageRectifierTest()
+{
+    return runTest(HV_RECTIFIER_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// high voltage diode test, plate current from auxiliary B+
+bool TubeTests::highVoltageDiodeTest()
+{
+    return runTest(HV_DIODE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// high perveance detector diode test, plate current from regulated B+
+//  through the limiting resistor
+bool TubeTests::highPerveanceDetectorDiodeTest()
+{
+    return runTest(HP_DETECTOR_DIODE_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// voltage regulator test, cold cathode tube fired from regulated B+ through
+//  the limiting resistor, no heater
+bool TubeTests::votageRegulatorTest()
+{
+    return runTest(VOLTAGE_REGULATOR_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// short test, heater only.  Shorts show on the pin switches' lamps
+bool TubeTests::shortTest()
+{
+    return runTest(SHORT_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// gas test, plate current with dc bias and no signal on the grid
+bool TubeTests::gasTest()
+{
+    return runTest(GAS_TEST);
+}
+
+//------------------------------------------------------------------------------
+
+// function to run a test by kind, shared by the test functions above
+// param:   kind - test to set up
+// returns: false if kind is not a test or has no standard recipe, see test
+//          functions otherwise
+bool TubeTests::runTest(TestKind kind)
+{
+    const char* recipe = testRecipe(kind);
+    return recipe != NULL && runTest(std::string(recipe));
+}
+
+//------------------------------------------------------------------------------
+
+// function to run a test by the name of its standard recipe.  Switches closed
+//  before the call are kept as the pin map slice, each subsystem of the
+//  recipe is then run into its own slice and the slices are merged into the
+//  card
+// pre: setTestParam() is called with the section's test conditions
+// param:   recipe - standard recipe of the test, i.e. from selectTest()
+// returns: false if there is no such recipe or a test condition is out of
+//          range for the tester, switches are then unchanged.  True otherwise
+bool TubeTests::runTest(const std::string &recipe)
+{
+    const SwitchProgram* program = testProgram(recipe);
+
+    // check all conditions first so a failed test leaves the switches alone
+    if (program == NULL || programFaults(*program, m_param) != 0)
+    {
+        return false;
     }
-    
-    #elif CARDMATIC_MODEL == 118
-    m_regulated_Bplus_maxCurrentParameters{
-        {V_REGBPLUS_MIN, 69}, {20, 72}, {30, 75}, {40, 76},
-        {V_REGBPLUS_50, 80}, {60, 82}, {70, 86}, {80, 90},
-        {90, 95}, {100, 100}, {V_REGBPLUS_110, 110}, {120, 120}, 
-        {130, 130}, {140, 140}, {150, 138}, {V_REGBPLUS_160, 129}, 
-        {170, 120}, {180, 110}, {190, 102}, {200, 94}, 
-        {V_REGBPLUS_210, 85}, {220, 77}, {230, 68}, {240, 60}, 
-        {250, 50}, {V_REGBPLUS_MAX, 42} 
+
+
+    SwitchSlice &pins = m_slices[SUBSYSTEM_PINS];
+    pins.close = SwitchMatrix(m_switches);
+    pins.open = SwitchMatrix();
+    pins.invalid.clear();
+
+    for (auto it = m_switches.begin(); it != m_switches.end(); it++)
+    {
+        if (SwitchMatrix::switchIndex(it->first, it->second) < 0)
+        {
+            pins.invalid.insert(*it);
+        }
+    }
+
+    m_program = program;
+    RecipeValues values = SwitchProgram::values(m_param);
+
+    for (int s = SUBSYSTEM_PINS + 1; s < NUM_SUBSYSTEMS; s++)
+    {
+        program->execute(values, static_cast<Subsystem>(s), m_slices[s]);
     }
-    #endif
+
+    mergeSlices();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to change the test conditions of the last runTest() and
+//  recompute only the slices of the subsystems whose recipe steps take a
+//  changed condition
+// pre: runTest() succeeded since the last resetSwitches()
+// param:   param - new test conditions
+// returns: false if no test was run or a condition is out of range,
+//          switches and conditions are then unchanged.  True otherwise
+bool TubeTests::updateTestParam(const TestParam &param)
 {
+    if (m_program == NULL || programFaults(*m_program, param) != 0)
+    {
+        return false;
+    }
 
+    RecipeValues values = SwitchProgram::values(param);
+    unsigned int changed = SwitchProgram::inputBits(values,
+        SwitchProgram::values(m_param));
+
+    m_param = param;
+
+
+    // the current only sets the B+ limit, no step takes it
+    bool dirty = false;
+    for (int s = SUBSYSTEM_PINS + 1; s < NUM_SUBSYSTEMS; s++)
+    {
+        if (m_program->getInputs(static_cast<Subsystem>(s)) & changed)
+        {
+            m_program->execute(values, static_cast<Subsystem>(s),
+                m_slices[s]);
+            dirty = true;
+        }
+    }
+
+    if (dirty) { mergeSlices(); }
+    return true;
 }
 
 //------------------------------------------------------------------------------
 
-// destructor
-TubeTests::~TubeTests()
+// function to save the card and its test conditions
+// returns: checkpoint for rollback()
+TubeTests::CardCheckpoint TubeTests::checkpoint() const
+{
+    CardCheckpoint saved;
+    std::copy(m_slices, m_slices + NUM_SUBSYSTEMS, saved.slices);
+    saved.param = m_param;
+    saved.program = m_program;
+    return saved;
+}
+
+//------------------------------------------------------------------------------
+
+// function to restore a card saved by checkpoint()
+// param:   saved - checkpoint of this or another TubeTests
+// post: slices, test conditions and switches are those of the checkpoint
+void TubeTests::rollback(const CardCheckpoint &saved)
+{
+    std::copy(saved.slices, saved.slices + NUM_SUBSYSTEMS, m_slices);
+    m_param = saved.param;
+    m_program = saved.program;
+    mergeSlices();
+}
+
+//------------------------------------------------------------------------------
+
+// functions to check test conditions against the tester's ranges, only the
+//  conditions the steps of the test's recipe take are checked
+// param:   kind, recipe - test the conditions are for
+//          param - test conditions
+// returns: TEST_FAULT_* bits of the conditions out of range, 0 if none.
+//          TEST_FAULT_ALL if the test has no standard recipe
+unsigned int TubeTests::testParamFaults(TestKind kind,
+                                        const TestParam &param)
+{
+    const char* recipe = testRecipe(kind);
+    return recipe == NULL ? TEST_FAULT_ALL :
+        testParamFaults(std::string(recipe), param);
+}
+
+unsigned int TubeTests::testParamFaults(const std::string &recipe,
+                                        const TestParam &param)
+{
+    const SwitchProgram* program = testProgram(recipe);
+    return program == NULL ? TEST_FAULT_ALL : programFaults(*program, param);
+}
+
+//------------------------------------------------------------------------------
+
+// returns: name of the standard recipe of a test kind, or NULL if kind is
+//          not a test
+const char* TubeTests::testRecipe(TestKind kind)
+{
+    if (kind < 0 || kind >= NUM_TEST_KINDS) { return NULL; }
+    return TEST_RECIPES[kind];
+}
+
+//------------------------------------------------------------------------------
+
+// returns: true if the standard recipes have a recipe of this name
+bool TubeTests::hasTest(const std::string &recipe)
+{
+    return testProgram(recipe) != NULL;
+}
+
+//------------------------------------------------------------------------------
+
+// function to pick the test of a tube section from the "tests" lines of the
+//  standard recipes
+// param:   tubeType - type of the section
+//          sectionCode - AVO CLASS code of the section, i.e. "T", "THY", or
+//              "" for the default test of tubeType
+//          recipe - set to the standard recipe of the test
+// returns: false if no test exists for the section
+bool TubeTests::selectTest(Tube::TubeType tubeType,
+                           const std::string &sectionCode,
+                           std::string &recipe)
+{
+    for (auto &section : RecipeCompiler::standard().getSections())
+    {
+        if (section.tubeType == tubeType && section.code == sectionCode)
+        {
+            recipe = section.recipe;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+// function to pick the test of a row of AVO test data.  Rows of a tube test
+//  its amplifier sections in CLASS order, diodes and rectifiers are only
+//  tested if the tube has nothing else
+// param:   avoClass - AVO CLASS of the tube, i.e. "DDT" or "TP"
+//          section - row number of the tube, starting at 0
+//          tubeType - set to the type of the tested section
+//          recipe - set to the standard recipe of the test
+// returns: false if avoClass has a code no recipe tests
+bool TubeTests::avoSectionTest(const std::string &avoClass,
+                               unsigned int section,
+                               Tube::TubeType &tubeType,
+                               std::string &recipe)
+{
+    const std::vector<RecipeSection> &sections =
+        RecipeCompiler::standard().getSections();
+    std::vector<const RecipeSection*> amplifiers, diodes;
+
+    // split the class into section codes, longest code first
+    for (size_t pos = 0; pos < avoClass.size(); )
+    {
+        const RecipeSection* match = NULL;
+        for (const RecipeSection &entry : sections)
+        {
+            size_t length = entry.code.size();
+            if (length > 0 && avoClass.compare(pos, length, entry.code) == 0 &&
+                (match == NULL || length > match->code.size()))
+            {
+                match = &entry;
+            }
+        }
+
+        if (match == NULL) { return false; }
+
+        if (match->tubeType == Tube::DIODE) { diodes.push_back(match); }
+        else { amplifiers.push_back(match); }
+
+        pos += match->code.size();
+    }
+
+    const std::vector<const RecipeSection*> &tested =
+        amplifiers.empty() ? diodes : amplifiers;
+    if (tested.empty()) { return false; }
+
+    // extra rows test the last section again
+    const RecipeSection* entry = tested[std::min<size_t>(section,
+        tested.size() - 1)];
+    tubeType = entry->tubeType;
+    recipe = entry->recipe;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to check test conditions against the steps of a recipe
+// param:   program - compiled recipe of the test
+//          param - test conditions
+// returns: TEST_FAULT_* bits of the conditions out of range, 0 if none
+unsigned int TubeTests::programFaults(const SwitchProgram &program,
+                                      const TestParam &param)
+{
+    RecipeValues values = SwitchProgram::values(param);
+    unsigned int bad = program.badParameters(values);
+    unsigned int faults = 0;
+
+    for (int p = 0; p < NUM_RECIPE_PARAMETERS; p++)
+    {
+        if (bad & (1 << p)) { faults |= PARAMETER_FAULTS[p]; }
+    }
+
+    // the regulated B+ supply is rated for the plate current
+    bool regulatedBplus = program.usedParameters(values) &
+        (1 << RECIPE_BPLUS);
+    if (regulatedBplus && !(bad & (1 << RECIPE_BPLUS)) &&
+        !B_plusCurrentCheck(param.bPlus, std::ceil(param.current)))
+    {
+        faults |= TEST_FAULT_BPLUS_CURRENT;
+    }
+
+    return faults;
+}
+
+//------------------------------------------------------------------------------
+
+// function to look up the limits of a tester model
+// param:   model - model number, i.e. 15784, 1234 or 118
+// returns: limits, or NULL if the model is unknown
+const ModelLimits* TubeTests::modelLimits(unsigned int model)
+{
+    for (auto &limits : MODEL_LIMITS)
+    {
+        if (limits.model == model) { return &limits; }
+    }
+
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+// function to read the regulated B+ back from a card, inverse of
+//  B_plusVolts()
+// returns: B+ set by the range and step switches, or V_REGBPLUS_MAX if no
+//          range switch is closed, which includes cards without regulated B+
+unsigned int TubeTests::cardBPlus(const SwitchMatrix &card)
+{
+    unsigned int vBPlus = V_REGBPLUS_MAX;
+
+    if (card.isClosed('L', ROW_2)) { vBPlus = V_REGBPLUS_210; }
+    else if (card.isClosed('B', ROW_17)) { vBPlus = V_REGBPLUS_160; }
+    else if (card.isClosed('C', ROW_17)) { vBPlus = V_REGBPLUS_110; }
+    else if (card.isClosed('D', ROW_17)) { vBPlus = V_REGBPLUS_50; }
+
+    if (card.isClosed('E', ROW_17)) { vBPlus -= 10; }
+    if (card.isClosed('L', ROW_4)) { vBPlus -= 20; }
+    if (card.isClosed('L', ROW_3)) { vBPlus -= 20; }
+
+    return vBPlus;
+}
+
+//------------------------------------------------------------------------------
+
+// function to read the decade resistor back from a card, inverse of
+//  decadeResistor()
+// param:   card - closed switches
+//          ohms - set to the decade resistor value
+// returns: false if the decade switches hold no decade resistor value
+bool TubeTests::cardDecadeOhms(const SwitchMatrix &card,
+                               unsigned long &ohms)
 {
+    ohms = 0;
+    for (auto &row : DECADE_ROWS)
+    {
+        unsigned char opened = 0;
+        for (unsigned int k = 0; k < row.numSwitches; k++)
+        {
+            if (!card.isClosed(row.letter, ROW_13 + k)) { opened |= 1 << k; }
+        }
 
+        unsigned int digit = 0;
+        while (digit <= row.maxDigit && row.digitSwitches[digit] != opened)
+        {
+            digit++;
+        }
+
+        if (digit > row.maxDigit) { return false; }
+        ohms += digit * row.ohms;
+    }
+
+    return true;
 }
 
 //------------------------------------------------------------------------------
 
-void TubeTests::triodeTest()
+// function to read the grid bias back from a card, inverse of gridBias()
+// param:   card - closed switches
+//          bias - set to the grid bias magnitude in volts
+// returns: false if the card sets no grid bias, or its decade switches hold
+//          no decade resistor value
+bool TubeTests::cardGridBias(const SwitchMatrix &card,
+                             double &bias)
 {
-	/*if amplifying triode - gm
-	1. if fixed bias (cathode grounded) 
-		ac + negative bias applied to grid.  
-	2. else if self-bias
-		ac applied to grid.  ground through bias cap and shunt resistor
-	3. plate connected to gm bridge, which is connected to B+
-	*/
-	
-	
+    // gridBias() always connects the grid supply to the cathode
+    if (!card.isClosed('H', ROW_14) ||
+        !(card.isClosed('K', ROW_13) || card.isClosed('L', ROW_13)))
+    {
+        return false;
+    }
+
+    unsigned long ohms;
+    if (!cardDecadeOhms(card, ohms)) { return false; }
+
+    bias = ohms * V_BIAS_SUPPLY / (BIAS_DIVIDER_RES + ohms);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to read the meter shunt choice back from a card, inverse of
+//  meterShuntValue()
+// returns: choice number, 0 - NUM_POSSIBLE_GM_VALUES - 1
+unsigned int TubeTests::cardMeterShunt(const SwitchMatrix &card)
+{
+    unsigned int choice = 0;
+    unsigned int pChoice = PRIMARY_CHOICE_MAX;
+
+    for (char key = 'K'; pChoice != 0; key--)
+    {
+        if (key == 'I') { continue; }     // skip I
+
+        if (card.isClosed(key, ROW_12)) { choice += pChoice; }
+        pChoice /= 2;
+    }
+
+    return choice;
 }
 
 //------------------------------------------------------------------------------
@@ -360,10 +954,13 @@ void TubeTests::outputSwitchesClosed()
 //------------------------------------------------------------------------------
 
 // helper to reset the state of all switches
-// post: all switches are deactivated
+// post: all switches are deactivated, slices are cleared
 void TubeTests::resetSwitches()
 {
     m_switches.clear();
+    m_program = NULL;
+
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++) { m_slices[s] = SwitchSlice(); }
 }
 
 //------------------------------------------------------------------------------
@@ -444,6 +1041,28 @@ bool TubeTests::searchSwitch(char sLetter,
 
 //------------------------------------------------------------------------------
 
+// helper to fold the slices into m_switches, in Subsystem order
+// post: m_switches holds the card, followed by any invalid switches
+void TubeTests::mergeSlices()
+{
+    SwitchMatrix card;
+
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++)
+    {
+        card.openAll(m_slices[s].open) |= m_slices[s].close;
+    }
+
+    m_switches = card.toCardReader();
+
+    for (int s = 0; s < NUM_SUBSYSTEMS; s++)
+    {
+        m_switches.insert(m_slices[s].invalid.begin(),
+            m_slices[s].invalid.end());
+    }
+}
+
+//------------------------------------------------------------------------------
+
 // function to set up connections for twin triode tubes
 // pre: tube.sections.size() = 2
 //      same filament voltage requested
@@ -483,12 +1102,12 @@ void TubeTests::setTwinTriodeSwitches(double vGrid,
 void TubeTests::setHeaterVolts(double vHeater)
 {
     char ascii_shift = 'A';
-    char tens = ascii_shift + static_cast<unsigned int> (
-        vHeater / V_REGBPLUS_INC) ;   // tens of volts
-    char units = ascii_shift + static_cast<unsigned int> (
-        fmod(vHeater, V_REGBPLUS_INC) ); // units of volts
-    char tenths = ascii_shift + static_cast<unsigned int> (
-        fmod(vHeater,1) * V_REGBPLUS_INC );  // tenths of volts
+    
+    // count in tenths, fmod(6.3, 1) * 10 truncates to 2
+    unsigned long heaterTenths = lround(vHeater / V_HEATER_INC);
+    char tens = ascii_shift + heaterTenths / 100;         // tens of volts
+    char units = ascii_shift + heaterTenths / 10 % 10;    // units of volts
+    char tenths = ascii_shift + heaterTenths % 10;        // tenths of volts
 
     // fix 'no I' switch naming problem
     if (tens >= 'I') { tens++; }
@@ -502,6 +1121,31 @@ void TubeTests::setHeaterVolts(double vHeater)
 
 //------------------------------------------------------------------------------
 
+// helper to select the AC or DC heater supply
+// param:   heaterType - AC_HEATER or DC_HEATER
+// post: required switches are activated
+// See WE Cardmatic manual, section 5.52 for more details
+void TubeTests::heaterSupply(Heater heaterType)
+{
+    if (heaterType == AC_HEATER)
+    {
+        m_switches.insert(std::make_pair('A', ROW_12));  // a12	use AC filament supply
+        m_switches.insert(std::make_pair('B', ROW_15));  // b15	use AC filament supply
+        assertKeyOpen('K', ROW_1);
+        assertKeyOpen('K', ROW_2);
+    }
+
+    else // if (heaterType == DC_HEATER)
+    {
+        m_switches.insert(std::make_pair('K', ROW_1));   // k1	use DC filament supply
+        m_switches.insert(std::make_pair('K', ROW_2));   // k2	use DC filament supply
+        assertKeyOpen('A', ROW_12);
+        assertKeyOpen('B', ROW_15);
+    }
+}
+
+//------------------------------------------------------------------------------
+
 // function to adjust heater settings
 // pre: heater current <= 500mA if DC heater is selected
 //      heater voltage is no more than 12.6V if ctRes is set to 1
@@ -523,21 +1167,7 @@ void TubeTests::adjustHeaterSettings(Tube &tube,
                                      bool filamentary)
 {
     // choose ac or dc heater
-    if (heaterType == AC_HEATER)
-    {
-        m_switches.insert(std::make_pair('A', ROW_12));  // a12	use AC filament supply
-        m_switches.insert(std::make_pair('B', ROW_15));  // b15	use AC filament supply
-        assertKeyOpen('K', ROW_1);
-        assertKeyOpen('K', ROW_2);
-    }
-
-    else // if (heaterType == DC_HEATER)
-    {
-        m_switches.insert(std::make_pair('K', ROW_1));   // k1	use DC filament supply
-        m_switches.insert(std::make_pair('K', ROW_2));   // k2	use DC filament supply
-        assertKeyOpen('A', ROW_12);
-        assertKeyOpen('B', ROW_15);
-    }
+    heaterSupply(heaterType);
 
 
 
@@ -546,7 +1176,7 @@ void TubeTests::adjustHeaterSettings(Tube &tube,
     if (tieFilToCat && ampTube)
     {
         // tie filament to cathode
-        m_switches.insert(std::make_pair(std::get<tube.FIL_NEG>(tube.m_filament), ROW_4));
+        m_switches.insert(std::make_pair(tube.m_pinout.filament[tube.FIL_NEG], ROW_4));
 
         // g17 closed to eliminate
         // DC heater-cathode leakage test voltage
@@ -669,22 +1299,38 @@ void TubeTests::B_plusVolts(unsigned int vBPlus,
 
 //------------------------------------------------------------------------------
 
-// may be replaced with database
 // Function: makes sure the B+ voltage does not exceed maximum allowable currents
-// pre: vBPlus must be 10 - 260 volts in 10 volt increments
 // param:   vBPlus - required B+ voltage
 //          current - maximum current
+// returns: false if current exceeds the rating, or if vBPlus is not
+//          10 - 260 volts in 10 volt increments
 // See WE Cardmatic manual, section 5.54 for more details
 bool TubeTests::B_plusCurrentCheck(unsigned int vBPlus,
                                    unsigned int current)
 {
-    // key = Vreg, element = maximum rated current at Vreg
-    if (current <= m_regulated_Bplus_maxCurrentParameters.find(vBPlus)->second)  // if current <= max rated current
+    return B_plusCurrentCheck(REG_BPLUS_MAX_CURRENT, vBPlus, current);
+}
+
+//------------------------------------------------------------------------------
+
+// function to check a current against the B+ ratings of a model
+// param:   bPlusMaxCurrent - ratings of ModelLimits
+//          vBPlus - required B+ voltage
+//          current - maximum current
+// returns: false if current exceeds the rating, or if vBPlus is not
+//          10 - 260 volts in 10 volt increments
+bool TubeTests::B_plusCurrentCheck(const unsigned int* bPlusMaxCurrent,
+                                   unsigned int vBPlus,
+                                   unsigned int current)
+{
+    if (vBPlus < V_REGBPLUS_MIN || vBPlus > V_REGBPLUS_MAX ||
+        vBPlus % V_REGBPLUS_INC != 0)
     {
-        return true;
+        return false;
     }
 
-    return false;
+    // if current <= max rated current
+    return current <= bPlusMaxCurrent[vBPlus / V_REGBPLUS_INC];
 }
 
 //------------------------------------------------------------------------------
@@ -698,12 +1344,40 @@ bool TubeTests::B_plusCurrentCheck(unsigned int vBPlus,
 // some of the depressed switches mentioned in table in page 27 are incorrect
 void TubeTests::umho_meterShunt(unsigned long gm)
 {
-    unsigned int dChoice;   // desired choice number
+    umhoShunt(umhoShuntSetting(gm));
+}
+
+//------------------------------------------------------------------------------
 
+// function to pick the umhometer shunt of umho_meterShunt()
+// pre: gm is 500 - 128,000
+// param:   gm - mutual conductance
+// returns: shunt choice, plus NUM_POSSIBLE_GM_VALUES on the extended scale
+//          above 26,000 umho
+unsigned int TubeTests::umhoShuntSetting(unsigned long gm)
+{
     if (gm <= METER_FS_GM_MAX_LOW)    // gm from 500 to 26000
     {
-        dChoice = (gm - METER_FS_GM_MIN) / 100;    // desired choice - regular scale gm
+        // desired choice - regular scale gm
+        return (gm - METER_FS_GM_MIN) / METER_FS_GM_INC_LOW;
+    }
+
+    // desired choice - extended scale gm
+    return NUM_POSSIBLE_GM_VALUES + gm / METER_FS_GM_INC_HIGH - 1;
+}
 
+//------------------------------------------------------------------------------
+
+// function to set the umhometer shunt
+// pre: setting < 2 * NUM_POSSIBLE_GM_VALUES
+// param:   setting - shunt from umhoShuntSetting()
+// post: all necessary shunt switches are activated
+void TubeTests::umhoShunt(unsigned int setting)
+{
+    assert(setting < 2 * NUM_POSSIBLE_GM_VALUES);
+
+    if (setting < NUM_POSSIBLE_GM_VALUES)    // gm from 500 to 26000
+    {
         // l12	remove 1070 & 25,340 ohm multiplier resistors
         assertKeyClosed('L', ROW_12); // assert switch L12 is closed
         assertKeyOpen('L', ROW_7); // assert switch L7 is open)
@@ -711,16 +1385,13 @@ void TubeTests::umho_meterShunt(unsigned long gm)
 
     else    // gm > 26,000
     {
-        dChoice = (gm / METER_FS_GM_MIN) - 1;    // desired choice - extended scale gm
-
         // close l7 - shunt the 25,340 ohm mult resistor with the 1070 ohm resistor
         assertKeyClosed('L', ROW_7); // assert switch L7 is closed
         assertKeyOpen('L', ROW_12); // assert switch L12 is open)
     }
 
     // determine meter shunt
-    assert(dChoice < NUM_POSSIBLE_GM_VALUES);
-    meterShuntValue(dChoice);
+    meterShuntValue(setting % NUM_POSSIBLE_GM_VALUES);
 }
 
 //------------------------------------------------------------------------------
@@ -763,35 +1434,72 @@ void TubeTests::meterShuntValue(unsigned int dChoice)
 // see WE Cardmatic manual, section 5.60 for more details
 void TubeTests::ma_meterShunt(unsigned long fsCurrent)
 {
-    unsigned int choice, multiplier;
+    maShunt(maShuntSetting(fsCurrent));
+}
 
+//------------------------------------------------------------------------------
+
+// function to pick the mA meter shunt of ma_meterShunt()
+// pre: fsCurrent is 100 - 510100 uA
+// param:   fsCurrent - current in MICROamperes
+// returns: shunt choice, plus NUM_POSSIBLE_GM_VALUES times the range: 0 up to
+//          5200uA, 1 up to 25600uA, 2 above
+unsigned int TubeTests::maShuntSetting(unsigned long fsCurrent)
+{
+    unsigned int range, multiplier;
 
     if (fsCurrent > METER_FS_I_MAX_MID)    // dc current range > 25600uA
     {
-        assertKeyOpen('L', ROW_7); // assert switch L7 is open
-        assertKeyOpen('L', ROW_12); // assert switch L12 is open
-        multiplier = 100;
-
+        range = 2;
+        multiplier = 1000;  // 510100uA is choice 255
     }
 
-    else if (fsCurrent > METER_FS_I_MAX_LOW &&
-             fsCurrent <= METER_FS_I_MAX_MID)    // dc current range between 5200 and 25600uA
+    else if (fsCurrent > METER_FS_I_MAX_LOW)    // between 5200 and 25600uA
     {
-        m_switches.insert(std::make_pair('L', ROW_7));   // l7	shunts the 25,340 ohm mult resistor with the 1070 ohm resistor
-        assertKeyOpen('L', ROW_12); // assert switch L12 is open
+        range = 1;
         multiplier = 50;
     }
 
     else    // if dc current range between 100 - 5200uA
     {
-        m_switches.insert(std::make_pair('L', ROW_12));  // l12	removes 1070 & 25,340 ohm multiplier resistors
-        assertKeyOpen('L', ROW_7); // assert switch L7 is open
+        range = 0;
         multiplier = 10;
     }
 
+    unsigned int choice = rint((.5 * fsCurrent - 50) / multiplier);
+    return range * NUM_POSSIBLE_GM_VALUES + choice;
+}
+
+//------------------------------------------------------------------------------
+
+// function to set the mA meter shunt
+// pre: setting < 3 * NUM_POSSIBLE_GM_VALUES
+// param:   setting - shunt from maShuntSetting()
+// post: all necessary shunt switches are activated
+void TubeTests::maShunt(unsigned int setting)
+{
+    assert(setting < 3 * NUM_POSSIBLE_GM_VALUES);
+
+    switch (setting / NUM_POSSIBLE_GM_VALUES)
+    {
+        case 2:     // dc current range > 25600uA
+            assertKeyOpen('L', ROW_7); // assert switch L7 is open
+            assertKeyOpen('L', ROW_12); // assert switch L12 is open
+            break;
+
+        case 1:     // dc current range between 5200 and 25600uA
+            m_switches.insert(std::make_pair('L', ROW_7));   // l7	shunts the 25,340 ohm mult resistor with the 1070 ohm resistor
+            assertKeyOpen('L', ROW_12); // assert switch L12 is open
+            break;
+
+        default:    // dc current range between 100 - 5200uA
+            m_switches.insert(std::make_pair('L', ROW_12));  // l12	removes 1070 & 25,340 ohm multiplier resistors
+            assertKeyOpen('L', ROW_7); // assert switch L7 is open
+            break;
+    }
+
     // determine meter shunt
-    choice = rint((.5 * fsCurrent - 50) / multiplier);
-    meterShuntValue(choice);
+    meterShuntValue(setting % NUM_POSSIBLE_GM_VALUES);
 }
 
 //------------------------------------------------------------------------------
@@ -817,61 +1525,38 @@ void TubeTests::plateCurrentTest(unsigned long fsCurrent)
 // pre: max dval = 70000 (71100) in ohms
 //      dval <= 1k can operate <= DECADE_RES_IMAX_1K
 //      1K < dval <= 70K  can operate <= DECADE_RES_VMAX
-// param:   dVal - demanded resistance value
+// param:   dVal - demanded resistance value, rounded to DECADE_RES_INC
+// returns: false if dVal is above DECADE_RES_ALL_OPEN, switches are then
+//          unchanged.  True otherwise
 // post: all unactivated switches correspond to required resistance value
 // see WE Cardmatic manual, sections 5.57, 5.58 for more details
-void TubeTests::decadeResistor(unsigned long dVal)
+bool TubeTests::decadeResistor(unsigned long dVal)
 {
-    // replace sw insert map lines temp map lines if delay is preferred
-    // if controlling switches with microcontrollers
+    // resistance in DECADE_RES_INC steps
+    unsigned long steps = (dVal + DECADE_RES_INC / 2) / DECADE_RES_INC;
+    if (steps > DECADE_RES_ALL_OPEN / DECADE_RES_INC) { return false; }
 
-    char sLetter = 'G';
-    unsigned int i = 1;
-    unsigned int sNumber = 15;
-
-    // determine combination of shunt choices D-G15
-
-//    std::cout << "dVal is " << dVal << endl;
-
-    // first step close all shunt switches
-    unsigned int n = 13;
-    for (char c = 'D'; c <= sLetter; c++)
+    // one digit per row, a row takes what lower rows cannot hold
+    for (unsigned int r = 0; r < sizeof(DECADE_ROWS) / sizeof(DecadeRow); r++)
     {
-        if (c != sLetter && n != 16)
-        {
-            m_switches.insert(std::make_pair(c, n));
-            n++;
-        }
-
-//        std::cout << "works here" << endl;
-    }
-
-    unsigned int pVal = 30000; // max primary resistor value
+        const DecadeRow &row = DECADE_ROWS[r];
+        unsigned long unit = row.ohms / DECADE_RES_INC;
+        unsigned long digit = std::min<unsigned long>(steps / unit,
+            row.maxDigit);
+        steps -= digit * unit;
 
-    // reopen those that correspond to shunt choices
-    while (dVal != 0)
-    {
-        if (dVal >= pVal)
+        for (unsigned int k = 0; k < row.numSwitches; k++)
         {
-            assertKeyOpen(sLetter,sNumber);
-            dVal -= pVal;
-//            std::cout << "pVal is " << pVal << endl;
-//            std::cout << "dVal is " << dVal << endl;
-        }
-
-        sNumber--;
-        pVal -= (10000 / i); // shave pVal by i
+            if (row.digitSwitches[digit] & (1 << k))
+            {
+                assertKeyOpen(row.letter, ROW_13 + k);
+            }
 
-        if (sNumber < 13)
-        {
-            sNumber = 16;
-//            std::cout << "sNumber is " << sNumber << endl;
-            sLetter--;
-            pVal = (4000 / i);
-//            std::cout << "pVal is " << pVal << endl;
-            i *= 10;
+            else { assertKeyClosed(row.letter, ROW_13 + k); }
         }
     }
+
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -881,14 +1566,17 @@ void TubeTests::decadeResistor(unsigned long dVal)
 // param:   vGrid - grid bias required in volts
 //          biasType - FIXED_BIAS or SELF_BIAS
 //          gridSignal - .222V signal input, 1 for yes, 0 for no
+// returns: false if abs(vGrid) > V_BIAS_MAX, switches are then unchanged.
+//          True otherwise
 // post: all necessary bias switches are activated
 // see WE Cardmatic manual, sections 5.57, 5.58 for more details
 bool TubeTests::gridBias(double vGrid,
                          Biasing biasType,
                          bool gridSignal)
 {
-	unsigned int Ec, decade_resistor_value;
-	
+    double ec = std::fabs(vGrid);
+    if (!(ec <= V_BIAS_MAX)) { return false; }
+
     m_switches.insert(std::make_pair('H', ROW_14));  // h14	cathode supply to unreg B+
     m_switches.insert(std::make_pair('A', ROW_16));  // a14	leakage test shunt, +20 microamperes
 
@@ -922,12 +1610,21 @@ bool TubeTests::gridBias(double vGrid,
     }
 
 
-    Ec = abs(vGrid);
-    decade_resistor_value = Ec * 15000 / (150 - Ec);
-    if (Ec > 200 && decade_resistor_value > 2000) { return false; }
-    decadeResistor(decade_resistor_value);
+    return decadeResistor(biasDecadeOhms(ec));
+}
 
-    return true;
+//------------------------------------------------------------------------------
+
+// function to work out the decade resistor gridBias() sets, the lower arm of
+//  the bias divider rounded like CatalogueQuantizer
+// pre: abs(vGrid) <= V_BIAS_MAX
+// param:   vGrid - grid bias required in volts
+// returns: decade resistor ohms, a multiple of DECADE_RES_INC
+unsigned long TubeTests::biasDecadeOhms(double vGrid)
+{
+    double ec = std::fabs(vGrid);
+    double ohms = ec * BIAS_DIVIDER_RES / (V_BIAS_SUPPLY - ec);
+    return std::floor(ohms / DECADE_RES_INC + .5) * DECADE_RES_INC;
 }
 
 //------------------------------------------------------------------------------
@@ -938,16 +1635,12 @@ void TubeTests::leakageTest(Tube &tube,
                             unsigned int reqRejectCurrent,
                             unsigned int section)
 {
-//    list<TubeSection>::iterator it = tube.m_sections.begin();
-    auto it = tube.m_sections.begin();
-
-    for (unsigned int i = 0; i < section; i++)
-        it++;
+    if (section >= tube.m_pinout.numSections) { return; }
 
     if (!searchSwitch('G',ROW_17) &&
-        std::get<tube.FIL_POS>(tube.m_filament) &&
-        std::get<tube.FIL_NEG>(tube.m_filament) &&
-        searchSwitch(it->cathode, 4))
+        tube.m_pinout.filament[tube.FIL_POS] &&
+        tube.m_pinout.filament[tube.FIL_NEG] &&
+        searchSwitch(tube.m_pinout.sections[section].cathode, 4))
     {
         leakageShunt(reqRejectCurrent);
     }
@@ -1109,7 +1802,7 @@ void TubeTests::fullWaveRectifierTest(Tube &tube,
 {
 
     halfWaveRectifierTest(rLoad,maxInvRating,mSensitivity);
-    m_switches.insert(std::make_pair(tube.m_sections.back().plate, ROW_5)); // connect second plate to screen row 5
+    m_switches.insert(std::make_pair(tube.m_pinout.back().plate, ROW_5)); // connect second plate to screen row 5
     assertKeyClosed('L', ROW_15);
     assertKeyClosed('J', ROW_14);   // place 4uf capacitor across load resistance
 }
@@ -1128,8 +1821,8 @@ void TubeTests::damperDiodeTest(Tube &tube,
 {
     halfWaveRectifierTest(rLoad, DAMPER_MAXINVRATING, mSensitivity);
     m_switches.insert(std::make_pair('J', ROW_17));
-    m_switches.insert(std::make_pair(tube.m_sections.front().plate, ROW_5)); // connect plate to screen row 5
-    assertKeyOpen(tube.m_sections.front().plate, ROW_7);   // assuming this means no connection to row 7
+    m_switches.insert(std::make_pair(tube.m_pinout.front().plate, ROW_5)); // connect plate to screen row 5
+    assertKeyOpen(tube.m_pinout.front().plate, ROW_7);   // assuming this means no connection to row 7
     m_switches.insert(std::make_pair('L', ROW_15));
 }
 
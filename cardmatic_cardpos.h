@@ -16,6 +16,38 @@
 #include <vector>
 #include <tuple>
 #include <string>
+#include <cstdint>
+
+
+#define TUBE_MAX_SECTIONS 4     // sections held by a TubePinout
+#define TUBE_PIN_INVALID 0x8000 // pin bit of a letter that is not a pin
+#define TUBE_NUM_PINS 10        // PIN_1...PIN_9 and PIN_CAP
+
+
+// test conditions out of range, see TubeTests::testParamFaults()
+#define TEST_FAULT_HEATER 0x01          // heater volts
+#define TEST_FAULT_BIAS 0x02            // grid bias beyond the decade resistor
+#define TEST_FAULT_BPLUS 0x04           // B+ not 10 - 260V in 10V steps
+#define TEST_FAULT_BPLUS_CURRENT 0x08   // plate current over the B+ rating
+#define TEST_FAULT_GM 0x10              // umhometer full scale
+#define TEST_FAULT_METER 0x20           // current meter full scale
+#define TEST_FAULT_LOAD 0x40            // load resistor
+#define TEST_FAULT_ALL 0x7f             // all of the above, the test has no
+                                        // standard recipe
+
+
+
+// limits that differ between tester models, see TubeTests::modelLimits().
+//  The models share the cardreader and the function of every switch
+typedef struct ModelLimits
+{
+    unsigned int model;             // 15784, 1234 or 118, see CARDMATIC_MODEL
+    const char* name;
+    double vBiasMax;                // maximum grid bias in volts
+    const unsigned int* bPlusMaxCurrent;    // regulated B+ rating in mA,
+                                            // by B+ / V_REGBPLUS_INC
+    unsigned int maxLeakage;        // largest leakage shunt in uA
+}ModelLimits;
 
 
 class Tube
@@ -75,6 +107,31 @@ class Tube
         }TubeFilament;
         
         
+        // pins of a tube, fixed capacity so copies do not allocate.  An
+        //  aggregate, so pinouts can be built as constant expressions
+        typedef struct TubePinout
+        {
+            TubeSection sections[TUBE_MAX_SECTIONS];
+            unsigned int numSections;
+            char filament[3];       // indexed by TubeFilament
+
+            const TubeSection &front() const { return sections[0]; }
+
+            const TubeSection &back() const
+            {
+                return sections[numSections - 1];
+            }
+
+            // returns: false if all TUBE_MAX_SECTIONS are used
+            bool append(const TubeSection &ts)
+            {
+                if (numSections >= TUBE_MAX_SECTIONS) { return false; }
+                sections[numSections++] = ts;
+                return true;
+            }
+        }TubePinout;
+
+
         typedef enum TubeErrorCodes
         {
             TUBE_NULL_SECTION = -2,
@@ -83,6 +140,33 @@ class Tube
             TUBE_PINS_OK,
             
         }TubeErrorCodes;
+
+
+        // roles a pin can have, in TubeSection order then filament
+        typedef enum PinRole
+        {
+            ROLE_GRID,
+            ROLE_CATHODE,
+            ROLE_SCREEN,
+            ROLE_SUPPRESSOR,
+            ROLE_PLATE,
+            ROLE_AUX,
+            ROLE_FIL_POS,
+            ROLE_FIL_NEG,
+            ROLE_FIL_COM,
+            NUM_PIN_ROLES,
+        }PinRole;
+
+
+        // result of a pin check.  On failure, pin is the first pin at fault
+        //  and roles has a bit (1 << PinRole) for every role claiming it
+        typedef struct PinDiagnostic
+        {
+            int status;             // TubeErrorCodes
+            unsigned int section;
+            char pin;               // '\0' if status is TUBE_PINS_OK
+            uint16_t roles;
+        }PinDiagnostic;
         
         
         
@@ -107,6 +191,12 @@ class Tube
              TubeSection ts,
              std::tuple<char, char, char> filament,
              const std::string socket);  // alternative constructor
+
+
+        Tube(const std::string tubeID,
+             const TubePinout &pinout,
+             const std::string socket);  // constructor from a pinout,
+                                         // see TubeBase
         
         
         ~Tube();                         // destructor
@@ -124,8 +214,49 @@ class Tube
         //          TUBE_PINS_NOT_UNIQUE, or 
         //          TUBE_NULL_SECTION
         int tubePinsAreValid(); 
+
+
+        // Function to check tube pin assignments like tubePinsAreValid(),
+        //  telling which pin and roles are at fault
+        // returns: diagnostic of the first fault, or status TUBE_PINS_OK
+        PinDiagnostic diagnosePins() const;
+
+
+        // returns: name of a role, i.e. "grid"
+        static const char* roleName(PinRole role);
     
     
+        // pin bits of a section and the filament, bit 0 = PIN_1 ... bit 9 =
+        //  PIN_CAP, TUBE_PIN_INVALID for a letter that is not a pin
+        // returns: sum of the pin bits, which equals pinMask() only if the
+        //          pins are unique
+        static constexpr uint16_t pinBit(char pin)
+        {
+            return pin == '\0' ? 0 :
+                pin >= PIN_1 && pin <= PIN_CAP && pin != 'I' ?
+                    uint16_t(1u << (pin - PIN_1 - (pin > 'I'))) :
+                    uint16_t(TUBE_PIN_INVALID);
+        }
+
+        static constexpr uint32_t pinSum(const TubeSection &ts,
+                                         const char* filament)
+        {
+            return uint32_t(pinBit(ts.grid)) + pinBit(ts.cathode) +
+                pinBit(ts.screen) + pinBit(ts.suppressor) + pinBit(ts.plate) +
+                pinBit(ts.aux) + pinBit(filament[FIL_POS]) +
+                pinBit(filament[FIL_NEG]) + pinBit(filament[FIL_COM]);
+        }
+
+        static constexpr uint16_t pinMask(const TubeSection &ts,
+                                          const char* filament)
+        {
+            return pinBit(ts.grid) | pinBit(ts.cathode) | pinBit(ts.screen) |
+                pinBit(ts.suppressor) | pinBit(ts.plate) | pinBit(ts.aux) |
+                pinBit(filament[FIL_POS]) | pinBit(filament[FIL_NEG]) |
+                pinBit(filament[FIL_COM]);
+        }
+
+
         // helper to append a tube section to the linked list
         // pre:     grid = pin 1...9
         //          cathode = pin 1...9, Top cap
@@ -140,8 +271,9 @@ class Tube
         //          suppressor - suppressor pin
         //          plate - plate 
         //          aux - auxiliary pin
+        // returns: false if the tube already has TUBE_MAX_SECTIONS sections
         // post: contents of tube are updated
-        void appendTubeSection(char grid,
+        bool appendTubeSection(char grid,
                                char cathode,
                                char screen,
                                char suppressor,
@@ -151,7 +283,8 @@ class Tube
 
         // alternative version of the above 
         // but a TubeSection struct is passed instead
-        void appendTubeSection(TubeSection ts); 
+        // returns: false if the tube already has TUBE_MAX_SECTIONS sections
+        bool appendTubeSection(TubeSection ts); 
                                
         
         // function to activate switches corresponding to single section of a tube
@@ -176,41 +309,93 @@ class Tube
 
     private:
         //----------------------------------------------------------------------
-        //  helpers
+        //  member variables
         //----------------------------------------------------------------------
 
-        // helper to append a non-null string to a string
-        // used in tubePinsAreValid() only
-        void appendCharToString(char ch,
-                                std::string &str);
+        std::string m_tubeID;       // tube nomenclature
+        TubePinout m_pinout;        // (semi)independent tube sections and
+                                    // filament/heater pins; filament[FIL_POS]
+                                    // = +ve, [FIL_NEG] = -ve, [FIL_COM] =
+                                    // center
+        std::string m_socket;       // tube socket
+};
+
 
-    
-    
-        //----------------------------------------------------------------------
-        //  member variables
-        //----------------------------------------------------------------------
 
-        std::string m_tubeID;                       // tube nomenclature
-        std::vector<TubeSection> m_sections;        // (semi)independent tubeSections stored in a vector
-        std::tuple<char, char, char> m_filament;    // filament/heater pins; get<FIL_POS> = +ve, get<FIL_NEG> = -ve, get<FIL_COM> = center
-        std::string m_socket;                       // tube socket
+// pinout templates of common bases.  A base has pins PIN_1...NumPins and a
+//  top cap, i.e.
+//  constexpr Tube::TubePinout ECC83_PINOUT = BaseB9A::pinout(
+//      {Tube::PIN_2, Tube::PIN_3, '\0', '\0', Tube::PIN_1, '\0'},
+//      {Tube::PIN_7, Tube::PIN_8, '\0', '\0', Tube::PIN_6, '\0'},
+//      Tube::PIN_4, Tube::PIN_5, Tube::PIN_9);
+//  static_assert(BaseB9A::fits(ECC83_PINOUT), "ECC83 pins");
+template <unsigned int NumPins>
+struct TubeBase
+{
+    // one bit per pin of the base, see Tube::pinBit()
+    static constexpr uint16_t pins()
+    {
+        return uint16_t(((1u << NumPins) - 1) | Tube::pinBit(Tube::PIN_CAP));
+    }
+
+
+    // returns: true if a section only uses pins of the base, each once
+    static constexpr bool fits(const Tube::TubeSection &ts,
+                               const char* filament)
+    {
+        return (Tube::pinMask(ts, filament) & ~pins()) == 0 &&
+            Tube::pinSum(ts, filament) == Tube::pinMask(ts, filament);
+    }
+
+    // returns: true if every section of a pinout fits the base
+    static constexpr bool fits(const Tube::TubePinout &pinout,
+                               unsigned int section = 0)
+    {
+        return section >= pinout.numSections ||
+            (fits(pinout.sections[section], pinout.filament) &&
+             fits(pinout, section + 1));
+    }
+
+
+    // builds a pinout of one or two sections
+    static constexpr Tube::TubePinout pinout(Tube::TubeSection ts,
+                                             char filPlus,
+                                             char filMinus,
+                                             char filCommon = '\0')
+    {
+        return Tube::TubePinout{{ts}, 1, {filPlus, filMinus, filCommon}};
+    }
+
+    static constexpr Tube::TubePinout pinout(Tube::TubeSection ts1,
+                                             Tube::TubeSection ts2,
+                                             char filPlus,
+                                             char filMinus,
+                                             char filCommon = '\0')
+    {
+        return Tube::TubePinout{{ts1, ts2}, 2,
+            {filPlus, filMinus, filCommon}};
+    }
 };
 
+typedef TubeBase<7> BaseB7G;
+typedef TubeBase<8> BaseOctal;
+typedef TubeBase<9> BaseB9A;
+
 
 
 
 
+class SwitchProgram;    // compiled test recipe, see cardmatic_recipe.h
+
 class TubeTests
 {
     public:
         //----------------------------------------------------------------------
-        //  constructors, destructor, init function
+        //  constructor, init function
         //----------------------------------------------------------------------    
         
         TubeTests();   // constructor
         
-        ~TubeTests();  // destructor
-        
 
         //----------------------------------------------------------------------
         //  enums
@@ -246,6 +431,66 @@ class TubeTests
             DC_HEATER
         }Heater;
 
+
+        // tests with their own functions below, each run by the standard
+        //  recipe of the same name in RECIPE_FILE.  Other recipes of the file
+        //  are run by name
+        typedef enum TestKind
+        {
+            TRIODE_TEST,
+            PENTODE_TEST,
+            HEPTODE_TEST,
+            KNEE_TEST,
+            MULTIVIBRATOR_TEST,
+            HV_RECTIFIER_TEST,
+            HV_DIODE_TEST,
+            HP_DETECTOR_DIODE_TEST,
+            VOLTAGE_REGULATOR_TEST,
+            SHORT_TEST,
+            GAS_TEST,
+            NUM_TEST_KINDS,
+        }TestKind;
+
+
+        // parts of a test card, merged into the card in this order
+        typedef enum Subsystem
+        {
+            SUBSYSTEM_PINS,         // pin map set up before runTest()
+            SUBSYSTEM_HEATER,
+            SUBSYSTEM_BIAS,         // grid bias and decade resistor
+            SUBSYSTEM_BPLUS,
+            SUBSYSTEM_METER,        // meter shunt and test circuit
+            SUBSYSTEM_SWITCH_LIST,  // fixed switches of the test kind
+            SUBSYSTEM_LEAKAGE,
+            NUM_SUBSYSTEMS,
+        }Subsystem;
+
+
+
+        //----------------------------------------------------------------------
+        //  structs
+        //----------------------------------------------------------------------
+
+        // switches a subsystem contributes to the card.  The card is built
+        //  by folding the slices in Subsystem order:
+        //  card = (card with open switches opened) + close switches
+        typedef struct SwitchSlice
+        {
+            SwitchMatrix close;
+            SwitchMatrix open;
+            CardReader invalid;     // closed switches the cardreader does not
+                                    // have, kept so callers can reject them
+        }SwitchSlice;
+
+
+        // state restored by rollback()
+        typedef struct CardCheckpoint
+        {
+            SwitchSlice slices[NUM_SUBSYSTEMS];
+            TestParam param;
+            const SwitchProgram* program;
+        }CardCheckpoint;
+
         
         
         //----------------------------------------------------------------------                                                          
@@ -253,24 +498,161 @@ class TubeTests
         //----------------------------------------------------------------------
 
         // tests possible with Cardmatic testers
-        void triodeTest();
-        void pentodeTest();
-        void heptodeTest();
-        void kneeTest();
-        void multivibratorTest();
-        void highVoltageRectifierTest();
-        void highVoltageDiodeTest();
-        void highPerveanceDetectorDiodeTest();
-        void votageRegulatorTest();
-        void shortTest();
-        void gasTest();
-        
+        // pre: setTestParam() is called with the section's test conditions,
+        //      pin switches are set up with the Tube functions
+        // returns: false if a test condition is out of range for the tester,
+        //          switches are then unchanged.  True otherwise
+        bool triodeTest();
+        bool pentodeTest();
+        bool heptodeTest();
+        bool kneeTest();
+        bool multivibratorTest();
+        bool highVoltageRectifierTest();
+        bool highVoltageDiodeTest();
+        bool highPerveanceDetectorDiodeTest();
+        bool votageRegulatorTest();
+        bool shortTest();
+        bool gasTest();
+
+
+        // functions to run a test by kind, shared by the test functions
+        //  above, or by the name of its standard recipe.  Switches closed
+        //  before the call are kept as the pin map slice, the rest of the
+        //  card is run by the recipe
+        // param:   kind - test to set up
+        //          recipe - standard recipe of the test, i.e. from
+        //              selectTest()
+        // returns: false if the test has no standard recipe, see
+        //          test functions otherwise
+        bool runTest(TestKind kind);
+
+        bool runTest(const std::string &recipe);
+
+
+        // function to change the test conditions of the last runTest() and
+        //  recompute only the slices of the subsystems whose recipe steps
+        //  take a changed condition
+        // pre: runTest() succeeded since the last resetSwitches()
+        // param:   param - new test conditions
+        // returns: false if no test was run or a condition is out of range,
+        //          switches and conditions are then unchanged.  True otherwise
+        bool updateTestParam(const TestParam &param);
+
+
+        // functions to save and restore the card, i.e. before trying out
+        //  test conditions with updateTestParam()
+        CardCheckpoint checkpoint() const;
+
+        void rollback(const CardCheckpoint &saved);
+
+
+        // returns: switches closed by a subsystem in the last runTest() or
+        //          updateTestParam()
+        const SwitchMatrix &getSlice(Subsystem subsystem) const
+        {
+            return m_slices[subsystem].close;
+        }
+
+
+        // functions to check test conditions against the tester's ranges,
+        //  only the conditions the test's recipe takes are checked
+        // param:   kind, recipe - test the conditions are for
+        //          param - test conditions
+        // returns: TEST_FAULT_* bits of the conditions out of range, 0 if
+        //          none.  TEST_FAULT_ALL if the test has no standard recipe
+        unsigned int testParamFaults(TestKind kind,
+                                     const TestParam &param);
+
+        unsigned int testParamFaults(const std::string &recipe,
+                                     const TestParam &param);
+
+
+        // returns: name of the standard recipe of a test kind, or NULL if
+        //          kind is not a test
+        static const char* testRecipe(TestKind kind);
+
+
+        // returns: true if the standard recipes have a recipe of this name
+        static bool hasTest(const std::string &recipe);
+
+
+        // function to pick the test of a tube section from the "tests" lines
+        //  of the standard recipes
+        // param:   tubeType - type of the section
+        //          sectionCode - AVO CLASS code of the section, i.e. "T",
+        //              "THY", or "" for the default test of tubeType
+        //          recipe - set to the standard recipe of the test
+        // returns: false if no test exists for the section
+        static bool selectTest(Tube::TubeType tubeType,
+                               const std::string &sectionCode,
+                               std::string &recipe);
+
+
+        // function to pick the test of a row of AVO test data.  Rows of a tube
+        //  test its amplifier sections in CLASS order, diodes and rectifiers
+        //  are only tested if the tube has nothing else
+        // param:   avoClass - AVO CLASS of the tube, i.e. "DDT" or "TP"
+        //          section - row number of the tube, starting at 0
+        //          tubeType - set to the type of the tested section
+        //          recipe - set to the standard recipe of the test
+        // returns: false if avoClass has a code no recipe tests
+        static bool avoSectionTest(const std::string &avoClass,
+                                   unsigned int section,
+                                   Tube::TubeType &tubeType,
+                                   std::string &recipe);
+
+
+        // function to look up the limits of a tester model
+        // param:   model - model number, i.e. 15784, 1234 or 118
+        // returns: limits, or NULL if the model is unknown
+        static const ModelLimits* modelLimits(unsigned int model);
+
+
+        // function to read the regulated B+ back from a card
+        // returns: B+ set by the range and step switches, or V_REGBPLUS_MAX
+        //          if no range switch is closed, which includes cards without
+        //          regulated B+
+        static unsigned int cardBPlus(const SwitchMatrix &card);
+
+
+        // function to read the decade resistor back from a card
+        // param:   card - closed switches
+        //          ohms - set to the decade resistor value
+        // returns: false if the decade switches hold no decade resistor
+        //          value
+        static bool cardDecadeOhms(const SwitchMatrix &card,
+                                   unsigned long &ohms);
+
+
+        // function to read the grid bias back from a card
+        // param:   card - closed switches
+        //          bias - set to the grid bias magnitude in volts
+        // returns: false if the card sets no grid bias, or its decade
+        //          switches hold no decade resistor value
+        static bool cardGridBias(const SwitchMatrix &card,
+                                 double &bias);
+
+
+        // function to read the meter shunt choice back from a card
+        // returns: choice number, 0 - NUM_POSSIBLE_GM_VALUES - 1
+        static unsigned int cardMeterShunt(const SwitchMatrix &card);
+
+
+        void setTestParam(const TestParam &param) { m_param = param; }
+
+        const TestParam &getTestParam() const { return m_param; }
+
         void outputSwitchesClosed();
         
         
         // helper to reset the state of all switches
-        // post: all switches are deactivated
+        // post: all switches are deactivated, slices are cleared
         void resetSwitches(); 
+
+
+        // helper to reuse the object for another tube
+        // post: all switches are deactivated, test conditions are zero
+        void reset() { resetSwitches(); m_param = TestParam(); }
         
         CardReader &getClosedSwitches() { return m_switches; } 
 
@@ -282,8 +664,12 @@ class TubeTests
         
         CardReader m_switches;	// set of switches to close in cardreader
 
-        const std::map<unsigned int, 
-            unsigned int> m_regulated_Bplus_maxCurrentParameters;
+        TestParam m_param;      // test conditions used by the test functions
+
+        const SwitchProgram* m_program;     // recipe of the slices, NULL if
+                                            // none
+
+        SwitchSlice m_slices[NUM_SUBSYSTEMS];
 
 
         //----------------------------------------------------------------------                                                          
@@ -315,6 +701,16 @@ class TubeTests
                       	  unsigned int sNumber);
 
 
+        // helper to fold the slices into m_switches
+        void mergeSlices();
+
+
+        // helper to check test conditions against the steps of a recipe
+        // returns: TEST_FAULT_* bits of the conditions out of range
+        unsigned int programFaults(const SwitchProgram &program,
+                                   const TestParam &param);
+
+
 
         // function to set up connections for twin triode tubes
         // pre: tube, a linked list, is of size 2 (tube.size() = 2), same filament voltage requested
@@ -340,6 +736,13 @@ class TubeTests
         void setHeaterVolts(double vHeater);
 
 
+        // helper to select the AC or DC heater supply
+        // param:   heaterType - AC_HEATER or DC_HEATER
+        // post: required switches are activated
+        // See WE Cardmatic manual, section 5.52 for more details
+        void heaterSupply(Heater heaterType);
+
+
         // function to adjust heater settings
         // pre: heater current <= 500mA if DC heater is selected
         //      heater voltage is no more than 12.6V if ctRes is set to 1
@@ -373,16 +776,25 @@ class TubeTests
                          bool gmBridgeConnect);
 
 
-        // may be replaced with database
         // Function: makes sure the B+ voltage does not exceed maximum allowable currents
-        // pre: vBPlus must be 10 - 260 volts in 10 volt increments
         // param:   vBPlus - required B+ voltage
         //          current - maximum current
+        // returns: false if current exceeds the rating, or if vBPlus is not
+        //          10 - 260 volts in 10 volt increments
         // See WE Cardmatic manual, section 5.54 for more details
         bool B_plusCurrentCheck(unsigned int vBPlus,
                                 unsigned int current);
 
 
+        // function to check a current against the B+ ratings of a model
+        // param:   bPlusMaxCurrent - ratings of ModelLimits
+        //          vBPlus, current - as above
+        // returns: as above
+        static bool B_plusCurrentCheck(const unsigned int* bPlusMaxCurrent,
+                                       unsigned int vBPlus,
+                                       unsigned int current);
+
+
         // umhometer shunt select function
         // pre: full scale range of gm must be between 500 - 128,000
         //      500-26,000 umho in 100 umho steps; 26,000-128,000 umho in 500 umho steps
@@ -393,6 +805,21 @@ class TubeTests
         void umho_meterShunt(unsigned long gm);
 
 
+        // function to pick the umhometer shunt of umho_meterShunt()
+        // pre: gm is 500 - 128,000
+        // param:   gm - mutual conductance
+        // returns: shunt choice, plus NUM_POSSIBLE_GM_VALUES on the extended
+        //          scale above 26,000 umho
+        static unsigned int umhoShuntSetting(unsigned long gm);
+
+
+        // function to set the umhometer shunt
+        // pre: setting < 2 * NUM_POSSIBLE_GM_VALUES
+        // param:   setting - shunt from umhoShuntSetting()
+        // post: all necessary shunt switches are activated
+        void umhoShunt(unsigned int setting);
+
+
         // helper to determine shunt value
         // pre: dchoice must be between 0 to 255
         // param:   dchoice - required choice number of meter shunt
@@ -409,6 +836,21 @@ class TubeTests
         void ma_meterShunt(unsigned long fsCurrent);
 
 
+        // function to pick the mA meter shunt of ma_meterShunt()
+        // pre: fsCurrent is 100 - 510100 uA
+        // param:   fsCurrent - current in MICROamperes
+        // returns: shunt choice, plus NUM_POSSIBLE_GM_VALUES times the
+        //          range: 0 up to 5200uA, 1 up to 25600uA, 2 above
+        static unsigned int maShuntSetting(unsigned long fsCurrent);
+
+
+        // function to set the mA meter shunt
+        // pre: setting < 3 * NUM_POSSIBLE_GM_VALUES
+        // param:   setting - shunt from maShuntSetting()
+        // post: all necessary shunt switches are activated
+        void maShunt(unsigned int setting);
+
+
         // Function: conduct plate current test with regulated B+ source
         // pre: range must be between 0 - 510100 uA (0mA to 510.1mA)
         // param:   fsCurrent - current in MICROamperes
@@ -421,10 +863,12 @@ class TubeTests
         // pre: max dval = 70000 (71100) in ohms
         //      dval <= 1k can operate <= DECADE_RES_IMAX_1K
         //      1K < dval <= 70K  can operate <= DECADE_RES_VMAX
-        // param:   dVal - demanded resistance value
+        // param:   dVal - demanded resistance value, rounded to DECADE_RES_INC
+        // returns: false if dVal is above DECADE_RES_ALL_OPEN, switches are
+        //          then unchanged.  True otherwise
         // post: all unactivated switches correspond to required resistance value
         // see WE Cardmatic manual, sections 5.57, 5.58 for more details
-        void decadeResistor(unsigned long dVal);
+        bool decadeResistor(unsigned long dVal);
 
 
         // grid bias set helper
@@ -432,6 +876,8 @@ class TubeTests
         // param:   vGrid - grid bias required in volts
         //          biasType - FIXED_BIAS or SELF_BIAS
         //          gridSignal - .222V signal input, 1 for yes, 0 for no
+        // returns: false if abs(vGrid) > V_BIAS_MAX, switches are then
+        //          unchanged.  True otherwise
         // post: all necessary bias switches are activated
         // see WE Cardmatic manual, sections 5.57, 5.58 for more details
         bool gridBias(double vGrid,
@@ -439,6 +885,14 @@ class TubeTests
                       bool gridSignal);
 
 
+        // function to work out the decade resistor gridBias() sets, the
+        //  lower arm of the bias divider rounded like CatalogueQuantizer
+        // pre: abs(vGrid) <= V_BIAS_MAX
+        // param:   vGrid - grid bias required in volts
+        // returns: decade resistor ohms, a multiple of DECADE_RES_INC
+        static unsigned long biasDecadeOhms(double vGrid);
+
+
         // pre: setTwinTriodeSwitches function is not used
         // assert: tube.sections.front().cathode...tube.sections.back().cathode
         void leakageTest(Tube &tube,
@@ -20,8 +20,10 @@
 #define SW_LETTER_MAX 'L'
 //#define SW_LETTER_MIN Sletter::A + 1;
 //#define SW_LETTER_MAX Sletter::L + 1;
-//#define SW_NUM_MIN 1
-//#define SW_NUM_MAX 17
+#define SW_NUM_MIN 1
+#define SW_NUM_MAX 17
+#define SW_NUM_LETTERS 11       // A...L without I
+#define SW_NUM_SWITCHES 187     // SW_NUM_LETTERS * SW_NUM_MAX
 //const uint8_t* K_SW_NUM_RANGE = {3,4,6,7};
 #define ATOH_SW_NUM_MAX 8
 #define J_SW_NUM_MAX 7
@@ -50,11 +52,15 @@
 
 
 // bias
+#define V_BIAS_MAX_WE 100.0         // maximum bias voltage, KS15784 and 1234
+#define V_BIAS_MAX_118 120.0        // maximum bias voltage, USM118
 #if CARDMATIC_MODEL == 118
-    #define V_BIAS_MAX 120.0        // maximum bias voltage
+    #define V_BIAS_MAX V_BIAS_MAX_118
 #elif CARDMATIC_MODEL == 15784 || CARDMATIC_MODEL == 1234
-    #define V_BIAS_MAX 100.0        // maximum bias voltage
+    #define V_BIAS_MAX V_BIAS_MAX_WE
 #endif
+#define V_BIAS_SUPPLY 150.0         // bias supply across divider, in volts
+#define BIAS_DIVIDER_RES 15000.0    // fixed arm of bias divider, in ohms
 
 
 // meter range
@@ -71,6 +77,17 @@
 #define PRIMARY_CHOICE_MIN 1            // smallest primary choice
 #define PRIMARY_CHOICE_MAX 128          // largest primary choice
 
+// meter circuit.  A shunt choice n shunts the movement with n shunt units,
+//  so the full scale is the movement's times 1 + n * (movement and
+//  multiplier ohms) / METER_SHUNT_UNIT_RES
+#define METER_MOVEMENT_UA 100.0         // movement full scale in uA
+#define METER_MOVEMENT_RES 267.5        // movement, in ohms
+#define METER_MULT_RES_1070 1070.0      // multipliers, in ohms
+#define METER_MULT_RES_25340 25340.0
+#define METER_MULT_RES_100K 100000.0
+#define METER_SHUNT_UNIT_RES 1337.5     // shunt of choice 1, in ohms
+#define GM_SIGNAL_VOLTS 0.222           // gm bridge grid signal, rms volts
+
 
 // nominal heater-cathode leakage values
 #define I_NOM_HC_LEAKAGE_10 10
@@ -79,13 +96,12 @@
 #define I_NOM_HC_LEAKAGE_70 70
 #define I_NOM_HC_LEAKAGE_100 100
 #define I_NOM_HC_LEAKAGE_150 150
-#if CARDMATIC_MODEL == 118
-    #define I_NOM_HC_LEAKAGE_165 165	
-#endif	// this is listed in the usm118 spec sheet and not other models
+#define I_NOM_HC_LEAKAGE_165 165	// USM118 only, see TubeTests::modelLimits()
 
 // decade resistor
 #define DECADE_RES_MAX 70000
 #define DECADE_RES_INC 10
+#define DECADE_RES_ALL_OPEN 71100   // every decade switch open
 #define DECADE_RES_IMAX_1K 200
 #define DECADE_RES_VMAX 200
 
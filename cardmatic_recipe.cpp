@@ -0,0 +1,909 @@
+//    Cardmatic card generator - cardmatic_recipe.cpp file
+//    C++11 implementation file
+
+//    Declarative test recipes.  A recipe lists fixed switch operations and
+//      parameterized TubeTests functions; RecipeCompiler turns it into a
+//      SwitchProgram, a base mask and one precomputed table per parameter,
+//      so running a test is a few table lookups and word operations.
+//      The standard recipes are read from RECIPE_FILE, see standard()
+
+//    Recipe format, one operation per line, '#' starts a comment:
+//      recipe <name>           starts a recipe
+//      tests <type> <code>...  AVO CLASS codes of a Tube::TubeType the recipe
+//                              tests, default for the test of the type
+//      slice <subsystem>       puts the following operations in a part of
+//                              the card: heater, bias, bplus, meter, switches
+//                              (the default) or leakage
+//      use <recipe>            copies the operations of an earlier recipe
+//      close <switch>...       closes switches, i.e. close J15 K15
+//      open <switch>...        opens switches
+//      <primitive> <value>     applies a TubeTests function to a TestParam
+//                              member or a number, see RECIPE_PRIMITIVES
+//      end                     ends a recipe
+//    close, open and primitives run only if the conditions after an optional
+//      if hold, i.e. close K1 K2 if dcHeater, or open L14 if !limited
+
+//    Written by: cathug
+
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include "cardmatic_recipe.h"
+#include "cardmatic_cardpos.h"
+#include "cardmatic_globals.h"
+
+
+
+//------------------------------------------------------------------------------
+// Primitives
+//------------------------------------------------------------------------------
+
+// Each primitive maps a value to the setting the TubeTests function picks
+//  for it, i.e. the meter shunt choice, and builds its table entry from that
+//  setting.  A table lookup then gives the switches of the function itself,
+//  not of the nearest tabulated value
+
+static long heaterEntry(double value)
+{
+    if (!(value >= V_HEATER_MIN && value <= V_HEATER_MAX_AC)) { return -1; }
+    return lround(value / V_HEATER_INC);
+}
+
+static void applyHeater(TubeTests &tests, long entry)
+{
+    tests.setHeaterVolts(entry * V_HEATER_INC);
+}
+
+static long heaterDCEntry(double value)
+{
+    if (!(value >= V_HEATER_MIN && value <= V_HEATER_MAX_DC)) { return -1; }
+    return lround(value / V_HEATER_INC);
+}
+
+static long bPlusEntry(double value)
+{
+    if (!(value >= V_REGBPLUS_MIN && value <= V_REGBPLUS_MAX) ||
+        std::fmod(value, V_REGBPLUS_INC) != 0)
+    {
+        return -1;
+    }
+
+    return lround(value / V_REGBPLUS_INC);
+}
+
+static void applyBPlus(TubeTests &tests, long entry)
+{
+    tests.B_plusVolts(entry * V_REGBPLUS_INC, false, false);
+}
+
+static long gmEntry(double value)
+{
+    if (!(value >= METER_FS_GM_MIN && value <= METER_FS_GM_MAX_HIGH))
+    {
+        return -1;
+    }
+
+    return TubeTests::umhoShuntSetting(lround(value));
+}
+
+static void applyGm(TubeTests &tests, long entry)
+{
+    tests.umhoShunt(entry);
+}
+
+static long maEntry(double value)
+{
+    if (!(value >= METER_FS_I_MIN && value <= METER_FS_I_MAX_HIGH))
+    {
+        return -1;
+    }
+
+    return TubeTests::maShuntSetting(lround(value));
+}
+
+static void applyMa(TubeTests &tests, long entry)
+{
+    tests.maShunt(entry);
+}
+
+static long decadeEntry(double value)
+{
+    if (!(value >= 0 && value <= DECADE_RES_MAX)) { return -1; }
+    return (lround(value) + DECADE_RES_INC / 2) / DECADE_RES_INC;
+}
+
+static void applyDecade(TubeTests &tests, long entry)
+{
+    tests.decadeResistor(entry * DECADE_RES_INC);
+}
+
+// bias tables are indexed by the decade resistor setting
+static long biasEntry(double value)
+{
+    if (!(std::fabs(value) <= V_BIAS_MAX)) { return -1; }
+    return TubeTests::biasDecadeOhms(value) / DECADE_RES_INC;
+}
+
+// helper to set the grid bias of a decade resistor setting, inverse of
+//  TubeTests::biasDecadeOhms()
+static void applyBias(TubeTests &tests,
+                      long entry,
+                      TubeTests::Biasing biasType,
+                      bool gridSignal)
+{
+    double ohms = entry * DECADE_RES_INC;
+    tests.gridBias(ohms * V_BIAS_SUPPLY / (BIAS_DIVIDER_RES + ohms), biasType,
+        gridSignal);
+}
+
+static void applyBiasFixed(TubeTests &tests, long entry)
+{
+    applyBias(tests, entry, TubeTests::FIXED_BIAS, true);
+}
+
+static void applyBiasSelf(TubeTests &tests, long entry)
+{
+    applyBias(tests, entry, TubeTests::SELF_BIAS, true);
+}
+
+static void applyBiasFixedDC(TubeTests &tests, long entry)
+{
+    applyBias(tests, entry, TubeTests::FIXED_BIAS, false);
+}
+
+static void applyBiasSelfDC(TubeTests &tests, long entry)
+{
+    applyBias(tests, entry, TubeTests::SELF_BIAS, false);
+}
+
+static long leakageEntry(double value)
+{
+    if (!(value >= 0 && value <= I_NOM_HC_LEAKAGE_165)) { return -1; }
+    return lround(value);
+}
+
+static void applyLeakage(TubeTests &tests, long entry)
+{
+    tests.leakageShunt(entry);
+}
+
+
+// TubeTests functions a recipe can use
+typedef struct RecipePrimitive
+{
+    const char* name;
+    long numEntries;
+    long (*entry)(double value);
+    void (*apply)(TubeTests &tests, long entry);
+}RecipePrimitive;
+
+static const long NUM_BIAS_ENTRIES =
+    TubeTests::biasDecadeOhms(V_BIAS_MAX) / DECADE_RES_INC + 1;
+
+static const RecipePrimitive RECIPE_PRIMITIVES[] = {
+    // volts
+    {"heater", lround(V_HEATER_MAX_AC / V_HEATER_INC) + 1, heaterEntry,
+        applyHeater},
+    {"heater_dc", lround(V_HEATER_MAX_DC / V_HEATER_INC) + 1, heaterDCEntry,
+        applyHeater},
+    {"bplus", V_REGBPLUS_MAX / V_REGBPLUS_INC + 1, bPlusEntry, applyBPlus},
+    {"bias_fixed", NUM_BIAS_ENTRIES, biasEntry, applyBiasFixed},
+    {"bias_self", NUM_BIAS_ENTRIES, biasEntry, applyBiasSelf},
+    {"bias_fixed_dc", NUM_BIAS_ENTRIES, biasEntry, applyBiasFixedDC},
+    {"bias_self_dc", NUM_BIAS_ENTRIES, biasEntry, applyBiasSelfDC},
+
+    // umho, microamperes and ohms
+    {"gm", 2 * NUM_POSSIBLE_GM_VALUES, gmEntry, applyGm},
+    {"ma", 3 * NUM_POSSIBLE_GM_VALUES, maEntry, applyMa},
+    {"decade", DECADE_RES_MAX / DECADE_RES_INC + 1, decadeEntry, applyDecade},
+    {"leakage", I_NOM_HC_LEAKAGE_165 + 1, leakageEntry, applyLeakage},
+};
+
+
+
+// names of RecipeParameter, RecipeFlag and TubeTests::Subsystem in recipes
+static const char* const PARAMETER_NAMES[NUM_RECIPE_PARAMETERS] = {
+    "heater", "bias", "bPlus", "umhoFS", "maFS", "load",
+};
+
+static const char* const FLAG_NAMES[NUM_RECIPE_FLAGS] = {
+    "dcHeater", "fixedBias", "twin", "leakage", "limited", "highInverse",
+};
+
+static const char* const SLICE_NAMES[TubeTests::NUM_SUBSYSTEMS] = {
+    "", "heater", "bias", "bplus", "meter", "switches", "leakage",
+};
+
+static const struct { const char* name; Tube::TubeType tubeType; }
+TUBE_TYPE_NAMES[] = {
+    {"DIODE", Tube::DIODE},
+    {"TRIODE", Tube::TRIODE},
+    {"TETRODE", Tube::TETRODE},
+    {"PENTODE", Tube::PENTODE},
+    {"HEPTODE", Tube::HEPTODE},
+};
+
+
+
+//------------------------------------------------------------------------------
+// SwitchProgram implementation
+//------------------------------------------------------------------------------
+
+// constructor
+SwitchProgram::SwitchProgram() :
+    m_inputs()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+SwitchProgram::~SwitchProgram()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to run the steps of one subsystem on an empty card.  A step sets
+//  card = (card with open switches opened) + close switches, so the steps
+//  fold into one such pair
+// param:   values - test conditions
+//          subsystem - part of the card to run
+//          slice - set to the switches closed and opened, see
+//              TubeTests::SwitchSlice
+// returns: false if a value is outside the range of its table, slice is then
+//          unchanged.  True otherwise
+bool SwitchProgram::execute(const RecipeValues &values,
+                            TubeTests::Subsystem subsystem,
+                            TubeTests::SwitchSlice &slice) const
+{
+    SwitchMatrix close, open;
+
+    for (auto &step : m_steps[subsystem])
+    {
+        if ((values.flags & step.guardMask) != step.guardFlags) { continue; }
+
+        const SwitchMatrix* stepClose = &step.close;
+        const SwitchMatrix* stepOpen = &step.open;
+
+        if (step.table != NULL)
+        {
+            const ParameterTable &table = *step.table;
+            long entry = table.entry(values.values[step.parameter]);
+            if (entry < 0 || entry >= static_cast<long>(table.valid.size()) ||
+                !table.valid[entry])
+            {
+                return false;
+            }
+
+            stepClose = &table.closeMasks[entry];
+            stepOpen = &table.openMasks[entry];
+        }
+
+        close.openAll(*stepOpen) |= *stepClose;
+        (open |= *stepOpen).openAll(close);
+    }
+
+    slice.close = close;
+    slice.open = open;
+    slice.invalid.clear();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to run the program on top of a card, i.e. a pin map
+// param:   values - test conditions
+//          card - switches closed so far
+// returns: false if a value is outside the range of its table, card is then
+//          unchanged.  True otherwise
+bool SwitchProgram::execute(const RecipeValues &values,
+                            SwitchMatrix &card) const
+{
+    SwitchMatrix result = card;
+
+    for (int s = 0; s < TubeTests::NUM_SUBSYSTEMS; s++)
+    {
+        TubeTests::SwitchSlice slice;
+        if (!execute(values, static_cast<TubeTests::Subsystem>(s), slice))
+        {
+            return false;
+        }
+
+        result.openAll(slice.open) |= slice.close;
+    }
+
+    card = result;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to find the test conditions the program cannot set
+// param:   values - test conditions
+// returns: bit RecipeParameter set for each value a step that runs has no
+//          table entry for
+unsigned int SwitchProgram::badParameters(const RecipeValues &values) const
+{
+    unsigned int bad = 0;
+
+    for (int s = 0; s < TubeTests::NUM_SUBSYSTEMS; s++)
+    {
+        for (auto &step : m_steps[s])
+        {
+            if (step.table == NULL ||
+                (values.flags & step.guardMask) != step.guardFlags)
+            {
+                continue;
+            }
+
+            long entry = step.table->entry(values.values[step.parameter]);
+            if (entry < 0 ||
+                entry >= static_cast<long>(step.table->valid.size()) ||
+                !step.table->valid[entry])
+            {
+                bad |= 1 << step.parameter;
+            }
+        }
+    }
+
+    return bad;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: bit RecipeParameter set for each value a step that runs takes
+unsigned int SwitchProgram::usedParameters(const RecipeValues &values) const
+{
+    unsigned int used = 0;
+
+    for (int s = 0; s < TubeTests::NUM_SUBSYSTEMS; s++)
+    {
+        for (auto &step : m_steps[s])
+        {
+            if (step.table != NULL &&
+                (values.flags & step.guardMask) == step.guardFlags)
+            {
+                used |= 1 << step.parameter;
+            }
+        }
+    }
+
+    return used;
+}
+
+//------------------------------------------------------------------------------
+
+// function to derive the values of a program run
+// param:   param - test conditions
+// returns: values and flags of param
+RecipeValues SwitchProgram::values(const TestParam &param)
+{
+    RecipeValues values;
+
+    values.values[RECIPE_HEATER] = param.heater;
+    values.values[RECIPE_BIAS] = param.bias;
+    values.values[RECIPE_BPLUS] = param.bPlus;
+    values.values[RECIPE_UMHO_FS] = param.umhoFS;
+    values.values[RECIPE_MA_FS] = param.maFS;
+    values.values[RECIPE_LOAD] = param.load;
+
+    values.flags = param.dcHeater << RECIPE_DC_HEATER |
+        param.fixedBias << RECIPE_FIXED_BIAS |
+        param.twin << RECIPE_TWIN |
+        param.leakage << RECIPE_LEAKAGE |
+        (param.load > 0) << RECIPE_LIMITED |
+        (param.maxInverse > HWTHRESHOLD_MAXINVRATING) << RECIPE_HIGH_INVERSE;
+
+    return values;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: bits of the parameters and flags that differ, in the form of
+//          getInputs()
+unsigned int SwitchProgram::inputBits(const RecipeValues &a,
+                                      const RecipeValues &b)
+{
+    unsigned int bits = (a.flags ^ b.flags) << NUM_RECIPE_PARAMETERS;
+
+    for (int p = 0; p < NUM_RECIPE_PARAMETERS; p++)
+    {
+        if (a.values[p] != b.values[p]) { bits |= 1 << p; }
+    }
+
+    return bits;
+}
+
+//------------------------------------------------------------------------------
+
+
+
+//------------------------------------------------------------------------------
+// RecipeCompiler implementation
+//------------------------------------------------------------------------------
+
+// helper to run a primitive and collect the switches it leaves closed
+// returns: false if the primitive names a switch the cardreader does not have
+static bool runPrimitive(const RecipePrimitive &primitive,
+                         long entry,
+                         const CardReader &initial,
+                         SwitchMatrix &closed)
+{
+    TubeTests tests;
+
+    tests.getClosedSwitches() = initial;
+    primitive.apply(tests, entry);
+
+    const CardReader &switches = tests.getClosedSwitches();
+    for (auto it = switches.begin(); it != switches.end(); it++)
+    {
+        if (SwitchMatrix::switchIndex(it->first, it->second) < 0)
+        {
+            return false;
+        }
+    }
+
+    closed = SwitchMatrix(switches);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to find a name in a table of names
+// returns: index of name, or -1 if it is not there
+static int nameIndex(const char* const* names,
+                     int numNames,
+                     const std::string &name)
+{
+    for (int i = 0; i < numNames; i++)
+    {
+        if (name == names[i]) { return i; }
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+
+// constructor
+RecipeCompiler::RecipeCompiler()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+RecipeCompiler::~RecipeCompiler()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to compile a recipe file
+// returns: true if all recipes compile, false otherwise.  See getError()
+bool RecipeCompiler::compileFile(const std::string &fileName)
+{
+    std::ifstream recipes(fileName.c_str());
+    if (!recipes)
+    {
+        m_error = "cannot open " + fileName;
+        return false;
+    }
+
+    return compile(recipes);
+}
+
+//------------------------------------------------------------------------------
+
+// function to compile recipes, adding them to the compiled programs.  A
+//  recipe replaces an earlier recipe of the same name, and the AVO CLASS
+//  codes it tests replace those of earlier recipes
+// returns: true if all recipes compile, false otherwise.  See getError()
+bool RecipeCompiler::compile(std::istream &recipes)
+{
+    std::string line;
+    unsigned int lineNumber = 0;
+    bool inRecipe = false;
+    SwitchProgram program;
+    std::vector<RecipeSection> sections;
+    int slice = TubeTests::SUBSYSTEM_SWITCH_LIST;
+
+    m_error.clear();
+
+    while (std::getline(recipes, line))
+    {
+        std::string command, word;
+        std::vector<std::string> words;
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::ostringstream where;
+
+        lineNumber++;
+        where << "line " << lineNumber << ": ";
+
+        if (!(fields >> command)) { continue; }     // blank line
+
+
+        // conditions after if
+        unsigned int guardMask = 0, guardFlags = 0;
+        bool inGuard = false;
+
+        while (fields >> word)
+        {
+            if (!inGuard && word == "if")
+            {
+                inGuard = true;
+                continue;
+            }
+
+            if (!inGuard)
+            {
+                words.push_back(word);
+                continue;
+            }
+
+            bool negated = word[0] == '!';
+            int flag = nameIndex(FLAG_NAMES, NUM_RECIPE_FLAGS,
+                word.substr(negated));
+            if (flag < 0)
+            {
+                m_error = where.str() + "no condition " + word;
+                return false;
+            }
+
+            guardMask |= 1 << flag;
+            if (!negated) { guardFlags |= 1 << flag; }
+        }
+
+        if (inGuard && guardMask == 0)
+        {
+            m_error = where.str() + "if needs a condition";
+            return false;
+        }
+
+
+        if (command == "recipe")
+        {
+            if (inRecipe || words.size() != 1)
+            {
+                m_error = where.str() + "expected recipe <name> after end";
+                return false;
+            }
+
+            inRecipe = true;
+            program = SwitchProgram();
+            program.m_name = words[0];
+            sections.clear();
+            slice = TubeTests::SUBSYSTEM_SWITCH_LIST;
+            continue;
+        }
+
+        if (!inRecipe)
+        {
+            m_error = where.str() + "operation outside of a recipe";
+            return false;
+        }
+
+        bool takesGuard = command != "tests" && command != "slice" &&
+            command != "use" && command != "end";
+        if (inGuard && !takesGuard)
+        {
+            m_error = where.str() + command + " cannot have conditions";
+            return false;
+        }
+
+
+        if (command == "tests")
+        {
+            RecipeSection section;
+            section.recipe = program.m_name;
+
+            bool found = false;
+            for (auto &type : TUBE_TYPE_NAMES)
+            {
+                if (!words.empty() && words[0] == type.name)
+                {
+                    section.tubeType = type.tubeType;
+                    found = true;
+                }
+            }
+
+            if (!found || words.size() < 2)
+            {
+                m_error = where.str() + "expected tests <tube type> <code>...";
+                return false;
+            }
+
+            for (size_t i = 1; i < words.size(); i++)
+            {
+                section.code = words[i] == "default" ? "" : words[i];
+                sections.push_back(section);
+            }
+        }
+
+        else if (command == "slice")
+        {
+            slice = words.size() == 1 ? nameIndex(SLICE_NAMES,
+                TubeTests::NUM_SUBSYSTEMS, words[0]) : -1;
+            if (slice <= TubeTests::SUBSYSTEM_PINS)
+            {
+                m_error = where.str() + "expected slice heater, bias, bplus, "
+                    "meter, switches or leakage";
+                return false;
+            }
+        }
+
+        else if (command == "use")
+        {
+            const SwitchProgram* used = words.size() == 1 ?
+                findProgram(words[0]) : NULL;
+            if (used == NULL)
+            {
+                m_error = where.str() + "use needs an earlier recipe";
+                return false;
+            }
+
+            for (int s = 0; s < TubeTests::NUM_SUBSYSTEMS; s++)
+            {
+                program.m_steps[s].insert(program.m_steps[s].end(),
+                    used->m_steps[s].begin(), used->m_steps[s].end());
+                program.m_inputs[s] |= used->m_inputs[s];
+            }
+        }
+
+        else if (command == "end")
+        {
+            // codes tested by this recipe are no longer tested by others
+            for (auto it = m_sections.begin(); it != m_sections.end(); )
+            {
+                bool replaced = it->recipe == program.m_name;
+                for (auto &section : sections)
+                {
+                    replaced = replaced || (it->tubeType == section.tubeType &&
+                        it->code == section.code);
+                }
+
+                it = replaced ? m_sections.erase(it) : it + 1;
+            }
+
+            m_sections.insert(m_sections.end(), sections.begin(),
+                sections.end());
+            m_programs[program.m_name] = program;
+            inRecipe = false;
+        }
+
+        else    // close, open or primitive
+        {
+            SwitchProgram::Step step = SwitchProgram::Step();
+            step.guardMask = guardMask;
+            step.guardFlags = guardFlags;
+
+            if (command == "close" || command == "open")
+            {
+                for (auto &name : words)
+                {
+                    int index = SwitchMatrix::parseSwitch(name);
+                    if (index < 0)
+                    {
+                        m_error = where.str() + "no switch " + name;
+                        return false;
+                    }
+
+                    // later operations win
+                    if (command == "close")
+                    {
+                        step.close.setBit(index);
+                        step.open.clearBit(index);
+                    }
+
+                    else
+                    {
+                        step.open.setBit(index);
+                        step.close.clearBit(index);
+                    }
+                }
+            }
+
+            else
+            {
+                const ParameterTable* parameterTable = table(command);
+                if (parameterTable == NULL)
+                {
+                    m_error = where.str() + "unknown operation " + command;
+                    return false;
+                }
+
+                if (words.size() != 1)
+                {
+                    m_error = where.str() + command + " needs a value";
+                    return false;
+                }
+
+                char* end;
+                double number = std::strtod(words[0].c_str(), &end);
+                int parameter = nameIndex(PARAMETER_NAMES,
+                    NUM_RECIPE_PARAMETERS, words[0]);
+
+                if (parameter >= 0)
+                {
+                    step.table = parameterTable;
+                    step.parameter = static_cast<RecipeParameter>(parameter);
+                    program.m_inputs[slice] |= 1 << parameter;
+                }
+
+                else if (*end == '\0')      // a number, a fixed operation
+                {
+                    long entry = parameterTable->entry(number);
+                    if (entry < 0 || entry >= static_cast<long>(
+                        parameterTable->valid.size()) ||
+                        !parameterTable->valid[entry])
+                    {
+                        m_error = where.str() + words[0] +
+                            " is out of range of " + command;
+                        return false;
+                    }
+
+                    step.close = parameterTable->closeMasks[entry];
+                    step.open = parameterTable->openMasks[entry];
+                }
+
+                else
+                {
+                    m_error = where.str() + "no test condition " + words[0];
+                    return false;
+                }
+            }
+
+            program.m_inputs[slice] |= guardMask << NUM_RECIPE_PARAMETERS;
+
+
+            // fold a fixed operation into the last step if it runs under
+            //  the same conditions
+            std::vector<SwitchProgram::Step> &steps = program.m_steps[slice];
+            if (step.table == NULL && !steps.empty() &&
+                steps.back().table == NULL &&
+                steps.back().guardMask == guardMask &&
+                steps.back().guardFlags == guardFlags)
+            {
+                SwitchProgram::Step &last = steps.back();
+                last.close.openAll(step.open) |= step.close;
+                (last.open |= step.open).openAll(last.close);
+            }
+
+            else { steps.push_back(step); }
+        }
+    }
+
+    if (inRecipe)
+    {
+        m_error = "recipe " + program.m_name + " has no end";
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: compiled program, or NULL if there is none.  Programs stay valid
+//          while the compiler exists
+const SwitchProgram* RecipeCompiler::findProgram(const std::string &name) const
+{
+    auto found = m_programs.find(name);
+    return found == m_programs.end() ? NULL : &found->second;
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<std::string> RecipeCompiler::getProgramNames() const
+{
+    std::vector<std::string> names;
+    for (auto it = m_programs.begin(); it != m_programs.end(); it++)
+    {
+        names.push_back(it->first);
+    }
+
+    return names;
+}
+
+//------------------------------------------------------------------------------
+
+// function to get the standard recipes, compiled on first use from the file
+//  named by environment variable RECIPE_FILE_ENV, or else from RECIPE_FILE in
+//  the working directory or its parent, i.e. for cardmaticsql run from sql/.
+//  Safe to call from several threads
+// returns: compiled standard recipes, without programs if the file cannot be
+//          read or compiled
+const RecipeCompiler &RecipeCompiler::standard()
+{
+    // compiled once, C++11 initializes a local static on one thread
+    struct Standard
+    {
+        RecipeCompiler compiler;
+
+        Standard()
+        {
+            const char* fileName = std::getenv(RECIPE_FILE_ENV);
+            if (fileName == NULL)
+            {
+                std::ifstream local(RECIPE_FILE);
+                fileName = local ? RECIPE_FILE : "../" RECIPE_FILE;
+            }
+
+            if (!compiler.compileFile(fileName))
+            {
+                std::cerr << "standard recipes " << fileName << ": " <<
+                    compiler.getError() << std::endl;
+
+                // a partly compiled file would run some tests and not others
+                compiler.m_programs.clear();
+                compiler.m_sections.clear();
+            }
+        }
+    };
+
+    static const Standard standardRecipes;
+    return standardRecipes.compiler;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to build the table of a primitive on first use.
+//  TubeTests functions only insert switches and erase one copy of a switch,
+//  so a switch ends up closed from an open start only if it also does from a
+//  closed start.  Running the function once on an empty and once on a full
+//  cardreader therefore gives the switches it closes and the switches it
+//  opens, whatever was closed before
+// returns: table, or NULL if primitive is unknown
+const ParameterTable* RecipeCompiler::table(const std::string &primitive)
+{
+    auto found = m_tables.find(primitive);
+    if (found != m_tables.end()) { return found->second.get(); }
+
+    const RecipePrimitive* definition = NULL;
+    for (auto &candidate : RECIPE_PRIMITIVES)
+    {
+        if (primitive == candidate.name) { definition = &candidate; }
+    }
+
+    if (definition == NULL) { return NULL; }
+
+
+    std::unique_ptr<ParameterTable> built(new ParameterTable());
+    const CardReader empty;
+    const CardReader full = SwitchMatrix::allClosed().toCardReader();
+    long numEntries = definition->numEntries;
+
+    built->primitive = primitive;
+    built->entry = definition->entry;
+    built->closeMasks.resize(numEntries);
+    built->openMasks.resize(numEntries);
+    built->valid.resize(numEntries);
+
+    for (long i = 0; i < numEntries; i++)
+    {
+        SwitchMatrix fromFull;
+
+        built->valid[i] =
+            runPrimitive(*definition, i, empty, built->closeMasks[i]) &&
+            runPrimitive(*definition, i, full, fromFull);
+
+        built->openMasks[i] = SwitchMatrix::allClosed().openAll(fromFull);
+    }
+
+    const ParameterTable* result = built.get();
+    m_tables[primitive] = std::move(built);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
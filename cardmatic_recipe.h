@@ -0,0 +1,259 @@
+//    Cardmatic card generator - cardmatic_recipe.h file
+//    C++11 header file
+
+//    Declarative test recipes.  A recipe lists fixed switch operations and
+//      parameterized TubeTests functions; RecipeCompiler turns it into a
+//      SwitchProgram, a base mask and one precomputed table per parameter,
+//      so running a test is a few table lookups and word operations.
+//      TubeTests::runTest() runs the standard recipes of RECIPE_FILE by name
+
+//    Written by: cathug
+
+
+
+#ifndef CARDMATIC_RECIPE_H
+#define CARDMATIC_RECIPE_H
+
+#include "cardmatic_cardpos.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <istream>
+
+
+#define RECIPE_FILE "cardmatic_recipes.txt"     // standard recipes
+#define RECIPE_FILE_ENV "CARDMATIC_RECIPES"     // environment variable naming
+                                                // another standard recipe file
+
+//------------------------------------------------------------------------------
+//  enums
+//------------------------------------------------------------------------------
+
+// test conditions a recipe step takes its value from, named after the
+//  TestParam members
+typedef enum RecipeParameter
+{
+    RECIPE_HEATER,
+    RECIPE_BIAS,
+    RECIPE_BPLUS,
+    RECIPE_UMHO_FS,
+    RECIPE_MA_FS,
+    RECIPE_LOAD,
+    NUM_RECIPE_PARAMETERS,
+}RecipeParameter;
+
+
+// test conditions a recipe step can be made to depend on
+typedef enum RecipeFlag
+{
+    RECIPE_DC_HEATER,       // dcHeater
+    RECIPE_FIXED_BIAS,      // fixedBias
+    RECIPE_TWIN,            // twin
+    RECIPE_LEAKAGE,         // leakage
+    RECIPE_LIMITED,         // load > 0, current limiting resistor
+    RECIPE_HIGH_INVERSE,    // maxInverse > HWTHRESHOLD_MAXINVRATING
+    NUM_RECIPE_FLAGS,
+}RecipeFlag;
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// switches set by a TubeTests function over its range of values.  Entry i
+// holds the switches closed and opened by the i-th setting of the function
+typedef struct ParameterTable
+{
+    std::string primitive;
+    long (*entry)(double value);    // setting of a value, -1 if out of range
+    std::vector<SwitchMatrix> closeMasks;
+    std::vector<SwitchMatrix> openMasks;
+    std::vector<bool> valid;    // false if the function names a switch the
+                                // cardreader does not have
+}ParameterTable;
+
+
+// test conditions of a program run
+typedef struct RecipeValues
+{
+    double values[NUM_RECIPE_PARAMETERS];
+    unsigned int flags;     // bit RecipeFlag set if the condition holds
+}RecipeValues;
+
+
+// AVO CLASS code tested by a recipe
+typedef struct RecipeSection
+{
+    Tube::TubeType tubeType;
+    std::string code;       // i.e. "T", "THY", or "" for the default test of
+                            // tubeType
+    std::string recipe;
+}RecipeSection;
+
+
+
+//------------------------------------------------------------------------------
+//  Classes
+//------------------------------------------------------------------------------
+
+class SwitchProgram
+{
+    public:
+        SwitchProgram();
+
+        ~SwitchProgram();
+
+
+        // function to run the steps of one subsystem on an empty card
+        // param:   values - test conditions
+        //          subsystem - part of the card to run
+        //          slice - set to the switches closed and opened, see
+        //              TubeTests::SwitchSlice
+        // returns: false if a value is outside the range of its table,
+        //          slice is then unchanged.  True otherwise
+        bool execute(const RecipeValues &values,
+                     TubeTests::Subsystem subsystem,
+                     TubeTests::SwitchSlice &slice) const;
+
+
+        // function to run the program on top of a card, i.e. a pin map
+        // param:   values - test conditions
+        //          card - switches closed so far
+        // returns: false if a value is outside the range of its table, card
+        //          is then unchanged.  True otherwise
+        bool execute(const RecipeValues &values,
+                     SwitchMatrix &card) const;
+
+
+        // function to find the test conditions the program cannot set
+        // param:   values - test conditions
+        // returns: bit RecipeParameter set for each value a step that runs
+        //          has no table entry for
+        unsigned int badParameters(const RecipeValues &values) const;
+
+
+        // returns: bit RecipeParameter set for each value a step that runs
+        //          takes
+        unsigned int usedParameters(const RecipeValues &values) const;
+
+
+        // returns: bits of the parameters a subsystem's steps take, plus bit
+        //          NUM_RECIPE_PARAMETERS + RecipeFlag of the flags they
+        //          depend on.  See inputBits()
+        unsigned int getInputs(TubeTests::Subsystem subsystem) const
+        {
+            return m_inputs[subsystem];
+        }
+
+
+        const std::string &getName() const { return m_name; }
+
+
+        // function to derive the values of a program run
+        // param:   param - test conditions
+        // returns: values and flags of param
+        static RecipeValues values(const TestParam &param);
+
+
+        // returns: bits of the parameters and flags that differ, in the
+        //          form of getInputs()
+        static unsigned int inputBits(const RecipeValues &a,
+                                      const RecipeValues &b);
+
+
+
+    private:
+        friend class RecipeCompiler;
+
+        // card = (card with open switches opened) + close switches, using the
+        // table entry of the parameter value if table is not NULL.  The step
+        // runs if the flags in guardMask have the values of guardFlags
+        typedef struct Step
+        {
+            SwitchMatrix close;
+            SwitchMatrix open;
+            const ParameterTable* table;
+            RecipeParameter parameter;
+            unsigned int guardMask;
+            unsigned int guardFlags;
+        }Step;
+
+        std::string m_name;
+
+        // steps by subsystem, consecutive fixed operations under the same
+        //  guard are folded
+        std::vector<Step> m_steps[TubeTests::NUM_SUBSYSTEMS];
+
+        unsigned int m_inputs[TubeTests::NUM_SUBSYSTEMS];
+};
+
+
+
+
+
+class RecipeCompiler
+{
+    public:
+        RecipeCompiler();
+
+        ~RecipeCompiler();
+
+        RecipeCompiler(const RecipeCompiler &) = delete;
+        RecipeCompiler &operator=(const RecipeCompiler &) = delete;
+
+
+        // functions to compile recipes, adding them to the compiled programs.
+        //  A recipe replaces an earlier recipe of the same name
+        // returns: true if all recipes compile, false otherwise.  See
+        //          getError()
+        bool compileFile(const std::string &fileName);
+
+        bool compile(std::istream &recipes);
+
+
+        // returns: compiled program, or NULL if there is none.  Programs stay
+        //          valid while the compiler exists
+        const SwitchProgram* findProgram(const std::string &name) const;
+
+
+        std::vector<std::string> getProgramNames() const;
+
+
+        // returns: AVO CLASS codes tested by the recipes, in file order
+        const std::vector<RecipeSection> &getSections() const
+        {
+            return m_sections;
+        }
+
+        const std::string &getError() const { return m_error; }
+
+
+        // function to get the standard recipes, compiled on first use from
+        //  RECIPE_FILE, see RECIPE_FILE_ENV.  Safe to call from several
+        //  threads
+        // returns: compiled standard recipes, without programs if the file
+        //          cannot be read or compiled
+        static const RecipeCompiler &standard();
+
+
+
+    private:
+        std::map<std::string, SwitchProgram> m_programs;
+
+        std::vector<RecipeSection> m_sections;
+
+        // tables are shared by all programs using a primitive
+        std::map<std::string, std::unique_ptr<ParameterTable> > m_tables;
+
+        std::string m_error;
+
+
+        // helper to build the table of a primitive on first use
+        // returns: table, or NULL if primitive is unknown
+        const ParameterTable* table(const std::string &primitive);
+};
+
+
+#endif // CARDMATIC_RECIPE_H
@@ -0,0 +1,239 @@
+//    Cardmatic card generator - cardmatic_sweep.cpp file
+//    C++11 implementation file
+
+//    Parameter sweep over B+, grid bias and umhometer full scale.  Every
+//      combination of the ranges is run as a test on the pins of a tube
+//      section, in parallel, giving a table of cards and of the conditions
+//      the tester cannot set.
+
+//    Written by: cathug
+
+
+
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include "cardmatic_sweep.h"
+#include "cardmatic_globals.h"
+
+
+// names of the fault bits in the printed table
+static const struct
+{
+    unsigned int bit;
+    const char* name;
+} SWEEP_FAULT_NAMES[] = {
+    {TEST_FAULT_HEATER, "heater"},
+    {TEST_FAULT_BIAS, "bias"},
+    {TEST_FAULT_BPLUS, "B+"},
+    {TEST_FAULT_BPLUS_CURRENT, "B+current"},
+    {TEST_FAULT_GM, "gm"},
+    {TEST_FAULT_METER, "meter"},
+    {TEST_FAULT_LOAD, "load"},
+    {SWEEP_INVALID_SWITCH, "switch"},
+};
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   numThreads - threads running the tests, 0 = one per core
+ParameterSweep::ParameterSweep(unsigned int numThreads) :
+    m_numThreads(numThreads > 0 ? numThreads :
+        std::max(1u, std::thread::hardware_concurrency()))
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+ParameterSweep::~ParameterSweep()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to run a test at every combination of the ranges
+// param:   pins - switches of the tested section, i.e. set up by
+//              Tube::setTubeSectionSwitches()
+//          kind - test to run
+//          base - the other test conditions, i.e. heater and plate current
+//          ranges - conditions to sweep
+// returns: false if kind has no standard recipe, a range is empty or the
+//          sweep has more than SWEEP_MAX_POINTS combinations.  True otherwise
+bool ParameterSweep::run(const CardReader &pins,
+                         TubeTests::TestKind kind,
+                         const TestParam &base,
+                         const SweepRanges &ranges)
+{
+    m_points.clear();
+
+    const char* recipe = TubeTests::testRecipe(kind);
+    if (recipe == NULL || !TubeTests::hasTest(recipe)) { return false; }
+
+    // B+ and gm start at the first step inside the range
+    std::vector<unsigned int> bPlusValues;
+    for (unsigned int v = (ranges.bPlusMin + V_REGBPLUS_INC - 1) /
+        V_REGBPLUS_INC * V_REGBPLUS_INC; v <= ranges.bPlusMax;
+        v += V_REGBPLUS_INC)
+    {
+        bPlusValues.push_back(v);
+    }
+
+    std::vector<unsigned int> umhoFSValues;
+    unsigned int step = ranges.umhoFSMin < METER_FS_GM_MAX_LOW ?
+        METER_FS_GM_INC_LOW : METER_FS_GM_INC_HIGH;
+    for (unsigned int v = (ranges.umhoFSMin + step - 1) / step * step;
+        v <= ranges.umhoFSMax;
+        v += v < METER_FS_GM_MAX_LOW ? METER_FS_GM_INC_LOW :
+                                       METER_FS_GM_INC_HIGH)
+    {
+        umhoFSValues.push_back(v);
+    }
+
+    long biasMin = std::lround(ranges.biasMin * 10);
+    long biasMax = std::lround(ranges.biasMax * 10);
+
+    if (bPlusValues.empty() || umhoFSValues.empty() || biasMin > biasMax ||
+        std::labs(biasMin) > INT16_MAX || std::labs(biasMax) > INT16_MAX)
+    {
+        return false;
+    }
+
+    size_t numPoints = bPlusValues.size() * (biasMax - biasMin + 1) *
+        umhoFSValues.size();
+    if (numPoints > SWEEP_MAX_POINTS) { return false; }
+
+
+    m_points.reserve(numPoints);
+    for (auto b = bPlusValues.begin(); b != bPlusValues.end(); b++)
+    {
+        for (long bias = biasMin; bias <= biasMax; bias++)
+        {
+            for (auto g = umhoFSValues.begin(); g != umhoFSValues.end(); g++)
+            {
+                SweepPoint point = SweepPoint();
+                point.bPlus = *b;
+                point.biasTenths = bias;
+                point.umhoFS = *g;
+                m_points.push_back(point);
+            }
+        }
+    }
+
+
+    // contiguous blocks, so neighbouring points stay on one thread
+    unsigned int numThreads = std::min<size_t>(m_numThreads, numPoints);
+    size_t blockSize = (numPoints + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+
+    for (size_t begin = 0; begin < numPoints; begin += blockSize)
+    {
+        threads.push_back(std::thread(&ParameterSweep::sweepRange, this,
+            std::cref(pins), kind, std::cref(base), begin,
+            std::min(begin + blockSize, numPoints)));
+    }
+
+    for (auto it = threads.begin(); it != threads.end(); it++) { it->join(); }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to print the table, one combination per line:
+//  B+, bias, gm full scale, faults or OK, closed switches
+void ParameterSweep::print(std::ostream &out) const
+{
+    for (auto it = m_points.begin(); it != m_points.end(); it++)
+    {
+        out << it->bPlus << ' ' << std::fixed << std::setprecision(1) <<
+            it->biasTenths / 10.0 << ' ' << it->umhoFS << ' ';
+
+        if (it->faults == 0)
+        {
+            out << "OK " << it->card.toString() << '\n';
+            continue;
+        }
+
+        const char* separator = "";
+        for (auto &fault : SWEEP_FAULT_NAMES)
+        {
+            if (it->faults & fault.bit)
+            {
+                out << separator << fault.name;
+                separator = ",";
+            }
+        }
+
+        out << '\n';
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// number of combinations without faults
+size_t ParameterSweep::numValid() const
+{
+    return std::count_if(m_points.begin(), m_points.end(),
+        [](const SweepPoint &point) { return point.faults == 0; });
+}
+
+//------------------------------------------------------------------------------
+
+// runs the tests of the points begin...end - 1.  Neighbouring points differ
+//  in one condition, so each test after the first only recomputes the slices
+//  of that condition
+void ParameterSweep::sweepRange(const CardReader &pins,
+                                TubeTests::TestKind kind,
+                                const TestParam &base,
+                                size_t begin,
+                                size_t end)
+{
+    TubeTests tests;
+    bool started = false;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        SweepPoint &point = m_points[i];
+        TestParam param = base;
+        param.bPlus = point.bPlus;
+        param.bias = point.biasTenths / 10.0;
+        param.umhoFS = point.umhoFS;
+
+        point.faults = tests.testParamFaults(kind, param);
+        if (point.faults != 0) { continue; }
+
+        if (!started)
+        {
+            tests.resetSwitches();
+            tests.getClosedSwitches() = pins;
+            tests.setTestParam(param);
+            started = tests.runTest(kind);
+        }
+
+        else { tests.updateTestParam(param); }
+
+
+        // the cardreader holds each valid switch once
+        const CardReader &switches = tests.getClosedSwitches();
+        point.card = SwitchMatrix(switches);
+
+        if (point.card.count() != switches.size())
+        {
+            point.faults = SWEEP_INVALID_SWITCH;
+            point.card = SwitchMatrix();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
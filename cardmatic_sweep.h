@@ -0,0 +1,134 @@
+//    Cardmatic card generator - cardmatic_sweep.h file
+//    C++11 header file
+
+//    Parameter sweep over B+, grid bias and umhometer full scale.  Every
+//      combination of the ranges is run as a test on the pins of a tube
+//      section, in parallel, giving a table of cards and of the conditions
+//      the tester cannot set.
+
+//    Written by: cathug
+
+
+
+#ifndef CARDMATIC_SWEEP_H
+#define CARDMATIC_SWEEP_H
+
+#include "cardmatic_cardpos.h"
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+
+#define SWEEP_MAX_POINTS 1048576    // combinations of one sweep
+#define SWEEP_INVALID_SWITCH 0x80   // card names a switch the cardreader
+                                    // does not have, beyond TEST_FAULT_* bits
+
+
+
+//------------------------------------------------------------------------------
+//  structs
+//------------------------------------------------------------------------------
+
+// ranges of a sweep, bounds included.  B+ is swept in V_REGBPLUS_INC steps,
+//  bias in 0.1V steps and gm full scale in the umhometer steps
+typedef struct SweepRanges
+{
+    unsigned int bPlusMin;
+    unsigned int bPlusMax;
+    double biasMin;             // grid bias volts, i.e. -3.0
+    double biasMax;
+    unsigned int umhoFSMin;
+    unsigned int umhoFSMax;
+}SweepRanges;
+
+
+// one combination of a sweep
+typedef struct SweepPoint
+{
+    uint16_t bPlus;
+    int16_t biasTenths;         // grid bias in 0.1V
+    uint32_t umhoFS;
+    uint8_t faults;             // TEST_FAULT_* and SWEEP_INVALID_SWITCH bits
+    SwitchMatrix card;          // closed switches, empty if faults is not 0
+}SweepPoint;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class ParameterSweep
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   numThreads - threads running the tests, 0 = one per core
+        ParameterSweep(unsigned int numThreads = 0);
+
+        ~ParameterSweep();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to run a test at every combination of the ranges
+        // param:   pins - switches of the tested section, i.e. set up by
+        //              Tube::setTubeSectionSwitches()
+        //          kind - test to run
+        //          base - the other test conditions, i.e. heater and plate
+        //              current
+        //          ranges - conditions to sweep
+        // returns: false if kind has no standard recipe, a range is empty
+        //          or the sweep has more than SWEEP_MAX_POINTS combinations.
+        //          True otherwise
+        bool run(const CardReader &pins,
+                 TubeTests::TestKind kind,
+                 const TestParam &base,
+                 const SweepRanges &ranges);
+
+
+        // function to print the table, one combination per line:
+        //  B+, bias, gm full scale, faults or OK, closed switches
+        void print(std::ostream &out) const;
+
+
+        // combinations in B+, bias, gm order, gm varying fastest
+        const std::vector<SweepPoint> &getPoints() const { return m_points; }
+
+        // number of combinations without faults
+        size_t numValid() const;
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        unsigned int m_numThreads;
+
+        std::vector<SweepPoint> m_points;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // runs the tests of the points begin...end - 1.  Neighbouring points
+        //  differ in one condition, so each test after the first only
+        //  recomputes the slices of that condition
+        void sweepRange(const CardReader &pins,
+                        TubeTests::TestKind kind,
+                        const TestParam &base,
+                        size_t begin,
+                        size_t end);
+};
+
+#endif // CARDMATIC_SWEEP_H
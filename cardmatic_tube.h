@@ -9,7 +9,13 @@
 #define CARDMATIC_TUBE_H
 
 
+#include "cardmatic_globals.h"
 #include <unordered_map>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
 
 
 // the cardreader containing number and letter switches
@@ -17,6 +23,268 @@ typedef std::unordered_multimap<char,unsigned int> CardReader;
 //typedef std::array<array<bool, 11>,17> CardReader;
 
 
+#define SW_MATRIX_WORDS 3       // 64 bit words needed for SW_NUM_SWITCHES
+
+
+// compact image of the cardreader, one bit per switch
+// bit position = letter column (A...L without I) * SW_NUM_MAX + (row - 1)
+// unlike CardReader, a switch can only be closed once
+typedef struct SwitchMatrix
+{
+    uint64_t words[SW_MATRIX_WORDS];
+
+
+    SwitchMatrix() : words{0, 0, 0} {}
+
+
+    // builds the matrix from a set of closed switches
+    // switches outside A...L (no I), 1...17 are ignored
+    explicit SwitchMatrix(const CardReader &switches) : words{0, 0, 0}
+    {
+        for (auto it = switches.begin(); it != switches.end(); it++)
+        {
+            close(it->first, it->second);
+        }
+    }
+
+
+    // maps a switch to its bit position
+    // returns: bit position, or -1 if the switch does not exist
+    static int switchIndex(char sLetter,
+                           unsigned int sNumber)
+    {
+        if (sLetter < SW_LETTER_MIN || sLetter > SW_LETTER_MAX ||
+            sLetter == 'I' || sNumber < SW_NUM_MIN || sNumber > SW_NUM_MAX)
+        {
+            return -1;
+        }
+
+        int column = sLetter - SW_LETTER_MIN;
+        if (sLetter > 'I') { column--; }    // fix 'no I' switch naming problem
+
+        return column * SW_NUM_MAX + (sNumber - SW_NUM_MIN);
+    }
+
+
+    // inverse of switchIndex()
+    static char indexLetter(int index)
+    {
+        char sLetter = SW_LETTER_MIN + index / SW_NUM_MAX;
+        if (sLetter >= 'I') { sLetter++; }
+        return sLetter;
+    }
+
+    static unsigned int indexNumber(int index)
+    {
+        return index % SW_NUM_MAX + SW_NUM_MIN;
+    }
+
+
+    bool testBit(int index) const
+    {
+        return (words[index >> 6] >> (index & 63)) & 1;
+    }
+
+    void setBit(int index) { words[index >> 6] |= uint64_t(1) << (index & 63); }
+
+    void clearBit(int index)
+    {
+        words[index >> 6] &= ~(uint64_t(1) << (index & 63));
+    }
+
+
+    void close(char sLetter,
+               unsigned int sNumber)
+    {
+        int index = switchIndex(sLetter, sNumber);
+        if (index >= 0) { setBit(index); }
+    }
+
+    void open(char sLetter,
+              unsigned int sNumber)
+    {
+        int index = switchIndex(sLetter, sNumber);
+        if (index >= 0) { clearBit(index); }
+    }
+
+    bool isClosed(char sLetter,
+                  unsigned int sNumber) const
+    {
+        int index = switchIndex(sLetter, sNumber);
+        return index >= 0 && testBit(index);
+    }
+
+
+    // converts the matrix back to the cardreader representation
+    CardReader toCardReader() const
+    {
+        CardReader switches;
+        for (int i = 0; i < SW_NUM_SWITCHES; i++)
+        {
+            if (testBit(i))
+            {
+                switches.insert(std::make_pair(indexLetter(i),
+                                               indexNumber(i)));
+            }
+        }
+
+        return switches;
+    }
+
+
+    // lists closed switches in card order, i.e. "A7 A13 B6 L12"
+    std::string toString() const
+    {
+        std::string text;
+        for (int i = 0; i < SW_NUM_SWITCHES; i++)
+        {
+            if (!testBit(i)) { continue; }
+            if (!text.empty()) { text.push_back(' '); }
+
+            text.push_back(indexLetter(i));
+            text += std::to_string(indexNumber(i));
+        }
+
+        return text;
+    }
+
+
+    // parses a switch name such as "J15"
+    // returns: bit position of the switch, or -1 if it does not exist
+    static int parseSwitch(const std::string &name)
+    {
+        if (name.size() < 2 || name[1] < '0' || name[1] > '9') { return -1; }
+
+        char* end;
+        unsigned long number = std::strtoul(name.c_str() + 1, &end, 10);
+        if (*end != '\0' || number > SW_NUM_MAX) { return -1; }
+
+        return switchIndex(name[0], number);
+    }
+
+
+    // inverse of toString(), closed switches separated by spaces
+    // param:   text - i.e. "A7 A13 B6 L12"
+    //          card - set to the closed switches
+    // returns: false if a name is not a switch of the cardreader
+    static bool fromString(const std::string &text,
+                           SwitchMatrix &card)
+    {
+        card = SwitchMatrix();
+
+        size_t end = 0;
+        while (true)
+        {
+            size_t begin = text.find_first_not_of(" \t\r\n", end);
+            if (begin == std::string::npos) { return true; }
+
+            end = text.find_first_of(" \t\r\n", begin);
+            int index = parseSwitch(text.substr(begin, end - begin));
+            if (index < 0) { return false; }
+
+            card.setBit(index);
+        }
+    }
+
+
+    // number of closed switches
+    unsigned int count() const
+    {
+        return popCount(words[0]) + popCount(words[1]) + popCount(words[2]);
+    }
+
+
+    // number of switches that differ between two cards
+    unsigned int distance(const SwitchMatrix &other) const
+    {
+        return popCount(words[0] ^ other.words[0]) +
+               popCount(words[1] ^ other.words[1]) +
+               popCount(words[2] ^ other.words[2]);
+    }
+
+
+    bool empty() const { return (words[0] | words[1] | words[2]) == 0; }
+
+
+    bool operator==(const SwitchMatrix &other) const
+    {
+        return words[0] == other.words[0] &&
+               words[1] == other.words[1] &&
+               words[2] == other.words[2];
+    }
+
+    bool operator!=(const SwitchMatrix &other) const
+    {
+        return !(*this == other);
+    }
+
+
+    SwitchMatrix &operator|=(const SwitchMatrix &other)
+    {
+        words[0] |= other.words[0];
+        words[1] |= other.words[1];
+        words[2] |= other.words[2];
+        return *this;
+    }
+
+    SwitchMatrix &operator&=(const SwitchMatrix &other)
+    {
+        words[0] &= other.words[0];
+        words[1] &= other.words[1];
+        words[2] &= other.words[2];
+        return *this;
+    }
+
+
+    // opens every switch closed in mask
+    SwitchMatrix &openAll(const SwitchMatrix &mask)
+    {
+        words[0] &= ~mask.words[0];
+        words[1] &= ~mask.words[1];
+        words[2] &= ~mask.words[2];
+        return *this;
+    }
+
+
+    // matrix with every switch of the cardreader closed
+    static SwitchMatrix allClosed()
+    {
+        SwitchMatrix m;
+        for (int i = 0; i < SW_NUM_SWITCHES; i++) { m.setBit(i); }
+        return m;
+    }
+
+
+    // without -mpopcnt the builtin is a library call, the bit parallel sum
+    //  is inlined and several times faster
+    static unsigned int popCount(uint64_t word)
+    {
+        #if defined(__GNUC__) && defined(__POPCNT__)
+        return __builtin_popcountll(word);
+        #else
+        word -= (word >> 1) & 0x5555555555555555ULL;
+        word = (word & 0x3333333333333333ULL) +
+               ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return (word * 0x0101010101010101ULL) >> 56;
+        #endif
+    }
+}SwitchMatrix;
+
+
+// hash functor so that SwitchMatrix can key unordered containers
+typedef struct SwitchMatrixHash
+{
+    size_t operator()(const SwitchMatrix &m) const
+    {
+        uint64_t h = m.words[0] * 0x9E3779B97F4A7C15ULL;
+        h ^= (m.words[1] + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4FULL;
+        h ^= (m.words[2] + (h << 6) + (h >> 2)) * 0x165667B19E3779F9ULL;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+}SwitchMatrixHash;
+
+
 typedef enum RowSwitches : unsigned int
 {
     ROW_NONE,
@@ -40,15 +308,23 @@ typedef enum RowSwitches : unsigned int
 }RowSwitches;
 
 
-//typedef struct TestParam
-//{
-//    bool twin;              // twin tube?
-//    unsigned int bPlus;     // B+ voltage
-//    double heater;          // heater voltage
-//    bool dcHeater;          // 0 off (ac heater) / 1 on (dc heater)
-//    bool leakage;           // leakage test
-//    unsigned int umhoFS;    // meter full scale umho
-//}TestParam;
+// test conditions of one tube section, input of the TubeTests test functions
+// initialize with TestParam param = TestParam(); so unused fields are zero
+typedef struct TestParam
+{
+    bool twin;              // twin tube?
+    unsigned int bPlus;     // B+ voltage
+    double heater;          // heater voltage
+    bool dcHeater;          // 0 off (ac heater) / 1 on (dc heater)
+    bool leakage;           // leakage test
+    unsigned int umhoFS;    // meter full scale umho
+    unsigned long maFS;     // meter full scale microamperes
+    double current;         // expected plate current in mA, for B+ limits
+    double bias;            // grid bias volts
+    bool fixedBias;         // 0 self bias / 1 fixed bias
+    unsigned long load;     // load or current limiting resistor in ohms
+    unsigned int maxInverse;    // rectifier max inverse rating in volts
+}TestParam;
 
 
 
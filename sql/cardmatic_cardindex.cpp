@@ -0,0 +1,296 @@
+//    Cardmatic card generator - cardmatic_cardindex.cpp file
+//    C++11 implementation file
+
+//    Reverse index over generated test cards.  Answers which catalogue tubes
+//      share a card, and which tubes are within k switches of a card, using
+//      multi-index hashing over the 187 bit switch matrix.  A tube has a
+//      card per section and is listed once per lookup, at its nearest card.
+
+//    Written by: cathug
+
+
+#include <algorithm>
+#include <unordered_set>
+#include "cardmatic_cardindex.h"
+#include "cardmatic_sql.h"
+#include "cardmatic_dataconvert.h"
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   numSubstrings - number of substrings the switch matrix is split
+//              into, 3...SW_NUM_SWITCHES
+CardIndex::CardIndex(unsigned int numSubstrings) :
+    m_numSubstrings(numSubstrings)
+{
+    // a substring must fit in a 64 bit word
+    if (m_numSubstrings < 3) { m_numSubstrings = 3; }
+    if (m_numSubstrings > SW_NUM_SWITCHES)
+    {
+        m_numSubstrings = SW_NUM_SWITCHES;
+    }
+
+    m_substringTables.resize(m_numSubstrings);
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+CardIndex::~CardIndex()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// adds a card generated for a tube to the index.  A card added again for
+//  the same tube is ignored
+// param:   tubeID - tube the card belongs to
+//          card - closed switches of the card
+void CardIndex::addCard(const std::string &tubeID,
+                        const SwitchMatrix &card)
+{
+    auto tube = m_tubePos.insert(std::make_pair(tubeID, m_tubeIDs.size()));
+    unsigned int tubePos = tube.first->second;
+    if (tube.second) { m_tubeIDs.push_back(tubeID); }
+
+    // tubes sharing a card are chained to the same distinct card
+    auto found = m_exact.find(card);
+    if (found != m_exact.end())
+    {
+        std::vector<unsigned int> &tubes = m_cardTubes[found->second];
+        if (std::find(tubes.begin(), tubes.end(), tubePos) == tubes.end())
+        {
+            tubes.push_back(tubePos);
+        }
+        return;
+    }
+
+    unsigned int cardPos = m_cards.size();
+    m_cards.push_back(card);
+    m_cardTubes.push_back(std::vector<unsigned int>(1, tubePos));
+    m_exact.insert(std::make_pair(card, cardPos));
+
+    for (unsigned int s = 0; s < m_numSubstrings; s++)
+    {
+        m_substringTables[s][substringValue(card, s)].push_back(cardPos);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// generates the card of every row of a table as the card pipeline does,
+//  rows of a tube being its sections in order, and adds it to the index.
+//  Rows the converter rejects are skipped
+// pre: db is open
+// param:   db - database to read
+//          converter - converter used to generate cards
+//          tableName - i.e. "avocardmatic"
+// returns: number of cards added
+unsigned int CardIndex::addCatalogue(Database &db,
+                                     DataConverter &converter,
+                                     std::string tableName)
+{
+    TubeTests tests;
+    unsigned int numAdded = 0;
+    unsigned int section = 0;
+
+    db.dbQueryAll(tableName);
+    const std::string* text = db.getTubeData_str();
+    const double* values = db.getTubeData_double();
+
+    for (unsigned int row = 0; row < db.getNumRowsReturned(); row++)
+    {
+        const std::string* rowText = &text[row * NUM_TEXT_COLS_PER_ROW];
+
+        // rows of a tube are adjacent
+        section = row > 0 && rowText[TUBE_ID] ==
+            text[(row - 1) * NUM_TEXT_COLS_PER_ROW + TUBE_ID] ?
+            section + 1 : 0;
+
+        SwitchMatrix card;
+        if (converter.convertAVOData(rowText,
+                &values[row * NUM_DOUBLE_COLS_PER_ROW], section, tests,
+                card) != CONVERT_OK)
+        {
+            continue;
+        }
+
+        addCard(rowText[TUBE_ID], card);
+        numAdded++;
+    }
+
+    return numAdded;
+}
+
+//------------------------------------------------------------------------------
+
+// function to find tubes sharing exactly the same card
+// param: card - scanned card
+// returns: matching tubes sorted by tube ID, empty if there are none, each
+//          tube once
+std::vector<CardMatch> CardIndex::findExact(const SwitchMatrix &card) const
+{
+    std::vector<CardMatch> matches;
+
+    auto found = m_exact.find(card);
+    if (found != m_exact.end()) { appendTubes(found->second, 0, matches); }
+
+    // a tube is chained to a card once
+    std::sort(matches.begin(), matches.end(),
+        [](const CardMatch &a, const CardMatch &b)
+        {
+            return a.tubeID < b.tubeID;
+        });
+
+    return matches;
+}
+
+//------------------------------------------------------------------------------
+
+// function to find tubes whose card differs in at most maxDiff switches
+// param:   card - scanned card
+//          maxDiff - maximum number of differing switches
+// returns: matching tubes sorted by distance, then tube ID, each tube once
+//          at the distance of its nearest card
+std::vector<CardMatch> CardIndex::findWithin(const SwitchMatrix &card,
+                                             unsigned int maxDiff) const
+{
+    std::vector<CardMatch> matches;
+
+    if (maxDiff == 0) { return findExact(card); }
+
+    if (maxDiff < m_numSubstrings)
+    {
+        // pigeonhole principle: if at most maxDiff switches differ, at least
+        // one of the m_numSubstrings substrings matches exactly.  Collect the
+        // candidates of every substring and verify them
+        std::vector<bool> seen(m_cards.size(), false);
+
+        for (unsigned int s = 0; s < m_numSubstrings; s++)
+        {
+            auto bucket = m_substringTables[s].find(substringValue(card, s));
+            if (bucket == m_substringTables[s].end()) { continue; }
+
+            for (auto it = bucket->second.begin();
+                it != bucket->second.end(); it++)
+            {
+                if (seen[*it]) { continue; }
+                seen[*it] = true;
+
+                unsigned int distance = card.distance(m_cards[*it]);
+                if (distance <= maxDiff)
+                {
+                    appendTubes(*it, distance, matches);
+                }
+            }
+        }
+    }
+
+    else    // radius too large for the substring tables
+    {
+        for (unsigned int i = 0; i < m_cards.size(); i++)
+        {
+            unsigned int distance = card.distance(m_cards[i]);
+            if (distance <= maxDiff) { appendTubes(i, distance, matches); }
+        }
+    }
+
+    nearestPerTube(matches);
+
+    return matches;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to reset the index
+// post: index is empty
+void CardIndex::clear()
+{
+    m_tubeIDs.clear();
+    m_tubePos.clear();
+    m_cards.clear();
+    m_cardTubes.clear();
+    m_exact.clear();
+
+    for (auto it = m_substringTables.begin();
+        it != m_substringTables.end(); it++)
+    {
+        it->clear();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to extract a substring of the switch matrix
+// param:   card - switch matrix
+//          substring - 0...m_numSubstrings - 1
+// returns: bits of the substring, right aligned
+uint64_t CardIndex::substringValue(const SwitchMatrix &card,
+                                   unsigned int substring) const
+{
+    unsigned int first = substring * SW_NUM_SWITCHES / m_numSubstrings;
+    unsigned int last = (substring + 1) * SW_NUM_SWITCHES / m_numSubstrings;
+    unsigned int width = last - first;
+    unsigned int word = first >> 6;
+    unsigned int shift = first & 63;
+
+    uint64_t value = card.words[word] >> shift;
+
+    // substring straddles two words
+    if (shift + width > 64 && word + 1 < SW_MATRIX_WORDS)
+    {
+        value |= card.words[word + 1] << (64 - shift);
+    }
+
+    if (width < 64) { value &= (uint64_t(1) << width) - 1; }
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to list the tubes of a distinct card
+void CardIndex::appendTubes(unsigned int cardPos,
+                            unsigned int distance,
+                            std::vector<CardMatch> &matches) const
+{
+    const std::vector<unsigned int> &tubes = m_cardTubes[cardPos];
+
+    for (auto it = tubes.begin(); it != tubes.end(); it++)
+    {
+        CardMatch match = { m_tubeIDs[*it], distance };
+        matches.push_back(match);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to keep the nearest match of each tube
+// post: matches are sorted by distance, then tube ID
+void CardIndex::nearestPerTube(std::vector<CardMatch> &matches)
+{
+    auto byDistance = [](const CardMatch &a, const CardMatch &b)
+    {
+        if (a.distance != b.distance) { return a.distance < b.distance; }
+        return a.tubeID < b.tubeID;
+    };
+
+    // the first match of a tube is its nearest
+    std::sort(matches.begin(), matches.end(), byDistance);
+
+    std::unordered_set<std::string> seen;
+    matches.erase(std::remove_if(matches.begin(), matches.end(),
+        [&seen](const CardMatch &match)
+        {
+            return !seen.insert(match.tubeID).second;
+        }), matches.end());
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,167 @@
+//    Cardmatic card generator - cardmatic_cardindex.h file
+//    C++11 header file
+
+//    Reverse index over generated test cards.  Answers which catalogue tubes
+//      share a card, and which tubes are within k switches of a card, using
+//      multi-index hashing over the 187 bit switch matrix.  A tube has a
+//      card per section and is listed once per lookup, at its nearest card.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_CARDINDEX_H
+#define CARDMATIC_CARDINDEX_H
+
+#include "../cardmatic_tube.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+class Database;
+class DataConverter;
+
+
+#define CARDINDEX_NUM_SUBSTRINGS 8      // default number of hashed substrings
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// a tube returned by a lookup
+typedef struct CardMatch
+{
+    std::string tubeID;
+    unsigned int distance;  // number of switches that differ
+}CardMatch;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CardIndex
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   numSubstrings - number of substrings the switch matrix is
+        //              split into, 3...SW_NUM_SWITCHES.  Lookups with fewer
+        //              than numSubstrings differing switches use the hash
+        //              tables; larger radii fall back to a popcount scan
+        explicit CardIndex(unsigned int numSubstrings =
+                               CARDINDEX_NUM_SUBSTRINGS);
+
+        ~CardIndex();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // adds a card generated for a tube to the index.  A card added again
+        //  for the same tube is ignored
+        // param:   tubeID - tube the card belongs to
+        //          card - closed switches of the card
+        void addCard(const std::string &tubeID,
+                     const SwitchMatrix &card);
+
+
+        // generates the card of every row of a table as the card pipeline
+        //  does, rows of a tube being its sections in order, and adds it to
+        //  the index.  Rows the converter rejects are skipped
+        // pre: db is open
+        // param:   db - database to read
+        //          converter - converter used to generate cards
+        //          tableName - i.e. "avocardmatic"
+        // returns: number of cards added
+        unsigned int addCatalogue(Database &db,
+                                  DataConverter &converter,
+                                  std::string tableName);
+
+
+        // function to find tubes sharing exactly the same card
+        // param: card - scanned card
+        // returns: matching tubes sorted by tube ID, empty if there are none,
+        //          each tube once
+        std::vector<CardMatch> findExact(const SwitchMatrix &card) const;
+
+
+        // function to find tubes whose card differs in at most maxDiff
+        //  switches
+        // param:   card - scanned card
+        //          maxDiff - maximum number of differing switches
+        // returns: matching tubes sorted by distance, then tube ID, each tube
+        //          once at the distance of its nearest card
+        std::vector<CardMatch> findWithin(const SwitchMatrix &card,
+                                          unsigned int maxDiff) const;
+
+
+        // helper to reset the index
+        // post: index is empty
+        void clear();
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors
+        //----------------------------------------------------------------------
+
+        size_t getNumTubes() const { return m_tubeIDs.size(); }
+
+        size_t getNumDistinctCards() const { return m_cards.size(); }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        unsigned int m_numSubstrings;
+
+        std::vector<std::string> m_tubeIDs;             // all indexed tubes
+        std::unordered_map<std::string, unsigned int> m_tubePos;  // in above
+        std::vector<SwitchMatrix> m_cards;              // distinct cards
+        std::vector<std::vector<unsigned int> > m_cardTubes;  // card -> tubes
+
+        // distinct card -> position in m_cards
+        std::unordered_map<SwitchMatrix, unsigned int,
+            SwitchMatrixHash> m_exact;
+
+        // one table per substring, substring value -> positions in m_cards
+        std::vector<std::unordered_map<uint64_t,
+            std::vector<unsigned int> > > m_substringTables;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // helper to extract a substring of the switch matrix
+        // param:   card - switch matrix
+        //          substring - 0...m_numSubstrings - 1
+        // returns: bits of the substring, right aligned
+        uint64_t substringValue(const SwitchMatrix &card,
+                                unsigned int substring) const;
+
+
+        // helper to list the tubes of a distinct card
+        void appendTubes(unsigned int cardPos,
+                         unsigned int distance,
+                         std::vector<CardMatch> &matches) const;
+
+
+        // helper to keep the nearest match of each tube
+        // post: matches are sorted by distance, then tube ID
+        static void nearestPerTube(std::vector<CardMatch> &matches);
+};
+
+#endif // CARDMATIC_CARDINDEX_H
@@ -0,0 +1,188 @@
+//    Cardmatic card generator - cardmatic_catalogue.cpp file
+//    C++11 implementation file
+
+//    In-memory columnar copy of the AVO VCM163 catalogue.  Each attribute of
+//      the AVOcardmatic table is stored in its own contiguous column, so
+//      catalogue-wide searches can stream through one parameter at a time.
+
+//    Written by: cathug
+
+
+#include <cctype>
+#include "cardmatic_catalogue.h"
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// default constructor
+TubeCatalogue::TubeCatalogue()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+TubeCatalogue::~TubeCatalogue()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to load every row of a table into the columns
+// pre: db is open
+// param:   db - database to read
+//          tableName - i.e. "avocardmatic"
+// returns: true if at least one row is loaded, false otherwise
+bool TubeCatalogue::load(Database &db,
+                         std::string tableName)
+{
+    std::unordered_map<std::string, unsigned int> baseCodes;
+    std::unordered_map<std::string, unsigned int> pinoutCodes;
+
+    db.dbQueryAll(tableName);
+
+    unsigned int numRows = db.getNumRowsReturned();
+    const std::string* text = db.getTubeData_str();
+    const double* values = db.getTubeData_double();
+
+    for (unsigned int c = 0; c < NUM_TEXT_COLS_PER_ROW; c++)
+    {
+        m_text[c].resize(numRows);
+    }
+
+    for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+    {
+        m_values[c].resize(numRows);
+    }
+
+    m_baseCode.resize(numRows);
+    m_pinoutCode.resize(numRows);
+    m_tubeRow.clear();
+
+    // transpose rows into columns
+    for (unsigned int row = 0; row < numRows; row++)
+    {
+        for (unsigned int c = 0; c < NUM_TEXT_COLS_PER_ROW; c++)
+        {
+            m_text[c][row] = text[row * NUM_TEXT_COLS_PER_ROW + c];
+        }
+
+        for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+        {
+            m_values[c][row] = values[row * NUM_DOUBLE_COLS_PER_ROW + c];
+        }
+
+        auto base = baseCodes.insert(std::make_pair(
+            normalizeBase(m_text[BASE][row]), baseCodes.size()));
+        m_baseCode[row] = base.first->second;
+
+        auto pinout = pinoutCodes.insert(std::make_pair(
+            m_text[SWITCH_SETTINGS][row] + m_text[TOP_CAP][row],
+            pinoutCodes.size()));
+        m_pinoutCode[row] = pinout.first->second;
+
+        // keep the first row of tubes listed more than once
+        m_tubeRow.insert(std::make_pair(m_text[TUBE_ID][row], row));
+    }
+
+    checkPins();
+
+    return numRows > 0;
+}
+
+//------------------------------------------------------------------------------
+
+// checks the pins of every row into m_pinFaults.  Rows with the same pinout
+//  and base are checked once
+void TubeCatalogue::checkPins()
+{
+    DataConverter converter;
+    std::unordered_map<uint64_t, Tube::PinDiagnostic> checked;
+    std::string text[NUM_TEXT_COLS_PER_ROW];
+    unsigned int section = 0;
+
+    converter.setVerbose(false);
+    m_pinFaults.clear();
+
+    for (size_t row = 0; row < size(); row++)
+    {
+        // rows of a tube are adjacent
+        section = row > 0 && m_text[TUBE_ID][row] == m_text[TUBE_ID][row - 1] ?
+            section + 1 : 0;
+
+        uint64_t key = uint64_t(m_pinoutCode[row]) << 32 | m_baseCode[row];
+        auto found = checked.find(key);
+
+        if (found == checked.end())
+        {
+            text[SWITCH_SETTINGS] = m_text[SWITCH_SETTINGS][row];
+            text[TOP_CAP] = m_text[TOP_CAP][row];
+            text[BASE] = m_text[BASE][row];
+
+            found = checked.insert(std::make_pair(key,
+                converter.checkAVOPins(text, 0))).first;
+        }
+
+        if (found->second.status != Tube::TUBE_PINS_OK)
+        {
+            PinFault fault = {row, found->second};
+            fault.diagnostic.section = section;
+            m_pinFaults.push_back(fault);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to find a tube
+// param: tubeID - tube nomenclature, i.e. "ECC83"
+// returns: first row of the tube, or -1 if tube is not listed
+int TubeCatalogue::findTube(const std::string &tubeID) const
+{
+    auto found = m_tubeRow.find(tubeID);
+    if (found == m_tubeRow.end()) { return -1; }
+
+    return found->second;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to normalize an AVO base, i.e. "Sm7" -> "SM7", "B7G/F   " -> "B7G/F"
+std::string TubeCatalogue::normalizeBase(const std::string &base)
+{
+    std::string normalized;
+
+    for (auto it = base.begin(); it != base.end(); it++)
+    {
+        if (*it != ' ') { normalized.push_back(std::toupper(*it)); }
+    }
+
+    return normalized;
+}
+
+//------------------------------------------------------------------------------
+
+// copies one row in the layout expected by DataConverter
+void TubeCatalogue::getRow(size_t row,
+                           std::string* VCM163_text,
+                           double* VCM163_double) const
+{
+    for (unsigned int c = 0; c < NUM_TEXT_COLS_PER_ROW; c++)
+    {
+        VCM163_text[c] = m_text[c][row];
+    }
+
+    for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+    {
+        VCM163_double[c] = m_values[c][row];
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
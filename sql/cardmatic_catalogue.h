@@ -0,0 +1,157 @@
+//    Cardmatic card generator - cardmatic_catalogue.h file
+//    C++11 header file
+
+//    In-memory columnar copy of the AVO VCM163 catalogue.  Each attribute of
+//      the AVOcardmatic table is stored in its own contiguous column, so
+//      catalogue-wide searches can stream through one parameter at a time.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_CATALOGUE_H
+#define CARDMATIC_CATALOGUE_H
+
+#include "cardmatic_sql.h"
+#include "cardmatic_dataconvert.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// a row whose pins fail DataConverter::checkAVOPins()
+typedef struct PinFault
+{
+    size_t row;
+    Tube::PinDiagnostic diagnostic;
+}PinFault;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class TubeCatalogue
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        TubeCatalogue();    // default constructor
+
+        ~TubeCatalogue();   // destructor
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to load every row of a table into the columns.  The pins
+        //  of every row are checked, see getPinFaults()
+        // pre: db is open
+        // param:   db - database to read
+        //          tableName - i.e. "avocardmatic"
+        // returns: true if at least one row is loaded, false otherwise
+        bool load(Database &db,
+                  std::string tableName);
+
+
+        // function to find a tube
+        // param: tubeID - tube nomenclature, i.e. "ECC83"
+        // returns: first row of the tube, or -1 if tube is not listed
+        int findTube(const std::string &tubeID) const;
+
+
+        // helper to normalize an AVO base, i.e. "Sm7" -> "SM7", "B7G/F   "
+        //  -> "B7G/F"
+        static std::string normalizeBase(const std::string &base);
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors
+        //----------------------------------------------------------------------
+
+        size_t size() const { return m_text[TUBE_ID].size(); }
+
+
+        const std::string &getText(size_t row,
+                                   VCM163Param_text column) const
+        {
+            return m_text[column][row];
+        }
+
+
+        // values of missing parameters are NaN
+        double getValue(size_t row,
+                        VCM163Param_double column) const
+        {
+            return m_values[column][row];
+        }
+
+
+        const double* getColumn(VCM163Param_double column) const
+        {
+            return m_values[column].data();
+        }
+
+
+        // rows with equal codes have the same normalized base
+        const unsigned int* getBaseCodes() const { return m_baseCode.data(); }
+
+
+        // rows with equal codes have the same switch settings and top caps
+        const unsigned int* getPinoutCodes() const
+        {
+            return m_pinoutCode.data();
+        }
+
+
+        // rows whose pins failed the check at load time, in row order
+        const std::vector<PinFault> &getPinFaults() const
+        {
+            return m_pinFaults;
+        }
+
+
+        // copies one row in the layout expected by DataConverter
+        void getRow(size_t row,
+                    std::string* VCM163_text,
+                    double* VCM163_double) const;
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        std::vector<std::string> m_text[NUM_TEXT_COLS_PER_ROW];
+        std::vector<double> m_values[NUM_DOUBLE_COLS_PER_ROW];
+
+        std::vector<unsigned int> m_baseCode;       // interned base
+        std::vector<unsigned int> m_pinoutCode;     // interned sw + tc
+
+        std::unordered_map<std::string, unsigned int> m_tubeRow;
+
+        std::vector<PinFault> m_pinFaults;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // checks the pins of every row into m_pinFaults.  Rows with the same
+        //  pinout and base are checked once
+        void checkPins();
+};
+
+#endif // CARDMATIC_CATALOGUE_H
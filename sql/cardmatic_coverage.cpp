@@ -0,0 +1,361 @@
+//    Cardmatic card generator - cardmatic_coverage.cpp file
+//    C++11 implementation file
+
+//    Coverage of the official card lists.  The tube IDs of the lists, of the
+//      AVO catalogue and of the generated cards are normalized and sorted
+//      once, then merge joined in a single pass, giving for every tube the
+//      lists it is on, its official number of cards and the number of cards
+//      generated for it.
+
+//    Written by: cathug
+
+
+#include <algorithm>
+#include <cctype>
+#include "cardmatic_coverage.h"
+#include "cardmatic_dataconvert.h"
+#include "cardmatic_pipeline.h"
+
+
+// state of a list entry after the join
+#define ENTRY_IN_CATALOGUE 0x01
+#define ENTRY_GENERATED 0x02
+#define ENTRY_MISMATCHED 0x04
+
+
+// table and printed name of each list, by CoverageList
+static const struct
+{
+    const char* table;
+    const char* name;
+} COVERAGE_LISTS[NUM_COVERAGE_LISTS] = {
+    {"ListWETubes", "WE"},
+    {"List118Cards", "118"},
+    {"List123Cards", "123"},
+};
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+CoverageReport::CoverageReport() :
+    m_summaries()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+CoverageReport::~CoverageReport()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to load the official lists and the catalogue, generate the cards
+//  of the catalogue and join them
+// pre: db is open
+// param:   db - database holding the lists and the catalogue
+//          tableName - catalogue in AVOcardmatic format
+//          numWorkers - card generating threads, 0 = one per core
+// returns: false if a table cannot be read
+bool CoverageReport::build(Database &db,
+                           std::string tableName,
+                           unsigned int numWorkers)
+{
+    for (unsigned int set = 0; set < NUM_COVERAGE_SETS; set++)
+    {
+        m_keys[set].clear();
+    }
+
+    m_rows.clear();
+
+
+    for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+    {
+        unsigned int entry = 0;
+        long numRows = db.dbForEachCardListRow(COVERAGE_LISTS[list].table,
+            [&](const std::string &tubeID, int numCards)
+            {
+                addKey(list, tubeID, numCards, entry++);
+                return true;
+            });
+
+        if (numRows < 0) { return false; }
+        m_summaries[list] = CoverageSummary();
+        m_summaries[list].numEntries = entry;
+    }
+
+    long numRows = db.dbForEachRow(tableName,
+        [&](const std::string* text, const double*)
+        {
+            addKey(SET_CATALOGUE, text[TUBE_ID], 0, 0);
+            return true;
+        });
+
+    CardPipeline pipeline(numWorkers);
+    long numCards = pipeline.run(db, tableName,
+        [&](const GeneratedCard &card)
+        {
+            addKey(SET_GENERATED, card.tubeID, 0, 0);
+        });
+
+    if (numRows < 0 || numCards < 0) { return false; }
+
+
+    // the only sort, full names of a list entry before its aliases
+    for (unsigned int set = 0; set < NUM_COVERAGE_SETS; set++)
+    {
+        std::sort(m_keys[set].begin(), m_keys[set].end(),
+            [](const CoverageKey &a, const CoverageKey &b)
+            {
+                int order = a.key.compare(b.key);
+                return order < 0 || (order == 0 && !a.alias && b.alias);
+            });
+    }
+
+    join();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to print every listed tube, one per line: tube ID, numCards of
+//  each list it is on, then the generated cards or why there are none, then a
+//  summary of each list
+void CoverageReport::print(std::ostream &out) const
+{
+    for (auto it = m_rows.begin(); it != m_rows.end(); it++)
+    {
+        bool listed = false;
+        bool mismatched = false;
+
+        for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+        {
+            if (it->numCards[list] == COVERAGE_NOT_LISTED) { continue; }
+
+            out << (listed ? " " : it->tubeID + " ") <<
+                COVERAGE_LISTS[list].name << ":" << it->numCards[list];
+            listed = true;
+            mismatched = mismatched ||
+                it->numCards[list] != int(it->numGenerated);
+        }
+
+        if (!listed) { continue; }
+
+        if (it->numRows == 0) { out << " not in catalogue\n"; }
+        else if (it->numGenerated == 0) { out << " no valid card\n"; }
+        else
+        {
+            out << " generated " << it->numGenerated <<
+                (mismatched ? " mismatch\n" : "\n");
+        }
+    }
+
+    for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+    {
+        const CoverageSummary &summary = m_summaries[list];
+        out << COVERAGE_LISTS[list].table << ": " << summary.numEntries <<
+            " entries, " << summary.numInCatalogue << " in catalogue, " <<
+            summary.numGenerated << " generated, " << summary.numMismatched <<
+            " with another number of cards\n";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to normalize a tube ID: upper case without white space
+std::string CoverageReport::normalizeID(const std::string &tubeID)
+{
+    std::string key;
+    key.reserve(tubeID.size());
+
+    for (auto it = tubeID.begin(); it != tubeID.end(); it++)
+    {
+        unsigned char c = *it;
+        if (!std::isspace(c)) { key += std::toupper(c); }
+    }
+
+    return key;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: table name of a list
+const char* CoverageReport::listTable(CoverageList list)
+{
+    return COVERAGE_LISTS[list].table;
+}
+
+//------------------------------------------------------------------------------
+
+// adds a key.  Lists give the other names of a tube after '/', i.e.
+//  "0E3/85A1", so each name of a list entry is added as an alias too.  The
+//  catalogue uses '/' within names, i.e. "3A/107A", and is not split
+void CoverageReport::addKey(unsigned int set,
+                            const std::string &tubeID,
+                            int numCards,
+                            unsigned int entry)
+{
+    CoverageKey key = {normalizeID(tubeID), false, numCards, entry};
+    if (key.key.empty()) { return; }
+
+    m_keys[set].push_back(key);
+    if (set >= NUM_COVERAGE_LISTS ||
+        key.key.find('/') == std::string::npos)
+    {
+        return;
+    }
+
+    std::string name = key.key;
+    key.alias = true;
+
+    for (size_t begin = 0, end = 0; end != std::string::npos; begin = end + 1)
+    {
+        end = name.find('/', begin);
+        key.key = name.substr(begin,
+            end == std::string::npos ? std::string::npos : end - begin);
+
+        if (!key.key.empty()) { m_keys[set].push_back(key); }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// joins the sorted sets into m_rows and the summaries.  Each step takes the
+//  smallest key at the cursors and moves every cursor past it, so every key
+//  is visited once.  A list entry is then counted as found if any of its
+//  names is in the catalogue, and rows of names that add nothing are dropped:
+//  aliases outside the catalogue, and full names of entries found by alias
+void CoverageReport::join()
+{
+    size_t cursors[NUM_COVERAGE_SETS] = {};
+    std::vector<CoverageKey> listKeys;      // list key of each row and list
+    std::vector<bool> listed;
+
+    while (true)
+    {
+        const std::string* smallest = NULL;
+        for (unsigned int set = 0; set < NUM_COVERAGE_SETS; set++)
+        {
+            if (cursors[set] < m_keys[set].size() && (smallest == NULL ||
+                m_keys[set][cursors[set]].key < *smallest))
+            {
+                smallest = &m_keys[set][cursors[set]].key;
+            }
+        }
+
+        if (smallest == NULL) { break; }
+
+
+        CoverageRow row;
+        row.tubeID = *smallest;
+        row.numRows = 0;
+        row.numGenerated = 0;
+
+        for (unsigned int set = 0; set < NUM_COVERAGE_SETS; set++)
+        {
+            const std::vector<CoverageKey> &keys = m_keys[set];
+            size_t first = cursors[set];
+            size_t &cursor = cursors[set];
+
+            while (cursor < keys.size() && keys[cursor].key == row.tubeID)
+            {
+                cursor++;
+            }
+
+            if (set == SET_CATALOGUE) { row.numRows = cursor - first; }
+            else if (set == SET_GENERATED)
+            {
+                row.numGenerated = cursor - first;
+            }
+
+            // a name on two entries of a list keeps the first, full names
+            //  sort first
+            else
+            {
+                bool found = cursor > first;
+                row.numCards[set] = found ? keys[first].numCards :
+                    COVERAGE_NOT_LISTED;
+                listKeys.push_back(found ? keys[first] : CoverageKey());
+                listed.push_back(found);
+            }
+        }
+
+        m_rows.push_back(row);
+    }
+
+
+    // state of each list entry
+    std::vector<unsigned char> states[NUM_COVERAGE_LISTS];
+    for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+    {
+        states[list].assign(m_summaries[list].numEntries, 0);
+    }
+
+    for (size_t r = 0; r < m_rows.size(); r++)
+    {
+        const CoverageRow &row = m_rows[r];
+
+        for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+        {
+            size_t i = r * NUM_COVERAGE_LISTS + list;
+            if (!listed[i] || row.numRows == 0) { continue; }
+
+            unsigned char &state = states[list][listKeys[i].entry];
+            state |= ENTRY_IN_CATALOGUE;
+
+            if (row.numGenerated > 0)
+            {
+                state |= ENTRY_GENERATED;
+                if (int(row.numGenerated) != row.numCards[list])
+                {
+                    state |= ENTRY_MISMATCHED;
+                }
+            }
+        }
+    }
+
+    for (unsigned int list = 0; list < NUM_COVERAGE_LISTS; list++)
+    {
+        for (auto it = states[list].begin(); it != states[list].end(); it++)
+        {
+            CoverageSummary &summary = m_summaries[list];
+            summary.numInCatalogue += (*it & ENTRY_IN_CATALOGUE) != 0;
+            summary.numGenerated += (*it & ENTRY_GENERATED) != 0;
+            summary.numMismatched += (*it & ENTRY_MISMATCHED) != 0;
+        }
+    }
+
+
+    // drop rows in place, keeping the order
+    size_t kept = 0;
+    for (size_t r = 0; r < m_rows.size(); r++)
+    {
+        bool keep = m_rows[r].numRows > 0;
+
+        for (unsigned int list = 0; list < NUM_COVERAGE_LISTS && !keep; list++)
+        {
+            size_t i = r * NUM_COVERAGE_LISTS + list;
+            keep = listed[i] && !listKeys[i].alias &&
+                !(states[list][listKeys[i].entry] & ENTRY_IN_CATALOGUE);
+        }
+
+        if (keep)
+        {
+            if (kept != r) { m_rows[kept] = std::move(m_rows[r]); }
+            kept++;
+        }
+    }
+
+    m_rows.resize(kept);
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
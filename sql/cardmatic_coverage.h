@@ -0,0 +1,170 @@
+//    Cardmatic card generator - cardmatic_coverage.h file
+//    C++11 header file
+
+//    Coverage of the official card lists.  The tube IDs of the lists, of the
+//      AVO catalogue and of the generated cards are normalized and sorted
+//      once, then merge joined in a single pass, giving for every tube the
+//      lists it is on, its official number of cards and the number of cards
+//      generated for it.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_COVERAGE_H
+#define CARDMATIC_COVERAGE_H
+
+#include "cardmatic_sql.h"
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+#define COVERAGE_NOT_LISTED -1      // numCards of a tube missing from a list
+
+
+
+//------------------------------------------------------------------------------
+//  enum
+//------------------------------------------------------------------------------
+
+// official card lists
+typedef enum CoverageList
+{
+    LIST_WE,            // ListWETubes
+    LIST_118,           // List118Cards
+    LIST_123,           // List123Cards
+    NUM_COVERAGE_LISTS,
+}CoverageList;
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// a tube of the join, in tube ID order
+typedef struct CoverageRow
+{
+    std::string tubeID;                     // normalized
+    int numCards[NUM_COVERAGE_LISTS];       // or COVERAGE_NOT_LISTED
+    unsigned int numRows;                   // catalogue rows, 0 = not in it
+    unsigned int numGenerated;              // cards generated
+}CoverageRow;
+
+
+// list entries, an entry is counted once however many aliases it has
+typedef struct CoverageSummary
+{
+    unsigned int numEntries;
+    unsigned int numInCatalogue;    // entries found in the catalogue
+    unsigned int numGenerated;      // entries with generated cards
+    unsigned int numMismatched;     // generated, but not numCards cards
+}CoverageSummary;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CoverageReport
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        CoverageReport();
+
+        ~CoverageReport();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to load the official lists and the catalogue, generate
+        //  the cards of the catalogue and join them
+        // pre: db is open
+        // param:   db - database holding the lists and the catalogue
+        //          tableName - catalogue in AVOcardmatic format
+        //          numWorkers - card generating threads, 0 = one per core
+        // returns: false if a table cannot be read
+        bool build(Database &db,
+                   std::string tableName,
+                   unsigned int numWorkers = 0);
+
+
+        // function to print every listed tube, one per line:
+        //  tube ID, numCards of each list it is on, then the generated cards
+        //  or why there are none, then a summary of each list
+        void print(std::ostream &out) const;
+
+
+        // function to normalize a tube ID: upper case without white space
+        static std::string normalizeID(const std::string &tubeID);
+
+
+        // tubes on a list or in the catalogue, in tube ID order
+        const std::vector<CoverageRow> &getRows() const { return m_rows; }
+
+        const CoverageSummary &getSummary(CoverageList list) const
+        {
+            return m_summaries[list];
+        }
+
+        // returns: table name of a list
+        static const char* listTable(CoverageList list);
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  enum and struct
+        //----------------------------------------------------------------------
+
+        // inputs of the join, the lists come first
+        typedef enum CoverageSet
+        {
+            SET_CATALOGUE = NUM_COVERAGE_LISTS,     // one key per row
+            SET_GENERATED,                          // one key per card
+            NUM_COVERAGE_SETS,
+        }CoverageSet;
+
+
+        typedef struct CoverageKey
+        {
+            std::string key;            // normalized tube ID
+            bool alias;                 // one name of a "A/B" list entry
+            int numCards;               // lists only
+            unsigned int entry;         // list row, lists only
+        }CoverageKey;
+
+
+
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        std::vector<CoverageKey> m_keys[NUM_COVERAGE_SETS];
+        std::vector<CoverageRow> m_rows;
+        CoverageSummary m_summaries[NUM_COVERAGE_LISTS];
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // adds a key, and the names of a list entry separated by '/'
+        void addKey(unsigned int set,
+                    const std::string &tubeID,
+                    int numCards,
+                    unsigned int entry);
+
+        // joins the sorted sets into m_rows and the summaries
+        void join();
+};
+
+#endif // CARDMATIC_COVERAGE_H
@@ -7,44 +7,80 @@
 //    Written by: cathug
 
 
-#include <regex>
 #include <utility>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include "cardmatic_dataconvert.h"
+#include "cardmatic_quantize.h"
 #include <iostream>
 
 
+#define AVO_CODE_UNKNOWN 0xFF   // AVO_CODE_ROWS entry of a non switch code
+
+
+
+//------------------------------------------------------------------------------
+// Switch code table
+//------------------------------------------------------------------------------
+
+// maps an AVO switch code to a cardmatic row number, 0 if nothing to map
+static constexpr unsigned char avoCodeRow(unsigned int code)
+{
+    return code == '0' ? 0 :    // nothing to map
+        code == '1' ? 4 :       // cathode
+        code == '2' ? 2 :       // heater-
+        code == '3' ? 1 :       // heater+
+        code == '4' ? 3 :       // control grid 1
+        code == '5' ? 6 :       // control grid 2
+        code == '6' ? 6 :       // control grid 3 (second card)
+        code == '7' ? 5 :       // screen grid
+        code == '8' ? 7 :       // anode
+        code == '9' ? 7 :       // 1st diode anode
+        code == 'X' ? 7 :       // 2nd diode anode (second card)
+        code == 'Y' ? 7 :       // 3rd diode anode (third card)
+        code == 'Z' ? 7 :       // 4th diode anode (forth card)
+        AVO_CODE_UNKNOWN;
+}
+
+#define AVO_CODE_ROWS_16(c) \
+    avoCodeRow(c), avoCodeRow(c + 1), avoCodeRow(c + 2), avoCodeRow(c + 3), \
+    avoCodeRow(c + 4), avoCodeRow(c + 5), avoCodeRow(c + 6), \
+    avoCodeRow(c + 7), avoCodeRow(c + 8), avoCodeRow(c + 9), \
+    avoCodeRow(c + 10), avoCodeRow(c + 11), avoCodeRow(c + 12), \
+    avoCodeRow(c + 13), avoCodeRow(c + 14), avoCodeRow(c + 15)
+
+// cardmatic row of every character, shared by all converters
+static constexpr unsigned char AVO_CODE_ROWS[256] = {
+    AVO_CODE_ROWS_16(0x00), AVO_CODE_ROWS_16(0x10), AVO_CODE_ROWS_16(0x20),
+    AVO_CODE_ROWS_16(0x30), AVO_CODE_ROWS_16(0x40), AVO_CODE_ROWS_16(0x50),
+    AVO_CODE_ROWS_16(0x60), AVO_CODE_ROWS_16(0x70), AVO_CODE_ROWS_16(0x80),
+    AVO_CODE_ROWS_16(0x90), AVO_CODE_ROWS_16(0xA0), AVO_CODE_ROWS_16(0xB0),
+    AVO_CODE_ROWS_16(0xC0), AVO_CODE_ROWS_16(0xD0), AVO_CODE_ROWS_16(0xE0),
+    AVO_CODE_ROWS_16(0xF0),
+};
+
+
+
 
 //------------------------------------------------------------------------------
 // Implementation
 //------------------------------------------------------------------------------
 
+// the implicit moves keep a std::vector of DataConverter from copying
+//  cardreaders
+static_assert(std::is_nothrow_move_constructible<DataConverter>::value &&
+              std::is_nothrow_move_assignable<DataConverter>::value,
+              "DataConverter is not nothrow movable");
+
 // default constructor
 DataConverter::DataConverter() :
-    AVOSwitchCodeToCardmaticRow {
-        {'0', 0},   // nothing to map.
-        {'1', 4},   // map cathode to           cardmatic row 4
-        {'2', 2},   // map heater- to           cardmatic row 2
-        {'3', 1},   // map heater+ to           cardmatic row 1
-        {'4', 3},   // map control grid 1 to    cardmatic row 3
-        {'5', 6},   // map control grid 2 to    cardmatic row 6
-        {'6', 6},   // map control grid 3 to    cardmatic row 6 (second card)
-        {'7', 5},   // map screen grid to       cardmatic row 5
-        {'8', 7},   // map anode to             cardmatic row 7
-        {'9', 7},   // map 1st diode anode to   cardmatic row 7
-        {'X', 7},   // map 2nd diode anode to   cardmatic row 7 (second card)
-        {'Y', 7},   // map 3rd diode anode to   cardmatic row 7 (third card)
-        {'Z', 7}    // map 4th diode anode to   cardmatic row 7 (forth card)
-    }
+    verbose(true),
+    bPlusMaxCurrent(TubeTests::modelLimits(CARDMATIC_MODEL)->bPlusMaxCurrent)
 {
 
 }
 
-//------------------------------------------------------------------------------
-
-// default destructor
-DataConverter::~DataConverter()
-{
-};   
 
 //------------------------------------------------------------------------------
 
@@ -58,15 +94,80 @@ DataConverter::~DataConverter()
 bool DataConverter::parseAVOData(const std::string* VCM163_text, 
                                  const double* VCM163_double)
 //                                 const unsigned int num_entries)
+{
+    if (VCM163_double == NULL || VCM163_text == NULL) { return false; }
+
+    return mapPinSwitches(VCM163_text, swClose);
+}
+
+//------------------------------------------------------------------------------
+
+// function converting a row of AVO test data to a complete card: pin
+//  switches, heater, bias, B+ and meter.  Pins are mapped straight into the
+//  switches of tests, so the test sees and can open them
+// pre: VCM163_double and VCM163_text are in proper AVO VCM163 formatting
+// param:   VCM163_text - tube type, switch setting, topcap, base, class
+//          VCM163_double - tube test parameters Vh, Vg1, Va, Vg2, Ia, gm
+//          section - row number of the tube, starting at 0
+//          tests - scratch object, left holding the card's switches
+//          card - set to the card if successful
+// returns: CONVERT_OK if successful, otherwise the reason of failure
+ConvertStatus DataConverter::convertAVOData(const std::string* VCM163_text,
+                                            const double* VCM163_double,
+                                            unsigned int section,
+                                            TubeTests &tests,
+                                            SwitchMatrix &card)
+{
+    TestParam param;
+    Tube::TubeType tubeType;
+    std::string recipe;
+
+    tests.resetSwitches();
+
+    if (VCM163_double == NULL || VCM163_text == NULL ||
+        !mapPinSwitches(VCM163_text, tests.getClosedSwitches()))
+    {
+        return CONVERT_MAP_ERROR;
+    }
+
+    if (!getTestParam(VCM163_double, param) ||
+        !TubeTests::avoSectionTest(VCM163_text[CLASS], section, tubeType,
+            recipe))
+    {
+        return CONVERT_NO_TEST;
+    }
+
+    tests.setTestParam(param);
+    if (!tests.runTest(recipe)) { return CONVERT_OUT_OF_RANGE; }
+
+
+    const CardReader &switches = tests.getClosedSwitches();
+    card = SwitchMatrix();
+
+    for (auto it = switches.begin(); it != switches.end(); it++)
+    {
+        int index = SwitchMatrix::switchIndex(it->first, it->second);
+        if (index < 0) { return CONVERT_INVALID_SWITCH; }
+
+        card.setBit(index);
+    }
+
+    return CONVERT_OK;
+}
+
+//------------------------------------------------------------------------------
+
+// helper mapping the top cap and switch settings to pin switches
+// param:   VCM163_text - tube type, switch setting, topcap, base, class
+//          switches - set of switches to add the pin switches to
+// returns: true if mapping is sucessful, false otherwise
+bool DataConverter::mapPinSwitches(const std::string* VCM163_text,
+                                   CardReader &switches)
 {
     char switch_column_index = 'A';
     unsigned int numTubePins;
     TopCapStatus cap_status;
-//    auto mapping;
-//    auto it;
 
-    if (VCM163_double == NULL || VCM163_text == NULL) { return false; }
-  
     // Cardmatic can test only tubes with only max 9 pins.
     // Also each tube has at least 2 pins.
     numTubePins = getNumTubePins(VCM163_text[BASE]); 
@@ -78,24 +179,32 @@ bool DataConverter::parseAVOData(const std::string* VCM163_text,
     if (cap_status == CANNOT_TEST) { return false; }
     else if (cap_status == HAS_TOP_CAP)
     {
-        std::cout << "Processing AVO VCM163 Top Cap Settings." << std::endl;
+        if (verbose)
+        {
+            std::cout << "Processing AVO VCM163 Top Cap Settings." << std::endl;
+        }
+
         for (auto it = VCM163_text[TOP_CAP].begin(); 
             it < VCM163_text[TOP_CAP].end(); it++)
         {
             if (setCardmaticSwitchUsingAVOSwitchCode(*it, 
-                'K') == false) { return false; } 
+                'K', switches) == false) { return false; } 
         }
     } // do nothing if cap_status == NO_TOP_CAP
     
     
-    std::cout << "Processing AVO VCM163 Switch Settings." << std::endl;
+    if (verbose)
+    {
+        std::cout << "Processing AVO VCM163 Switch Settings." << std::endl;
+    }
+
     for (auto it = VCM163_text[SWITCH_SETTINGS].begin(); 
         it < VCM163_text[SWITCH_SETTINGS].end(); it++)
     {
         if (*it != ' ')
         {
             if (setCardmaticSwitchUsingAVOSwitchCode(*it, 
-                switch_column_index) == false) { return false; }
+                switch_column_index, switches) == false) { return false; }
             
             // fix the missing 'I' column
             if (switch_column_index == 'H') { switch_column_index += 2; }
@@ -103,8 +212,163 @@ bool DataConverter::parseAVOData(const std::string* VCM163_text,
         }
     }
     
-    // TODO: need to add test parameters
-    
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to check the pins of a row of AVO test data: the base is
+//  testable, every pin used is on the base, and no pin column is given two
+//  roles.  Pins are walked like mapPinSwitches(), folding each into a mask
+// param:  VCM163_text - tube type, switch setting, topcap, base, class
+//         section - row number of the tube, starting at 0
+// returns: diagnostic of the first fault, or status TUBE_PINS_OK
+Tube::PinDiagnostic DataConverter::checkAVOPins(
+    const std::string* VCM163_text,
+    unsigned int section)
+{
+    Tube::PinDiagnostic diagnostic = {Tube::TUBE_PINS_OK, section, '\0', 0};
+    uint16_t roles[TUBE_NUM_PINS] = {};     // role bits per pin bit
+    uint16_t mask = 0;
+
+    unsigned int numTubePins = getNumTubePins(VCM163_text[BASE]);
+    if (numTubePins < 2 || numTubePins > 9)
+    {
+        diagnostic.status = Tube::TUBE_INVALID_PIN_ASSIGN;
+        return diagnostic;
+    }
+
+
+    // top cap codes first, then one code per pin
+    const std::string &cap = VCM163_text[TOP_CAP];
+    const std::string &sw = VCM163_text[SWITCH_SETTINGS];
+    char pin = Tube::PIN_1;
+    unsigned int position = 0;
+
+    for (size_t i = 0; i < cap.size() + sw.size(); i++)
+    {
+        bool isCap = i < cap.size();
+        char code = isCap ? cap[i] : sw[i - cap.size()];
+
+        if (!isCap && code == ' ') { continue; }
+
+        char column = isCap ? char(Tube::PIN_CAP) : pin;
+        if (!isCap)
+        {
+            pin = pin == Tube::PIN_8 ? Tube::PIN_9 : pin + 1;
+            position++;
+        }
+
+        if (code == '0') { continue; }
+
+
+        int role = avoCodeRole(code);
+        bool onBase = isCap || position <= numTubePins;
+        uint16_t bit = Tube::pinBit(column);
+
+        if (role < 0 || !onBase || (bit & TUBE_PIN_INVALID))
+        {
+            diagnostic.status = Tube::TUBE_INVALID_PIN_ASSIGN;
+            diagnostic.pin = column;
+            diagnostic.roles = role < 0 ? 0 : 1 << role;
+            return diagnostic;
+        }
+
+        unsigned int index = SwitchMatrix::popCount(bit - 1);
+        roles[index] |= 1 << role;
+
+        // a second code on the same column
+        if (mask & bit)
+        {
+            diagnostic.status = Tube::TUBE_PINS_NOT_UNIQUE;
+            diagnostic.pin = column;
+            diagnostic.roles = roles[index];
+            return diagnostic;
+        }
+
+        mask |= bit;
+    }
+
+    return diagnostic;
+}
+
+//------------------------------------------------------------------------------
+
+// helper giving the role of an AVO switch code
+// param: AVOSwitchCode - one of AVO switch code 1-9, X-Z
+// returns: Tube::PinRole, or -1 if the code is unknown
+int DataConverter::avoCodeRole(const char AVOSwitchCode)
+{
+    switch (AVOSwitchCode)
+    {
+        case '1': return Tube::ROLE_CATHODE;
+        case '2': return Tube::ROLE_FIL_NEG;
+        case '3': return Tube::ROLE_FIL_POS;
+        case '4': return Tube::ROLE_GRID;
+        case '5': case '6': return Tube::ROLE_SUPPRESSOR;  // grids 2, 3
+        case '7': return Tube::ROLE_SCREEN;
+        case '8': case '9': case 'X': case 'Y': case 'Z':
+            return Tube::ROLE_PLATE;                        // anodes
+        default: return -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to derive the test conditions of a row of AVO test data.  B+
+//  and the meter ranges are those of CatalogueQuantizer::quantizeRow(): the
+//  nearest regulated step the supply is rated for the plate current at,
+//  with meters set so the nominal reading, scaled to that step, is at half
+//  scale
+// pre: VCM163_double is in proper AVO VCM163 formatting
+// param:  VCM163_double - tube test parameters Vh, Vg1, Va, Vg2, Ia, gm, NaN
+//             if missing
+//         param - set to the test conditions
+// returns: false if the heater voltage is missing, true otherwise
+bool DataConverter::getTestParam(const double* VCM163_double,
+                                 TestParam &param)
+{
+    double vAnode = VCM163_double[V_ANODE];
+    double iAnode = VCM163_double[I_ANODE];     // mA
+
+    param = TestParam();
+    if (std::isnan(VCM163_double[HEATER])) { return false; }
+
+    param.heater = VCM163_double[HEATER];
+    param.leakage = true;
+
+    // AVO lists the negative grid bias without sign.  The VCM163 applies it
+    //  from its grid supply with the cathode at 0V, so the card uses fixed
+    //  bias (L14, cathode supply to 0V) rather than self bias (K14)
+    if (!std::isnan(VCM163_double[V_GRID1]))
+    {
+        param.bias = -std::fabs(VCM163_double[V_GRID1]);
+    }
+    param.fixedBias = true;
+
+    if (!std::isnan(iAnode) && iAnode > 0 && !std::isnan(vAnode))
+    {
+        param.load = lround(vAnode * 1000 / iAnode / DECADE_RES_INC) *
+            DECADE_RES_INC;
+    }
+
+    // peak inverse voltage of a half wave rectifier with capacitor input
+    if (!std::isnan(vAnode))
+    {
+        param.maxInverse = lround(2 * M_SQRT2 * vAnode);
+    }
+
+    // heater and bias are rounded to their steps by TubeTests
+    QuantizedRow row;
+    CatalogueQuantizer::quantizeRow(VCM163_double[HEATER],
+        VCM163_double[V_GRID1], vAnode, iAnode, VCM163_double[GM],
+        bPlusMaxCurrent, row);
+
+    param.bPlus = row.bPlus;
+    param.current = row.current;
+    param.maFS = row.maFS;
+    param.umhoFS = row.umhoFS;
+
     return true;
 }
 
@@ -115,7 +379,7 @@ bool DataConverter::parseAVOData(const std::string* VCM163_text,
 // pre: string length of two
 // param: AVOtopCapValue: top cap data from AVO settings manual
 // returns: NO_TOP_CAP, HAS_TOP_CAP, or CANNOT_TEST
-TopCapStatus DataConverter::tubeHasTopCap(const std::string AVOtopCapValue)
+TopCapStatus DataConverter::tubeHasTopCap(const std::string &AVOtopCapValue)
 {
     if (AVOtopCapValue.length() == 2)
     {
@@ -141,17 +405,20 @@ TopCapStatus DataConverter::tubeHasTopCap(const std::string AVOtopCapValue)
 // helper using switch code as per AVO23 manual to set Cardmatic switch
 // param:   AVOSwitchCode - a switch setting substring of size 1 
 //          cardmaticTubePinPos - tube pin position in cardmatic nomenclature
+//          switches - set of switches to add the switch to
 // returns: false if mapping not found; otherwise return true
 bool DataConverter::setCardmaticSwitchUsingAVOSwitchCode(
     const char AVOSwitchCode, 
-    const char cardmaticTubePinPos)
+    const char cardmaticTubePinPos,
+    CardReader &switches)
 {
-    auto mapping = AVOSwitchCodeToCardmaticRow.find(AVOSwitchCode);
-    if (mapping == AVOSwitchCodeToCardmaticRow.end() ) { return false; }
+    unsigned char row =
+        AVO_CODE_ROWS[static_cast<unsigned char>(AVOSwitchCode)];
+    if (row == AVO_CODE_UNKNOWN) { return false; }
             
-    if (mapping->second != 0)
+    if (row != 0)
     {
-        swClose.insert( std::make_pair(cardmaticTubePinPos, mapping->second) );
+        switches.insert( std::make_pair(cardmaticTubePinPos, row) );
 //        std::cout << "just inserted in swClose: " << cardmaticTubePinPos << 
 //            mapping->second << std::endl;
     }
@@ -165,21 +432,24 @@ bool DataConverter::setCardmaticSwitchUsingAVOSwitchCode(
 // pre: the tube base must contain at least one digit
 // param: tubeBase: tube base data from AVO settings manual
 // returns: number of pins on tube base, or 0 if tube base is invalid
-unsigned int DataConverter::getNumTubePins(const std::string tubeBase)
+unsigned int DataConverter::getNumTubePins(const std::string &tubeBase)
 {
     // possible cases
     //    5AA, 7AA, 8SC, A08, A10, A12, B3G, B5, B4, B5A, B5B, B7, 
     //    B7A, B7G, B8A, B8B, B8G, B8D, B9, B9A, B9D, B9G, B10B,
     //    F8, M08, NV5, NV7, SM4, SM5, SM7, UX4, UX5, UX6, UX7 
 
-    std::regex reg("\\d+"); // keep digits only
-    std::smatch match;
-    if (std::regex_search(tubeBase, match, reg) )
+    // first run of digits
+    auto it = std::find_if(tubeBase.begin(), tubeBase.end(),
+        [](char c) { return c >= '0' && c <= '9'; });
+    unsigned int numPins = 0;
+
+    for (; it != tubeBase.end() && *it >= '0' && *it <= '9'; it++)
     {
-        for (auto value: match) { return std::stoi(value, nullptr); }  
-    }  
-    
-    return 0; 
+        numPins = numPins * 10 + (*it - '0');
+    }
+
+    return numPins; 
 }
 
 //------------------------------------------------------------------------------
@@ -205,8 +475,29 @@ MappingStatus DataConverter::cardNumber(const char AVOSwitchCode)
     }
 
     return MAP_CARD1;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to derive number of test cards required to test tube
+// param: AVOSwitchSettings: switch settings from AVO settings manual
+// returns: MAP_ERROR if a switch code is invalid, otherwise the largest card
+//          number of all switch codes
+MappingStatus DataConverter::cardsRequired(const std::string AVOSwitchSettings)
+{
+    MappingStatus numCards = MAP_CARD1;
+    
+    for (auto it = AVOSwitchSettings.begin(); 
+        it != AVOSwitchSettings.end(); it++)
+    {
+        if (*it == ' ') { continue; }
+        
+        MappingStatus card = cardNumber(*it);
+        if (card == MAP_ERROR) { return MAP_ERROR; }
+        if (card > numCards) { numCards = card; }
+    }
     
-    // TODO: finish this
+    return numCards;
 }
 
 //------------------------------------------------------------------------------
@@ -12,6 +12,7 @@
 
 #include <string>
 #include <unordered_map>
+#include "../cardmatic_cardpos.h"
 
 //------------------------------------------------------------------------------
 //  enums
@@ -56,6 +57,16 @@ typedef enum mappingStatus
 }MappingStatus;
 
 
+typedef enum convertStatus
+{
+    CONVERT_OK,
+    CONVERT_MAP_ERROR,          // pins cannot be mapped
+    CONVERT_NO_TEST,            // no test for the section, or no heater volts
+    CONVERT_OUT_OF_RANGE,       // test conditions out of range for the tester
+    CONVERT_INVALID_SWITCH,     // switch does not exist on the cardreader
+}ConvertStatus;
+
+
 
 //------------------------------------------------------------------------------
 //  Class
@@ -64,13 +75,11 @@ class DataConverter
 {
     public:
         //----------------------------------------------------------------------
-        //  constructor and destructor
+        //  constructor
         //----------------------------------------------------------------------
    
         DataConverter();    // default constructor
 
-        ~DataConverter();   // default destructor
-
 
 
         //----------------------------------------------------------------------                                                          
@@ -89,10 +98,101 @@ class DataConverter
 //                          const unsigned int num_entries);
                           
         
+        // function converting a row of AVO test data to a complete card: pin
+        //  switches, heater, bias, B+ and meter.  Pins are mapped straight
+        //  into the switches of tests, so the test sees and can open them.
+        //  If the plate current exceeds the regulated B+ rating, B+ is
+        //  lowered in steps and the expected current and gm scaled with it
+        // pre: VCM163_double and VCM163_text are in proper AVO VCM163
+        //      formatting
+        // param:  VCM163_text - tube type, switch setting, topcap, base, class
+        //         VCM163_double - tube test parameters Vh, Vg1, Va, Vg2, Ia, gm
+        //         section - row number of the tube, starting at 0
+        //         tests - scratch object, left holding the card's switches
+        //         card - set to the card if successful
+        // returns: CONVERT_OK if successful, otherwise the reason of failure
+        ConvertStatus convertAVOData(const std::string* VCM163_text,
+                                     const double* VCM163_double,
+                                     unsigned int section,
+                                     TubeTests &tests,
+                                     SwitchMatrix &card);
+
+
+        // function to derive the test conditions of a row of AVO test data.
+        //  B+ and the meter ranges are those of
+        //  CatalogueQuantizer::quantizeRow(): the nearest regulated step the
+        //  supply is rated for the plate current at, with meters set so the
+        //  nominal reading, scaled to that step, is at half scale
+        // pre: VCM163_double is in proper AVO VCM163 formatting
+        // param:  VCM163_double - tube test parameters Vh, Vg1, Va, Vg2, Ia,
+        //             gm, NaN if missing
+        //         param - set to the test conditions
+        // returns: false if the heater voltage is missing, true otherwise
+        bool getTestParam(const double* VCM163_double,
+                          TestParam &param);
+
+
+        // function to check the pins of a row of AVO test data: the base is
+        //  testable, every pin used is on the base, and no pin column is
+        //  given two roles
+        // param:  VCM163_text - tube type, switch setting, topcap, base, class
+        //         section - row number of the tube, starting at 0
+        // returns: diagnostic of the first fault, or status TUBE_PINS_OK
+        Tube::PinDiagnostic checkAVOPins(const std::string* VCM163_text,
+                                         unsigned int section);
+
+
         // function to print set of closed cardmatic switches
         void outputClosedCardmaticSwitches();
 
 
+        // helper to check if tube has no top cap, one top cap, or two top 
+        //  caps (cannot test)
+        // pre: string length of two
+        // param: AVOtopCapValue: top cap data from AVO settings manual
+        // returns: NO_TOP_CAP, HAS_TOP_CAP, or CANNOT_TEST
+        TopCapStatus tubeHasTopCap(const std::string &AVOtopCapValue);
+
+
+        // helper to extract number of pins from AVO tube base information
+        // pre: the tube base must contain at least one digit
+        // param: tubeBase: tube base data from AVO settings manual
+        // returns: number of pins on tube base, or 0 if tube base is invalid
+        unsigned int getNumTubePins(const std::string &tubeBase);
+        
+
+        // helper to derive number of test cards required to test tube
+        // param: AVOSwitchCode: one of AVO switch code 1-9, X-Z
+        // returns: MAP_ERROR, MAP_CARD1, MAP_CARD2, MAP_CARD3, MAP_CARD4
+        MappingStatus cardNumber(const char AVOSwitchCode);
+
+
+        // helper to derive number of test cards required to test tube
+        // param: AVOSwitchSettings: switch settings from AVO settings manual
+        // returns: MAP_ERROR if a switch code is invalid, otherwise the
+        //          largest card number of all switch codes
+        MappingStatus cardsRequired(const std::string AVOSwitchSettings);
+
+
+        // helper to reset the set of closed switches before parsing the next
+        //  tube
+        // post: all switches are open
+        void resetSwitches() { swClose.clear(); }
+
+
+        // progress messages of parseAVOData() are printed if verbose is set
+        void setVerbose(bool isVerbose) { verbose = isVerbose; }
+
+
+
+        //----------------------------------------------------------------------                                                          
+        //  accessors
+        //----------------------------------------------------------------------
+
+        const std::unordered_multimap<char,unsigned int> &getClosedSwitches() 
+            const { return swClose; }
+
+
 
 
     private:
@@ -104,46 +204,38 @@ class DataConverter
         std::unordered_multimap<char,unsigned int> swClose;  
 
 
-        // a dictionary that maps switch code parameter to cardmatic row number
-        const std::unordered_map<char, 
-            unsigned int> AVOSwitchCodeToCardmaticRow;
+        bool verbose;   // print progress messages
+        const unsigned int* bPlusMaxCurrent;    // of CARDMATIC_MODEL
         
         
         //----------------------------------------------------------------------
         //  helpers
         //----------------------------------------------------------------------
         
-        // TODO: need to add test parameters
-        // helper to check if tube has no top cap, one top cap, or two top 
-        //  caps (cannot test)
-        // pre: string length of two
-        // param: AVOtopCapValue: top cap data from AVO settings manual
-        // returns: NO_TOP_CAP, HAS_TOP_CAP, or CANNOT_TEST
-        TopCapStatus tubeHasTopCap(const std::string AVOtopCapValue);
-        
-        
+        // helper mapping the top cap and switch settings to pin switches
+        // param:   VCM163_text - tube type, switch setting, topcap, base, class
+        //          switches - set of switches to add the pin switches to
+        // returns: true if mapping is sucessful, false otherwise
+        bool mapPinSwitches(const std::string* VCM163_text,
+                            CardReader &switches);
+
+
+        // helper giving the role of an AVO switch code
+        // param: AVOSwitchCode - one of AVO switch code 1-9, X-Z
+        // returns: Tube::PinRole, or -1 if the code is unknown
+        static int avoCodeRole(const char AVOSwitchCode);
+
+
         // helper using switch code as per AVO23 manual to set Cardmatic switch
         // param:   AVOSwitchCode - a switch setting substring of size 1 
         //          cardmaticTubePinPos - tube pin position in cardmatic 
         //              nomenclature
+        //          switches - set of switches to add the switch to
         // returns: false if mapping not found; otherwise return true
         bool setCardmaticSwitchUsingAVOSwitchCode(
             const char AVOSwitchCode, 
-            const char cardmaticTubePinPos);
-            
-            
-        // helper to extract number of pins from AVO tube base information
-        // pre: the tube base must contain at least one digit
-        // param: tubeBase: tube base data from AVO settings manual
-        // returns: number of pins on tube base, or 0 if tube base is invalid
-        unsigned int getNumTubePins(const std::string tubeBase);
-        
-
-        // TODO: finish this
-        // helper to derive number of test cards required to test tube
-        // param: AVOSwitchCode: one of AVO switch code 1-9, X-Z
-        // returns: MAP_ERROR, MAP_CARD1, MAP_CARD2, MAP_CARD3, MAP_CARD4
-        MappingStatus cardNumber(const char AVOSwitchCode); 
+            const char cardmaticTubePinPos,
+            CardReader &switches);
 };
 
 #endif // CARDMATIC_DATACONVERT_H
@@ -0,0 +1,260 @@
+//    Cardmatic card generator - cardmatic_mpmcqueue.h file
+//    C++11 header file
+
+//    Bounded lock-free multi-producer/multi-consumer queue.  Each cell of a
+//      power of two ring carries a sequence number telling producers and
+//      consumers whether the cell is free or full, so a push or pop is one
+//      compare-and-swap on the shared position and no lock is taken.
+//      After D. Vyukov's bounded MPMC queue.  push() and pop() retry a few
+//      times, then sleep on a condition variable until the other side makes
+//      progress, so idle threads do not hold a core.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_MPMCQUEUE_H
+#define CARDMATIC_MPMCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+
+#define MPMC_CACHE_LINE 64      // keeps the two positions on separate lines
+#define MPMC_SPIN_LIMIT 128     // failed tries before push() or pop() sleeps
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+template <typename T>
+class MPMCQueue
+{
+    public:
+        // param: capacity - rounded up to a power of two, at least 2
+        explicit MPMCQueue(size_t capacity) :
+            m_mask(roundCapacity(capacity) - 1),
+            m_cells(new Cell[m_mask + 1]),
+            m_pushPos(0),
+            m_popPos(0),
+            m_numPushWaiting(0),
+            m_numPopWaiting(0),
+            m_closed(false)
+        {
+            for (size_t i = 0; i <= m_mask; i++)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MPMCQueue(const MPMCQueue &) = delete;
+        MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+
+        // function to append an item without waiting
+        // returns: false if the queue is full, item is left unchanged
+        bool tryPush(T &item)
+        {
+            if (!pushOnce(item)) { return false; }
+
+            wake(m_numPopWaiting, m_notEmpty);
+            return true;
+        }
+
+
+        // function to remove the oldest item without waiting
+        // returns: false if the queue is empty
+        bool tryPop(T &item)
+        {
+            if (!popOnce(item)) { return false; }
+
+            wake(m_numPushWaiting, m_notFull);
+            return true;
+        }
+
+
+        // function to append an item, waiting while the queue is full.
+        //  Retries MPMC_SPIN_LIMIT times, then sleeps until a pop makes room
+        // pre: close() was not called
+        void push(T &item)
+        {
+            for (unsigned int spin = 0; spin < MPMC_SPIN_LIMIT; spin++)
+            {
+                if (tryPush(item)) { return; }
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_numPushWaiting.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            while (!pushOnce(item)) { m_notFull.wait(lock); }
+
+            m_numPushWaiting.fetch_sub(1);
+            lock.unlock();
+            wake(m_numPopWaiting, m_notEmpty);
+        }
+
+
+        // function to remove the oldest item, waiting while the queue is
+        //  empty.  Retries MPMC_SPIN_LIMIT times, then sleeps until a push or
+        //  close()
+        // returns: false if the queue is closed and empty
+        bool pop(T &item)
+        {
+            for (unsigned int spin = 0; spin < MPMC_SPIN_LIMIT; spin++)
+            {
+                if (tryPop(item)) { return true; }
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_numPopWaiting.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool popped;
+            while (true)
+            {
+                // check before popping, no item is pushed after close()
+                bool closed = m_closed.load(std::memory_order_acquire);
+
+                if ((popped = popOnce(item)) || closed) { break; }
+                m_notEmpty.wait(lock);
+            }
+
+            m_numPopWaiting.fetch_sub(1);
+            lock.unlock();
+            if (popped) { wake(m_numPushWaiting, m_notFull); }
+            return popped;
+        }
+
+
+        // function to tell consumers that no more items will be pushed.
+        //  pop() returns false once the queue is drained
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed.store(true, std::memory_order_release);
+            m_notEmpty.notify_all();
+        }
+
+
+        size_t capacity() const { return m_mask + 1; }
+
+
+    private:
+        typedef struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        }Cell;
+
+
+        // appends an item without waking sleeping consumers
+        bool pushOnce(T &item)
+        {
+            size_t pos = m_pushPos.load(std::memory_order_relaxed);
+            Cell* cell;
+
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) -
+                    static_cast<intptr_t>(pos);
+
+                if (diff == 0)  // cell is free
+                {
+                    if (m_pushPos.compare_exchange_weak(pos, pos + 1,
+                            std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+
+                else if (diff < 0) { return false; }    // full
+
+                else { pos = m_pushPos.load(std::memory_order_relaxed); }
+            }
+
+            cell->data = std::move(item);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+
+        // removes the oldest item without waking sleeping producers
+        bool popOnce(T &item)
+        {
+            size_t pos = m_popPos.load(std::memory_order_relaxed);
+            Cell* cell;
+
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) -
+                    static_cast<intptr_t>(pos + 1);
+
+                if (diff == 0)  // cell is full
+                {
+                    if (m_popPos.compare_exchange_weak(pos, pos + 1,
+                            std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+
+                else if (diff < 0) { return false; }    // empty
+
+                else { pos = m_popPos.load(std::memory_order_relaxed); }
+            }
+
+            item = std::move(cell->data);
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+
+        // wakes a thread sleeping in push() or pop() after progress.  The
+        //  fence pairs with the one of the sleeper, so either the sleeper
+        //  sees the progress or this sees the sleeper
+        void wake(std::atomic<unsigned int> &numWaiting,
+                  std::condition_variable &condition)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (numWaiting.load(std::memory_order_relaxed) == 0) { return; }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            condition.notify_one();
+        }
+
+
+        static size_t roundCapacity(size_t capacity)
+        {
+            size_t rounded = 2;
+            while (rounded < capacity) { rounded <<= 1; }
+            return rounded;
+        }
+
+
+        const size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
+
+        alignas(MPMC_CACHE_LINE) std::atomic<size_t> m_pushPos;
+        alignas(MPMC_CACHE_LINE) std::atomic<size_t> m_popPos;
+        char m_padding[MPMC_CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+        // sleepers of push() and pop()
+        std::mutex m_mutex;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
+        std::atomic<unsigned int> m_numPushWaiting;
+        std::atomic<unsigned int> m_numPopWaiting;
+        std::atomic<bool> m_closed;
+};
+
+#endif // CARDMATIC_MPMCQUEUE_H
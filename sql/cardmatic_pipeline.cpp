@@ -0,0 +1,182 @@
+//    Cardmatic card generator - cardmatic_pipeline.cpp file
+//    C++11 implementation file
+
+//    Staged card generator.  Rows are streamed from the database, converted
+//      to pin switches, completed with the switches of each section's test
+//      and validated, then serialized.  One thread reads, a pool of workers
+//      converts and tests, and the calling thread serializes.  Bounded
+//      lock-free queues between the stages limit memory use and slow down
+//      faster stages.
+
+//    Written by: cathug
+
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "cardmatic_pipeline.h"
+#include "cardmatic_dataconvert.h"
+#include "../cardmatic_cardpos.h"
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   numWorkers - converting threads, 0 = one per core
+//          queueCapacity - items buffered between two stages
+CardPipeline::CardPipeline(unsigned int numWorkers,
+                           size_t queueCapacity) :
+    m_numWorkers(numWorkers > 0 ? numWorkers :
+        std::max(1u, std::thread::hardware_concurrency())),
+    m_queueCapacity(queueCapacity),
+    m_numRejected(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+CardPipeline::~CardPipeline()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to generate the cards of every row of a table
+// pre: db is open and is not used by other threads during the run
+// param:   db - database holding the tube data
+//          tableName - table in AVOcardmatic format
+//          sink - receives the cards in table order
+// returns: number of cards passed to sink, or -1 if reading fails
+long CardPipeline::run(Database &db,
+                       std::string tableName,
+                       const CardSink &sink)
+{
+    MPMCQueue<RowItem> rows(m_queueCapacity);
+    MPMCQueue<CardItem> cards(m_queueCapacity);
+    std::atomic<unsigned int> numWorking(m_numWorkers);
+    size_t numQueued = 0;
+    long numRead = 0;
+    long numEmitted = 0;
+    std::string lastTubeID;
+    unsigned int section = 0;
+
+    m_numRejected = 0;
+
+
+    // stage 1, stream rows
+    std::thread reader([&]()
+        {
+            numRead = db.dbForEachRow(tableName,
+                [&](const std::string* text, const double* values)
+                {
+                    // rows of a tube are adjacent
+                    section = text[TUBE_ID] == lastTubeID ? section + 1 : 0;
+                    lastTubeID = text[TUBE_ID];
+
+                    RowItem item;
+                    item.sequence = numQueued++;
+                    item.section = section;
+                    std::copy(text, text + NUM_TEXT_COLS_PER_ROW, item.text);
+                    std::copy(values, values + NUM_DOUBLE_COLS_PER_ROW,
+                        item.values);
+
+                    rows.push(item);
+                    return true;
+                });
+
+            rows.close();
+        });
+
+
+    // stages 2 and 3
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < m_numWorkers; i++)
+    {
+        workers.push_back(std::thread(&CardPipeline::workerLoop, this,
+            std::ref(rows), std::ref(cards), std::ref(numWorking)));
+    }
+
+
+    // stage 4, restore table order and serialize on the calling thread.
+    //  Cards finished ahead of an earlier row wait in pending
+    std::map<size_t, CardItem> pending;
+    std::unordered_map<std::string, int> numCards;  // cards per tube so far
+    size_t next = 0;
+    CardItem item;
+
+    // cards is closed by the last worker
+    while (cards.pop(item))
+    {
+        pending.insert(std::make_pair(item.sequence, std::move(item)));
+
+        for (auto it = pending.begin();
+            it != pending.end() && it->first == next;
+            it = pending.erase(it), next++)
+        {
+            CardItem &ready = it->second;
+
+            if (ready.valid == false)
+            {
+                m_numRejected++;
+                continue;
+            }
+
+            ready.card.testNum = ++numCards[ready.card.tubeID];
+            ready.card.closedSW = ready.matrix.toString();
+            sink(ready.card);
+            numEmitted++;
+        }
+    }
+
+    reader.join();
+    for (auto it = workers.begin(); it != workers.end(); it++) { it->join(); }
+
+    return numRead < 0 ? -1 : numEmitted;
+}
+
+//------------------------------------------------------------------------------
+
+// worker body, converts and tests rows until the reader closes rows and rows
+//  is drained.  Rows that cannot be mapped, whose test conditions are out of
+//  range, or that name switches that do not exist on the card reader, are
+//  passed on as invalid cards.  The last worker to finish closes cards
+void CardPipeline::workerLoop(MPMCQueue<RowItem> &rows,
+                              MPMCQueue<CardItem> &cards,
+                              std::atomic<unsigned int> &numWorking)
+{
+    DataConverter converter;
+    TubeTests tests;
+    RowItem row;
+
+    converter.setVerbose(false);
+
+    while (rows.pop(row))
+    {
+        CardItem item;
+        item.sequence = row.sequence;
+
+        // stages 2 and 3, map AVO switch codes, add the switches of the
+        //  section's test and validate
+        item.valid = converter.convertAVOData(row.text, row.values,
+            row.section, tests, item.matrix) == CONVERT_OK;
+        item.card.tubeID = row.text[TUBE_ID];
+        item.card.test = row.text[CLASS];
+        item.card.current = tests.getTestParam().current;
+
+        cards.push(item);
+    }
+
+    if (numWorking.fetch_sub(1) == 1) { cards.close(); }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
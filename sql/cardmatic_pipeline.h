@@ -0,0 +1,122 @@
+//    Cardmatic card generator - cardmatic_pipeline.h file
+//    C++11 header file
+
+//    Staged card generator.  Rows are streamed from the database, converted
+//      to pin switches, completed with the switches of each section's test
+//      and validated, then serialized.  One thread reads, a pool of workers
+//      converts and tests, and the calling thread serializes.  Bounded
+//      lock-free queues between the stages limit memory use and slow down
+//      faster stages.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_PIPELINE_H
+#define CARDMATIC_PIPELINE_H
+
+#include "cardmatic_sql.h"
+#include "../cardmatic_tube.h"
+#include "cardmatic_mpmcqueue.h"
+#include <string>
+#include <functional>
+#include <atomic>
+
+
+#define PIPELINE_QUEUE_CAPACITY 256     // items buffered between two stages
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CardPipeline
+{
+    public:
+        // receives each generated card, called on the thread calling run()
+        typedef std::function<void(const GeneratedCard &card)> CardSink;
+
+
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   numWorkers - converting threads, 0 = one per core
+        //          queueCapacity - items buffered between two stages
+        explicit CardPipeline(unsigned int numWorkers = 0,
+                              size_t queueCapacity = PIPELINE_QUEUE_CAPACITY);
+
+        ~CardPipeline();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to generate the cards of every row of a table
+        // pre: db is open and is not used by other threads during the run
+        // param:   db - database holding the tube data
+        //          tableName - table in AVOcardmatic format
+        //          sink - receives the cards in table order
+        // returns: number of cards passed to sink, or -1 if reading fails
+        long run(Database &db,
+                 std::string tableName,
+                 const CardSink &sink);
+
+
+        // number of rows dropped by the last run() because they could not be
+        //  mapped to valid switches
+        long getNumRejected() const { return m_numRejected; }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  structs
+        //----------------------------------------------------------------------
+
+        // a database row, output of the read stage
+        typedef struct RowItem
+        {
+            size_t sequence;        // row number, restores table order
+            unsigned int section;   // row number within the tube
+            std::string text[NUM_TEXT_COLS_PER_ROW];
+            double values[NUM_DOUBLE_COLS_PER_ROW];
+        }RowItem;
+
+
+        // a card, output of the workers.  Rejected rows are passed on as
+        // invalid cards so the writer can account for every row
+        typedef struct CardItem
+        {
+            size_t sequence;
+            bool valid;
+            GeneratedCard card;     // testNum is set by the writer
+            SwitchMatrix matrix;
+        }CardItem;
+
+
+
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        const unsigned int m_numWorkers;
+        const size_t m_queueCapacity;
+        long m_numRejected;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // worker body, converts and tests rows until the reader closes rows
+        //  and rows is drained.  The last worker to finish closes cards
+        void workerLoop(MPMCQueue<RowItem> &rows,
+                        MPMCQueue<CardItem> &cards,
+                        std::atomic<unsigned int> &numWorking);
+};
+
+#endif // CARDMATIC_PIPELINE_H
@@ -0,0 +1,308 @@
+//    Cardmatic card generator - cardmatic_punch.cpp file
+//    C++11 implementation file
+
+//    G-code output stage for a CNC punch.  Closed switches are mapped to
+//      hole positions on the card, cards are laid out on sheets and the holes
+//      of each card are ordered to shorten the travel of the punch head.
+
+//    Written by: cathug
+
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "cardmatic_punch.h"
+#include "../cardmatic_globals.h"
+
+
+#define PUNCH_MIN_GAIN 1e-9     // shortest 2-opt gain taken, in mm
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// default constructor, PUNCH_* layout
+PunchPlanner::PunchPlanner() :
+    m_layout(defaultLayout()),
+    m_numHoles(0),
+    m_numSheets(0),
+    m_travel(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   layout - card geometry and sheet layout
+PunchPlanner::PunchPlanner(const PunchLayout &layout) :
+    m_layout(layout),
+    m_numHoles(0),
+    m_numSheets(0),
+    m_travel(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+PunchPlanner::~PunchPlanner()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to write the punch program of a batch of cards.  Cards fill the
+//  sheets row by row, alternating direction so the head moves to a
+//  neighbouring card, and each sheet ends with M0 so the operator can load
+//  the next one, or M30 after the last sheet
+// param:   out - receives the G-code
+//          cards - cards in punch order
+// returns: false if a card names a switch the cardreader does not have, or
+//          the layout holds no card.  Nothing is written then
+bool PunchPlanner::writeGCode(std::ostream &out,
+                              const std::vector<GeneratedCard> &cards)
+{
+    size_t cardsPerSheet = m_layout.sheetColumns * m_layout.sheetRows;
+    if (cardsPerSheet == 0) { return false; }
+
+    std::vector<SwitchMatrix> matrices(cards.size());
+    for (size_t i = 0; i < cards.size(); i++)
+    {
+        if (!SwitchMatrix::fromString(cards[i].closedSW, matrices[i]))
+        {
+            return false;
+        }
+    }
+
+
+    m_numHoles = 0;
+    m_numSheets = (cards.size() + cardsPerSheet - 1) / cardsPerSheet;
+    m_travel = 0;
+
+    std::vector<int> order;
+    out << std::fixed << std::setprecision(3);
+
+    for (unsigned int sheet = 0; sheet < m_numSheets; sheet++)
+    {
+        out << "(cardmatic punch program, sheet " << sheet + 1 << " of " <<
+            m_numSheets << ")\n";
+        out << "G21\nG90\nG0 Z" << m_layout.retractZ << "\n";
+
+        double headX = 0;
+        double headY = 0;
+        bool cycle = false;     // G81 is modal once started
+        size_t first = sheet * cardsPerSheet;
+        size_t last = std::min(first + cardsPerSheet, cards.size());
+
+        for (size_t i = first; i < last; i++)
+        {
+            unsigned int row = (i - first) / m_layout.sheetColumns;
+            unsigned int column = (i - first) % m_layout.sheetColumns;
+            if (row % 2 == 1) { column = m_layout.sheetColumns - 1 - column; }
+
+            double originX = column * (m_layout.cardWidth + m_layout.cardGap);
+            double originY = row * (m_layout.cardHeight + m_layout.cardGap);
+
+            // parentheses would end the comment early
+            std::string label = cards[i].tubeID;
+            label.erase(std::remove_if(label.begin(), label.end(),
+                [](char c) { return c == '(' || c == ')'; }), label.end());
+            out << "(" << label << " card " << cards[i].testNum << ")\n";
+
+            m_travel += orderHoles(matrices[i], originX, originY, headX,
+                headY, order);
+            m_numHoles += order.size();
+
+            for (auto it = order.begin(); it != order.end(); it++)
+            {
+                double x, y;
+                holePosition(*it, originX, originY, x, y);
+
+                if (!cycle)
+                {
+                    out << "G81 X" << x << " Y" << y << " Z" <<
+                        m_layout.depthZ << " R" << m_layout.retractZ <<
+                        " F" << m_layout.feed << "\n";
+                    cycle = true;
+                }
+
+                else { out << "X" << x << " Y" << y << "\n"; }
+            }
+        }
+
+        if (cycle) { out << "G80\n"; }
+
+        m_travel += distance(headX, headY, 0, 0);
+        out << "G0 X0 Y0\n" <<
+            (sheet + 1 == m_numSheets ? "M30\n" : "M0 (load next sheet)\n");
+    }
+
+    return out.good();
+}
+
+//------------------------------------------------------------------------------
+
+// function to order the holes of one card, starting from the head position.
+//  Holes are ordered nearest neighbour first, then improved with 2-opt moves
+//  until none shortens the path.  The start at the head is fixed and the end
+//  of the path is free, so reversing a tail only changes one edge
+// param:   card - closed switches
+//          originX, originY - card corner on the sheet
+//          headX, headY - head position, set to the last hole
+//          order - set to the switch indices in punch order
+// returns: travel from the head position to the last hole
+double PunchPlanner::orderHoles(const SwitchMatrix &card,
+                                double originX,
+                                double originY,
+                                double &headX,
+                                double &headY,
+                                std::vector<int> &order) const
+{
+    std::vector<int> holes;
+    for (int i = 0; i < SW_NUM_SWITCHES; i++)
+    {
+        if (card.testBit(i)) { holes.push_back(i); }
+    }
+
+    order.clear();
+    size_t n = holes.size();
+    if (n == 0) { return 0; }
+
+    // distances between holes, row and column n are the head position
+    std::vector<double> x(n + 1);
+    std::vector<double> y(n + 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        holePosition(holes[i], originX, originY, x[i], y[i]);
+    }
+
+    x[n] = headX;
+    y[n] = headY;
+
+    std::vector<double> d((n + 1) * (n + 1));
+    for (size_t i = 0; i <= n; i++)
+    {
+        for (size_t j = 0; j <= n; j++)
+        {
+            d[i * (n + 1) + j] = distance(x[i], y[i], x[j], y[j]);
+        }
+    }
+
+
+    // nearest neighbour, path holds indices into holes
+    std::vector<size_t> path;
+    std::vector<bool> visited(n, false);
+    size_t from = n;
+
+    while (path.size() < n)
+    {
+        size_t nearest = n;
+
+        for (size_t j = 0; j < n; j++)
+        {
+            if (!visited[j] && (nearest == n ||
+                d[from * (n + 1) + j] < d[from * (n + 1) + nearest]))
+            {
+                nearest = j;
+            }
+        }
+
+        path.push_back(nearest);
+        visited[nearest] = true;
+        from = nearest;
+    }
+
+
+    // 2-opt, reverses path[i...j] if that shortens the path
+    auto dist = [&](size_t a, size_t b) { return d[a * (n + 1) + b]; };
+
+    bool improved = true;
+    while (improved)
+    {
+        improved = false;
+
+        for (size_t i = 0; i + 1 < n; i++)
+        {
+            size_t previous = i == 0 ? n : path[i - 1];
+
+            for (size_t j = i + 1; j < n; j++)
+            {
+                double gain = dist(previous, path[i]) -
+                    dist(previous, path[j]);
+
+                if (j + 1 < n)
+                {
+                    gain += dist(path[j], path[j + 1]) -
+                        dist(path[i], path[j + 1]);
+                }
+
+                if (gain > PUNCH_MIN_GAIN)
+                {
+                    std::reverse(path.begin() + i, path.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+    }
+
+
+    double travel = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        travel += dist(i == 0 ? n : path[i - 1], path[i]);
+        order.push_back(holes[path[i]]);
+    }
+
+    headX = x[path.back()];
+    headY = y[path.back()];
+    return travel;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: layout of the PUNCH_* values
+PunchLayout PunchPlanner::defaultLayout()
+{
+    PunchLayout layout = {PUNCH_HOLE_PITCH_X, PUNCH_HOLE_PITCH_Y,
+        PUNCH_FIRST_HOLE_X, PUNCH_FIRST_HOLE_Y, PUNCH_CARD_WIDTH,
+        PUNCH_CARD_HEIGHT, PUNCH_CARD_GAP, PUNCH_SHEET_COLUMNS,
+        PUNCH_SHEET_ROWS, PUNCH_RETRACT_Z, PUNCH_DEPTH_Z, PUNCH_FEED};
+
+    return layout;
+}
+
+//------------------------------------------------------------------------------
+
+// hole of a switch index on the sheet
+void PunchPlanner::holePosition(int index,
+                                double originX,
+                                double originY,
+                                double &x,
+                                double &y) const
+{
+    x = originX + m_layout.firstHoleX +
+        (index / SW_NUM_MAX) * m_layout.holePitchX;
+    y = originY + m_layout.firstHoleY +
+        (SwitchMatrix::indexNumber(index) - SW_NUM_MIN) * m_layout.holePitchY;
+}
+
+//------------------------------------------------------------------------------
+
+// travel between two positions.  Rapid moves drive both axes at once, so
+//  the longer axis sets the travel time
+double PunchPlanner::distance(double x1,
+                              double y1,
+                              double x2,
+                              double y2)
+{
+    return std::max(std::fabs(x2 - x1), std::fabs(y2 - y1));
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,166 @@
+//    Cardmatic card generator - cardmatic_punch.h file
+//    C++11 header file
+
+//    G-code output stage for a CNC punch.  Closed switches are mapped to
+//      hole positions on the card, cards are laid out on sheets and the holes
+//      of each card are ordered to shorten the travel of the punch head.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_PUNCH_H
+#define CARDMATIC_PUNCH_H
+
+#include "cardmatic_sql.h"
+#include "../cardmatic_tube.h"
+#include <vector>
+#include <ostream>
+
+
+// nominal card geometry in mm, switch letters across, rows down
+#define PUNCH_HOLE_PITCH_X 6.35     // between switch letters
+#define PUNCH_HOLE_PITCH_Y 6.35     // between switch rows
+#define PUNCH_FIRST_HOLE_X 12.7     // hole A1 from the card corner
+#define PUNCH_FIRST_HOLE_Y 12.7
+#define PUNCH_CARD_WIDTH 88.9       // 2 margins + 10 letter pitches
+#define PUNCH_CARD_HEIGHT 127.0     // 2 margins + 16 row pitches
+#define PUNCH_CARD_GAP 5.0          // between cards on a sheet
+
+#define PUNCH_SHEET_COLUMNS 3       // cards across a sheet
+#define PUNCH_SHEET_ROWS 2          // cards down a sheet
+
+#define PUNCH_RETRACT_Z 2.0         // head clear of the sheet
+#define PUNCH_DEPTH_Z -1.5          // bottom of the punch stroke
+#define PUNCH_FEED 600.0            // punch stroke feed in mm/min
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// card geometry and sheet layout, in mm
+typedef struct PunchLayout
+{
+    double holePitchX;
+    double holePitchY;
+    double firstHoleX;
+    double firstHoleY;
+    double cardWidth;
+    double cardHeight;
+    double cardGap;
+    unsigned int sheetColumns;
+    unsigned int sheetRows;
+    double retractZ;
+    double depthZ;
+    double feed;
+}PunchLayout;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class PunchPlanner
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructors and destructor
+        //----------------------------------------------------------------------
+
+        PunchPlanner();     // defaultLayout()
+
+        PunchPlanner(const PunchLayout &layout);
+
+        ~PunchPlanner();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to write the punch program of a batch of cards.  Cards
+        //  fill the sheets row by row, and each sheet ends with M0 so the
+        //  operator can load the next one, or M30 after the last sheet
+        // param:   out - receives the G-code
+        //          cards - cards in punch order
+        // returns: false if a card names a switch the cardreader does not
+        //          have, or the layout holds no card.  Nothing is written then
+        bool writeGCode(std::ostream &out,
+                        const std::vector<GeneratedCard> &cards);
+
+
+        // function to order the holes of one card, starting from the head
+        //  position.  Holes are ordered nearest neighbour first, then
+        //  improved with 2-opt moves until none shortens the path
+        // param:   card - closed switches
+        //          originX, originY - card corner on the sheet
+        //          headX, headY - head position, set to the last hole
+        //          order - set to the switch indices in punch order
+        // returns: travel from the head position to the last hole
+        double orderHoles(const SwitchMatrix &card,
+                          double originX,
+                          double originY,
+                          double &headX,
+                          double &headY,
+                          std::vector<int> &order) const;
+
+
+        // returns: layout of the PUNCH_* values
+        static PunchLayout defaultLayout();
+
+
+        // hole of a switch index, relative to the card corner
+        void holePosition(int index,
+                          double &x,
+                          double &y) const
+        {
+            holePosition(index, 0, 0, x, y);
+        }
+
+
+        // statistics of the last writeGCode()
+        unsigned long getNumHoles() const { return m_numHoles; }
+
+        unsigned int getNumSheets() const { return m_numSheets; }
+
+        double getTravel() const { return m_travel; }   // mm, see distance()
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        PunchLayout m_layout;
+
+        unsigned long m_numHoles;
+        unsigned int m_numSheets;
+        double m_travel;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // hole of a switch index on the sheet
+        void holePosition(int index,
+                          double originX,
+                          double originY,
+                          double &x,
+                          double &y) const;
+
+
+        // travel between two positions.  Rapid moves drive both axes at
+        //  once, so the longer axis sets the travel time
+        static double distance(double x1,
+                               double y1,
+                               double x2,
+                               double y2);
+};
+
+#endif // CARDMATIC_PUNCH_H
@@ -0,0 +1,388 @@
+//    Cardmatic card generator - cardmatic_quantize.cpp file
+//    C++11 implementation file
+
+//    Quantization of AVO test data to Cardmatic settings: heater volts to
+//      V_HEATER_INC steps, anode volts to regulated B+ steps lowered until
+//      the supply is rated for the plate current, plate current and gm
+//      scaled to that step on the meter ranges, and grid bias to decade
+//      resistor values.  quantizeRow() is the routine DataConverter builds
+//      cards with; catalogue columns are processed four rows at a time by
+//      its AVX2 form when compiled with -mavx2, with a scalar fallback
+//      calling quantizeRow(), giving identical results.
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <cstring>
+#include "cardmatic_quantize.h"
+#include "../cardmatic_cardpos.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+// both paths round half up as floor(x + .5), evaluate the power laws as
+//  ratio * sqrt(ratio) and sqrt(ratio) in the same order and clamp with the
+//  same comparisons, so they agree bit for bit
+#define HEATER_TENTHS_MAX 1199      // V_HEATER_MAX_AC / V_HEATER_INC
+#define HALF_SCALE 2000             // mA to uA, mA/V to umho at half scale
+#define NUM_BPLUS_STEPS (V_REGBPLUS_MAX / V_REGBPLUS_INC + 1)
+
+
+#if defined(__AVX2__)
+// spreads the 4 lane bits of a compare mask into 4 bytes
+static const uint32_t LANE_BYTES[16] = {
+    0x00000000, 0x00000001, 0x00000100, 0x00000101,
+    0x00010000, 0x00010001, 0x00010100, 0x00010101,
+    0x01000000, 0x01000001, 0x01000100, 0x01000101,
+    0x01010000, 0x01010001, 0x01010100, 0x01010101,
+};
+#endif
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   model - tester model whose B+ ratings limit the plate current,
+//              i.e. 15784, 1234 or 118.  An unknown model is taken as
+//              CARDMATIC_MODEL
+CatalogueQuantizer::CatalogueQuantizer(unsigned int model)
+{
+    const ModelLimits* limits = TubeTests::modelLimits(model);
+    if (limits == NULL) { limits = TubeTests::modelLimits(CARDMATIC_MODEL); }
+
+    m_bPlusMaxCurrent = limits->bPlusMaxCurrent;
+    for (unsigned int i = 0; i < NUM_BPLUS_STEPS; i++)
+    {
+        m_maxCurrent[i] = m_bPlusMaxCurrent[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+CatalogueQuantizer::~CatalogueQuantizer()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to quantize every row of a catalogue
+void CatalogueQuantizer::quantize(const TubeCatalogue &catalogue)
+{
+    quantize(catalogue.getColumn(HEATER), catalogue.getColumn(V_GRID1),
+        catalogue.getColumn(V_ANODE), catalogue.getColumn(I_ANODE),
+        catalogue.getColumn(GM), catalogue.size());
+}
+
+//------------------------------------------------------------------------------
+
+// function to quantize columns of numRows values, NaN if missing
+// param:   heater - heater volts
+//          vGrid1 - grid bias volts, sign is ignored
+//          vAnode - anode volts
+//          iAnode - plate current in mA
+//          gm - mutual conductance in mA/V
+//          numRows - length of the columns
+void CatalogueQuantizer::quantize(const double* heater,
+                                  const double* vGrid1,
+                                  const double* vAnode,
+                                  const double* iAnode,
+                                  const double* gm,
+                                  size_t numRows)
+{
+    m_heaterTenths.resize(numRows);
+    m_bPlus.resize(numRows);
+    m_maFS.resize(numRows);
+    m_umhoFS.resize(numRows);
+    m_decadeOhms.resize(numRows);
+    m_current.resize(numRows);
+    m_outOfRange.resize(numRows);
+
+    quantizeKernel(heater, vGrid1, vAnode, iAnode, gm, numRows);
+}
+
+//------------------------------------------------------------------------------
+
+// function to quantize one row of test data.  B+ is the nearest step,
+//  lowered while the plate current scaled to the step by the 3/2 power law
+//  exceeds the rating.  Meters are set so the plate current and gm, scaled
+//  to the step by the 3/2 and 1/2 power laws, read half scale
+// param:   heater, vGrid1, vAnode, iAnode, gm - as quantize(), NaN if missing
+//          bPlusMaxCurrent - B+ ratings in mA by B+ / V_REGBPLUS_INC, see
+//              ModelLimits
+//          row - set to the settings
+void CatalogueQuantizer::quantizeRow(double heater,
+                                     double vGrid1,
+                                     double vAnode,
+                                     double iAnode,
+                                     double gm,
+                                     const unsigned int* bPlusMaxCurrent,
+                                     QuantizedRow &row)
+{
+    row.outOfRange = 0;
+
+    // heater, NaN fails the range test like any out of range value
+    double tenths = std::floor(heater / V_HEATER_INC + .5);
+    if (!(tenths >= 0 && tenths <= HEATER_TENTHS_MAX))
+    {
+        row.outOfRange |= QUANT_HEATER_RANGE;
+        tenths = tenths > HEATER_TENTHS_MAX ? HEATER_TENTHS_MAX : 0;
+    }
+
+    // nearest B+ step, 0 if the anode volts are missing
+    double bPlus = std::floor(vAnode / V_REGBPLUS_INC + .5) * V_REGBPLUS_INC;
+    if (!(bPlus >= V_REGBPLUS_MIN && bPlus <= V_REGBPLUS_MAX))
+    {
+        row.outOfRange |= QUANT_BPLUS_RANGE;
+        bPlus = bPlus > V_REGBPLUS_MAX ? V_REGBPLUS_MAX :
+            std::isnan(bPlus) ? 0 : V_REGBPLUS_MIN;
+    }
+
+    // highest step the regulated supply is rated for the plate current at
+    bool hasCurrent = iAnode > 0;
+    double ratio, current, maxCurrent;
+    while (true)
+    {
+        ratio = bPlus > 0 && vAnode > 0 ? bPlus / vAnode : 1;
+        current = hasCurrent ? iAnode * (ratio * std::sqrt(ratio)) : 0;
+        maxCurrent = bPlusMaxCurrent[static_cast<unsigned int>(bPlus) /
+            V_REGBPLUS_INC];
+
+        if (!(bPlus > V_REGBPLUS_MIN && std::ceil(current) > maxCurrent))
+        {
+            break;
+        }
+
+        bPlus -= V_REGBPLUS_INC;
+    }
+
+    if (bPlus > 0 && std::ceil(current) > maxCurrent)
+    {
+        row.outOfRange |= QUANT_BPLUS_CURRENT;
+    }
+
+    // current meter, METER_FS_I_MIN steps
+    double maFS = 0;
+    if (hasCurrent)
+    {
+        maFS = std::ceil(current * HALF_SCALE / METER_FS_I_MIN) *
+            METER_FS_I_MIN;
+        maFS = maFS < METER_FS_I_MIN ? METER_FS_I_MIN :
+            maFS > METER_FS_I_MAX_HIGH ? METER_FS_I_MAX_HIGH : maFS;
+    }
+
+    // gm, 100 umho steps up to METER_FS_GM_MAX_LOW, 500 above
+    double umhoFS = 0;
+    if (gm > 0)
+    {
+        double umho = std::floor(gm * std::sqrt(ratio) * HALF_SCALE + .5);
+        double step = umho > METER_FS_GM_MAX_LOW ? METER_FS_GM_INC_HIGH :
+            METER_FS_GM_INC_LOW;
+
+        umhoFS = std::ceil(umho / step) * step;
+        if (umhoFS > METER_FS_GM_MAX_HIGH)
+        {
+            row.outOfRange |= QUANT_GM_RANGE;
+            umhoFS = METER_FS_GM_MAX_HIGH;
+        }
+        else if (umhoFS < METER_FS_GM_MIN) { umhoFS = METER_FS_GM_MIN; }
+    }
+    else { row.outOfRange |= QUANT_GM_RANGE; }
+
+    // bias, missing is 0V
+    double ec = std::isnan(vGrid1) ? 0 : std::fabs(vGrid1);
+    if (ec > V_BIAS_MAX)
+    {
+        row.outOfRange |= QUANT_BIAS_RANGE;
+        ec = V_BIAS_MAX;
+    }
+    double ohms = ec * BIAS_DIVIDER_RES / (V_BIAS_SUPPLY - ec);
+    double decade = std::floor(ohms / DECADE_RES_INC + .5) * DECADE_RES_INC;
+
+    row.heaterTenths = tenths;
+    row.bPlus = bPlus;
+    row.maFS = maFS;
+    row.umhoFS = umhoFS;
+    row.decadeOhms = decade;
+    row.current = current;
+}
+
+//------------------------------------------------------------------------------
+
+// quantizes numRows rows into the output columns, the AVX2 path is
+//  quantizeRow() four rows at a time.  Vector comparisons are ordered, so
+//  NaN lanes compare false as in quantizeRow()
+void CatalogueQuantizer::quantizeKernel(const double* heater,
+                                        const double* vGrid1,
+                                        const double* vAnode,
+                                        const double* iAnode,
+                                        const double* gm,
+                                        size_t numRows)
+{
+    size_t i = 0;
+
+    #if defined(__AVX2__)
+    const __m256d half = _mm256_set1_pd(.5);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1);
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    const __m256d halfScale = _mm256_set1_pd(HALF_SCALE);
+
+    const __m256d heaterInc = _mm256_set1_pd(V_HEATER_INC);
+    const __m256d tenthsMax = _mm256_set1_pd(HEATER_TENTHS_MAX);
+
+    const __m256d bPlusInc = _mm256_set1_pd(V_REGBPLUS_INC);
+    const __m256d bPlusMin = _mm256_set1_pd(V_REGBPLUS_MIN);
+    const __m256d bPlusMax = _mm256_set1_pd(V_REGBPLUS_MAX);
+
+    const __m256d iMin = _mm256_set1_pd(METER_FS_I_MIN);
+    const __m256d iMax = _mm256_set1_pd(METER_FS_I_MAX_HIGH);
+
+    const __m256d gmMaxLow = _mm256_set1_pd(METER_FS_GM_MAX_LOW);
+    const __m256d gmIncLow = _mm256_set1_pd(METER_FS_GM_INC_LOW);
+    const __m256d gmIncHigh = _mm256_set1_pd(METER_FS_GM_INC_HIGH);
+    const __m256d gmMin = _mm256_set1_pd(METER_FS_GM_MIN);
+    const __m256d gmMax = _mm256_set1_pd(METER_FS_GM_MAX_HIGH);
+
+    const __m256d biasMax = _mm256_set1_pd(V_BIAS_MAX);
+    const __m256d biasOhms = _mm256_set1_pd(BIAS_DIVIDER_RES);
+    const __m256d biasVolts = _mm256_set1_pd(V_BIAS_SUPPLY);
+    const __m256d decadeInc = _mm256_set1_pd(DECADE_RES_INC);
+
+    // four rows per iteration
+    for (; i + 4 <= numRows; i += 4)
+    {
+        // heater
+        __m256d tenths = _mm256_floor_pd(_mm256_add_pd(
+            _mm256_div_pd(_mm256_loadu_pd(heater + i), heaterInc), half));
+        __m256d heaterOK = _mm256_and_pd(
+            _mm256_cmp_pd(tenths, zero, _CMP_GE_OQ),
+            _mm256_cmp_pd(tenths, tenthsMax, _CMP_LE_OQ));
+        tenths = _mm256_blendv_pd(
+            _mm256_and_pd(_mm256_cmp_pd(tenths, tenthsMax, _CMP_GT_OQ),
+                tenthsMax),
+            tenths, heaterOK);
+
+        // nearest B+ step
+        __m256d va = _mm256_loadu_pd(vAnode + i);
+        __m256d bPlus = _mm256_mul_pd(_mm256_floor_pd(_mm256_add_pd(
+            _mm256_div_pd(va, bPlusInc), half)), bPlusInc);
+        __m256d bPlusOK = _mm256_and_pd(
+            _mm256_cmp_pd(bPlus, bPlusMin, _CMP_GE_OQ),
+            _mm256_cmp_pd(bPlus, bPlusMax, _CMP_LE_OQ));
+        __m256d bPlusClamped = _mm256_blendv_pd(
+            _mm256_and_pd(_mm256_cmp_pd(bPlus, bPlus, _CMP_ORD_Q), bPlusMin),
+            bPlusMax, _mm256_cmp_pd(bPlus, bPlusMax, _CMP_GT_OQ));
+        bPlus = _mm256_blendv_pd(bPlusClamped, bPlus, bPlusOK);
+
+        // lower B+ in the lanes still over the rating
+        __m256d ia = _mm256_loadu_pd(iAnode + i);
+        __m256d hasCurrent = _mm256_cmp_pd(ia, zero, _CMP_GT_OQ);
+        __m256d vaPositive = _mm256_cmp_pd(va, zero, _CMP_GT_OQ);
+        __m256d ratio, current, maxCurrent, over;
+        while (true)
+        {
+            ratio = _mm256_blendv_pd(one, _mm256_div_pd(bPlus, va),
+                _mm256_and_pd(_mm256_cmp_pd(bPlus, zero, _CMP_GT_OQ),
+                    vaPositive));
+            current = _mm256_and_pd(_mm256_mul_pd(ia, _mm256_mul_pd(ratio,
+                _mm256_sqrt_pd(ratio))), hasCurrent);
+            maxCurrent = _mm256_i32gather_pd(m_maxCurrent,
+                _mm256_cvtpd_epi32(_mm256_div_pd(bPlus, bPlusInc)), 8);
+            over = _mm256_cmp_pd(_mm256_ceil_pd(current), maxCurrent,
+                _CMP_GT_OQ);
+
+            __m256d lower = _mm256_and_pd(over,
+                _mm256_cmp_pd(bPlus, bPlusMin, _CMP_GT_OQ));
+            if (_mm256_movemask_pd(lower) == 0) { break; }
+
+            bPlus = _mm256_sub_pd(bPlus, _mm256_and_pd(lower, bPlusInc));
+        }
+        __m256d currentBad = _mm256_and_pd(over,
+            _mm256_cmp_pd(bPlus, zero, _CMP_GT_OQ));
+
+        // current meter
+        __m256d maFS = _mm256_mul_pd(_mm256_ceil_pd(_mm256_div_pd(
+            _mm256_mul_pd(current, halfScale), iMin)), iMin);
+        maFS = _mm256_and_pd(_mm256_min_pd(_mm256_max_pd(maFS, iMin), iMax),
+            hasCurrent);
+
+        // gm
+        __m256d g = _mm256_loadu_pd(gm + i);
+        __m256d hasGm = _mm256_cmp_pd(g, zero, _CMP_GT_OQ);
+        __m256d umho = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(
+            _mm256_mul_pd(g, _mm256_sqrt_pd(ratio)), halfScale), half));
+        __m256d step = _mm256_blendv_pd(gmIncLow, gmIncHigh,
+            _mm256_cmp_pd(umho, gmMaxLow, _CMP_GT_OQ));
+        __m256d umhoFS = _mm256_mul_pd(_mm256_ceil_pd(
+            _mm256_div_pd(umho, step)), step);
+        __m256d gmBad = _mm256_or_pd(_mm256_andnot_pd(hasGm, signBit),
+            _mm256_cmp_pd(umhoFS, gmMax, _CMP_GT_OQ));
+        umhoFS = _mm256_and_pd(_mm256_min_pd(_mm256_max_pd(umhoFS, gmMin),
+            gmMax), hasGm);
+
+        // bias, max_pd returns the second operand for NaN
+        __m256d ec = _mm256_max_pd(_mm256_andnot_pd(signBit,
+            _mm256_loadu_pd(vGrid1 + i)), zero);
+        __m256d biasBad = _mm256_cmp_pd(ec, biasMax, _CMP_GT_OQ);
+        ec = _mm256_blendv_pd(ec, biasMax, biasBad);
+        __m256d ohms = _mm256_div_pd(_mm256_mul_pd(ec, biasOhms),
+            _mm256_sub_pd(biasVolts, ec));
+        __m256d decade = _mm256_mul_pd(_mm256_floor_pd(_mm256_add_pd(
+            _mm256_div_pd(ohms, decadeInc), half)), decadeInc);
+
+
+        // store, values are whole numbers well inside int32
+        __m128i tenths32 = _mm256_cvtpd_epi32(tenths);
+        __m128i bPlus32 = _mm256_cvtpd_epi32(bPlus);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&m_heaterTenths[i]),
+            _mm_packus_epi32(tenths32, tenths32));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&m_bPlus[i]),
+            _mm_packus_epi32(bPlus32, bPlus32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&m_maFS[i]),
+            _mm256_cvtpd_epi32(maFS));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&m_umhoFS[i]),
+            _mm256_cvtpd_epi32(umhoFS));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&m_decadeOhms[i]),
+            _mm256_cvtpd_epi32(decade));
+        _mm256_storeu_pd(&m_current[i], current);
+
+        uint32_t outOfRange =
+            LANE_BYTES[~_mm256_movemask_pd(heaterOK) & 0xF] *
+                QUANT_HEATER_RANGE |
+            LANE_BYTES[~_mm256_movemask_pd(bPlusOK) & 0xF] *
+                QUANT_BPLUS_RANGE |
+            LANE_BYTES[_mm256_movemask_pd(gmBad)] * QUANT_GM_RANGE |
+            LANE_BYTES[_mm256_movemask_pd(biasBad)] * QUANT_BIAS_RANGE |
+            LANE_BYTES[_mm256_movemask_pd(currentBad)] * QUANT_BPLUS_CURRENT;
+        std::memcpy(&m_outOfRange[i], &outOfRange, sizeof(outOfRange));
+    }
+    #endif
+
+    // scalar fallback
+    for (; i < numRows; i++)
+    {
+        QuantizedRow row;
+        quantizeRow(heater[i], vGrid1[i], vAnode[i], iAnode[i], gm[i],
+            m_bPlusMaxCurrent, row);
+
+        m_heaterTenths[i] = row.heaterTenths;
+        m_bPlus[i] = row.bPlus;
+        m_maFS[i] = row.maFS;
+        m_umhoFS[i] = row.umhoFS;
+        m_decadeOhms[i] = row.decadeOhms;
+        m_current[i] = row.current;
+        m_outOfRange[i] = row.outOfRange;
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,184 @@
+//    Cardmatic card generator - cardmatic_quantize.h file
+//    C++11 header file
+
+//    Quantization of AVO test data to Cardmatic settings: heater volts to
+//      V_HEATER_INC steps, anode volts to regulated B+ steps lowered until
+//      the supply is rated for the plate current, plate current and gm
+//      scaled to that step on the meter ranges, and grid bias to decade
+//      resistor values.  quantizeRow() is the routine DataConverter builds
+//      cards with; catalogue columns are processed four rows at a time by
+//      its AVX2 form when compiled with -mavx2, with a scalar fallback
+//      calling quantizeRow(), giving identical results.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_QUANTIZE_H
+#define CARDMATIC_QUANTIZE_H
+
+#include "cardmatic_catalogue.h"
+#include "../cardmatic_globals.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+// out of range bits, one set per row.  A missing value is out of range,
+//  except a missing bias which is taken as 0V
+#define QUANT_HEATER_RANGE 0x01     // heater not 0 - V_HEATER_MAX_AC
+#define QUANT_BPLUS_RANGE 0x02      // anode not within half a step of B+ range
+#define QUANT_GM_RANGE 0x04         // gm missing or beyond METER_FS_GM_MAX_HIGH
+#define QUANT_BIAS_RANGE 0x08       // bias beyond V_BIAS_MAX
+#define QUANT_BPLUS_CURRENT 0x10    // plate current over the rating of the
+                                    // lowest B+ step
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// settings of one row of test data.  Values out of range are clamped to the
+//  range, missing values are 0
+typedef struct QuantizedRow
+{
+    uint16_t heaterTenths;  // heater volts in V_HEATER_INC steps
+    uint16_t bPlus;         // regulated B+ step the supply is rated for
+    uint32_t maFS;          // current meter full scale in uA, nominal plate
+                            // current at half scale
+    uint32_t umhoFS;        // umhometer full scale, nominal gm at half scale
+    uint32_t decadeOhms;    // decade resistor of the grid bias
+    double current;         // plate current expected at bPlus, in mA
+    uint8_t outOfRange;     // QUANT_* bits
+}QuantizedRow;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CatalogueQuantizer
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   model - tester model whose B+ ratings limit the plate
+        //              current, i.e. 15784, 1234 or 118.  An unknown model
+        //              is taken as CARDMATIC_MODEL
+        explicit CatalogueQuantizer(unsigned int model = CARDMATIC_MODEL);
+
+        ~CatalogueQuantizer();  // destructor
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to quantize every row of a catalogue
+        void quantize(const TubeCatalogue &catalogue);
+
+
+        // function to quantize columns of numRows values, NaN if missing
+        // param:   heater - heater volts
+        //          vGrid1 - grid bias volts, sign is ignored
+        //          vAnode - anode volts
+        //          iAnode - plate current in mA
+        //          gm - mutual conductance in mA/V
+        //          numRows - length of the columns
+        void quantize(const double* heater,
+                      const double* vGrid1,
+                      const double* vAnode,
+                      const double* iAnode,
+                      const double* gm,
+                      size_t numRows);
+
+
+        // function to quantize one row of test data.  B+ is the nearest
+        //  step, lowered while the plate current scaled to the step by the
+        //  3/2 power law exceeds the rating.  Meters are set so the plate
+        //  current and gm, scaled to the step by the 3/2 and 1/2 power laws,
+        //  read half scale
+        // param:   heater, vGrid1, vAnode, iAnode, gm - as quantize(), NaN if
+        //              missing
+        //          bPlusMaxCurrent - B+ ratings in mA by B+ / V_REGBPLUS_INC,
+        //              see ModelLimits
+        //          row - set to the settings
+        static void quantizeRow(double heater,
+                                double vGrid1,
+                                double vAnode,
+                                double iAnode,
+                                double gm,
+                                const unsigned int* bPlusMaxCurrent,
+                                QuantizedRow &row);
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors, one entry per row.  Values out of range are clamped
+        //      to the range, missing values are 0
+        //----------------------------------------------------------------------
+
+        size_t size() const { return m_outOfRange.size(); }
+
+        // heater volts in V_HEATER_INC steps
+        const uint16_t* getHeaterTenths() const
+        {
+            return m_heaterTenths.data();
+        }
+
+        // regulated B+ volts, V_REGBPLUS_INC steps
+        const uint16_t* getBPlus() const { return m_bPlus.data(); }
+
+        // current meter full scale in uA, plate current at half scale
+        const uint32_t* getMaFS() const { return m_maFS.data(); }
+
+        // umhometer full scale, nominal gm at half scale
+        const uint32_t* getUmhoFS() const { return m_umhoFS.data(); }
+
+        // decade resistor of the grid bias in DECADE_RES_INC steps
+        const uint32_t* getDecadeOhms() const { return m_decadeOhms.data(); }
+
+        // plate current expected at the B+ step, in mA
+        const double* getCurrent() const { return m_current.data(); }
+
+        // QUANT_* bits
+        const uint8_t* getOutOfRange() const { return m_outOfRange.data(); }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        const unsigned int* m_bPlusMaxCurrent;
+        double m_maxCurrent[V_REGBPLUS_MAX / V_REGBPLUS_INC + 1];  // as double
+
+        std::vector<uint16_t> m_heaterTenths;
+        std::vector<uint16_t> m_bPlus;
+        std::vector<uint32_t> m_maFS;
+        std::vector<uint32_t> m_umhoFS;
+        std::vector<uint32_t> m_decadeOhms;
+        std::vector<double> m_current;
+        std::vector<uint8_t> m_outOfRange;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // quantizes numRows rows into the output columns
+        void quantizeKernel(const double* heater,
+                            const double* vGrid1,
+                            const double* vAnode,
+                            const double* iAnode,
+                            const double* gm,
+                            size_t numRows);
+};
+
+#endif // CARDMATIC_QUANTIZE_H
@@ -0,0 +1,284 @@
+//    Cardmatic card generator - cardmatic_query.cpp file
+//    C++11 implementation file
+
+//    Parameter-range query engine over the tube catalogue.  Electrical
+//      parameters and derived card properties are kept in sorted per-column
+//      indexes; the most selective predicate drives the scan and the others
+//      are evaluated on the candidates only.  A tube matches if one of its
+//      catalogue rows does, and is reported once
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+#include "cardmatic_query.h"
+
+
+#define QUERY_EQUAL_TOLERANCE 1e-6      // tolerance of "=" predicates
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// pre: catalogue is loaded and outlives the engine
+// post: derived columns are computed and every column is indexed
+QueryEngine::QueryEngine(const TubeCatalogue &catalogue) :
+    m_catalogue(catalogue)
+{
+    DataConverter converter;
+    size_t numRows = m_catalogue.size();
+
+    for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+    {
+        const double* column = m_catalogue.getColumn(
+            static_cast<VCM163Param_double>(c));
+        m_columns[c].assign(column, column + numRows);
+    }
+
+    // AVO lists gm in mA/V, the Cardmatic meter in umho
+    for (size_t row = 0; row < numRows; row++)
+    {
+        m_columns[Q_GM][row] *= 1000;
+    }
+
+
+    // rows of a tube, i.e. the sections of a 6AS7
+    std::unordered_map<std::string, unsigned int> firstRows;
+    m_tubeRows.resize(numRows);
+
+    for (size_t row = 0; row < numRows; row++)
+    {
+        m_tubeRows[row] = firstRows.insert(std::make_pair(
+            m_catalogue.getText(row, TUBE_ID), row)).first->second;
+    }
+
+
+    // derived card properties.  Each row is tested on its own cards, so a
+    //  tube needs the cards of all its rows
+    m_columns[Q_NUM_PINS].resize(numRows);
+    m_columns[Q_NUM_CARDS].assign(numRows, 0);
+    m_columns[Q_TOP_CAP].resize(numRows);
+
+    for (size_t row = 0; row < numRows; row++)
+    {
+        MappingStatus numCards = converter.cardsRequired(
+            m_catalogue.getText(row, SWITCH_SETTINGS));
+        double &tubeCards = m_columns[Q_NUM_CARDS][m_tubeRows[row]];
+
+        m_columns[Q_NUM_PINS][row] = converter.getNumTubePins(
+            m_catalogue.getText(row, BASE));
+        if (numCards == MAP_ERROR)
+        {
+            tubeCards = nan("invalid");
+        }
+        else
+        {
+            tubeCards += static_cast<double>(numCards);
+        }
+        m_columns[Q_TOP_CAP][row] = converter.tubeHasTopCap(
+            m_catalogue.getText(row, TOP_CAP));
+    }
+
+    for (size_t row = 0; row < numRows; row++)
+    {
+        m_columns[Q_NUM_CARDS][row] = m_columns[Q_NUM_CARDS][m_tubeRows[row]];
+    }
+
+
+    // sorted indexes
+    for (unsigned int c = 0; c < NUM_QUERY_COLUMNS; c++)
+    {
+        const std::vector<double> &column = m_columns[c];
+
+        for (size_t row = 0; row < numRows; row++)
+        {
+            if (!std::isnan(column[row])) { m_sortedRows[c].push_back(row); }
+        }
+
+        std::stable_sort(m_sortedRows[c].begin(), m_sortedRows[c].end(),
+            [&column](unsigned int a, unsigned int b)
+            {
+                return column[a] < column[b];
+            });
+
+        m_sortedValues[c].resize(m_sortedRows[c].size());
+        for (size_t i = 0; i < m_sortedRows[c].size(); i++)
+        {
+            m_sortedValues[c][i] = column[m_sortedRows[c][i]];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+QueryEngine::~QueryEngine()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to select all tubes with a row matching every predicate
+// param: predicates - conjunction of predicates, empty selects all
+// returns: first catalogue row of each matching tube, in ascending order
+std::vector<unsigned int> QueryEngine::select(
+    const std::vector<QueryPredicate> &predicates) const
+{
+    std::vector<unsigned int> rows;
+
+    if (predicates.empty())
+    {
+        for (size_t row = 0; row < m_catalogue.size(); row++)
+        {
+            if (m_tubeRows[row] == row) { rows.push_back(row); }
+        }
+
+        return rows;
+    }
+
+
+    // the predicate matching the fewest rows drives the scan
+    size_t driver = 0;
+    size_t driverFirst = 0;
+    size_t driverLast = m_catalogue.size() + 1;
+
+    for (size_t p = 0; p < predicates.size(); p++)
+    {
+        size_t first, last;
+        indexRange(predicates[p], first, last);
+
+        if (last - first < driverLast - driverFirst)
+        {
+            driver = p;
+            driverFirst = first;
+            driverLast = last;
+        }
+    }
+
+
+    // evaluate the remaining predicates on the candidates only
+    const std::vector<unsigned int> &candidates =
+        m_sortedRows[predicates[driver].column];
+
+    for (size_t i = driverFirst; i < driverLast; i++)
+    {
+        unsigned int row = candidates[i];
+        bool match = true;
+
+        for (size_t p = 0; p < predicates.size() && match; p++)
+        {
+            if (p == driver) { continue; }
+
+            // comparisons with NaN are false, missing values never match
+            double value = m_columns[predicates[p].column][row];
+            match = value >= predicates[p].low && value <= predicates[p].high;
+        }
+
+        if (match) { rows.push_back(m_tubeRows[row]); }
+    }
+
+    // one entry per tube, whichever of its rows matched
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+}
+
+//------------------------------------------------------------------------------
+
+// function to count the rows matching a single predicate
+// returns: number of matching rows, found by binary search
+size_t QueryEngine::count(const QueryPredicate &predicate) const
+{
+    size_t first, last;
+    indexRange(predicate, first, last);
+
+    return last - first;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to parse a predicate such as "gm>5000", "heater=6.3", "pins<=7" or
+//  "cards=1".  Column names are heater, vg1, va, vg2, ia, gm, pins, cards and
+//  topcap
+// param:   text - predicate
+//          predicate - parsed predicate
+// returns: true if parsing is successful, false otherwise
+bool QueryEngine::parsePredicate(const std::string &text,
+                                 QueryPredicate &predicate)
+{
+    static const char* columnNames[NUM_QUERY_COLUMNS] = {
+        "heater", "vg1", "va", "vg2", "ia", "gm", "pins", "cards", "topcap"
+    };
+
+    size_t opPos = text.find_first_of("<>=");
+    if (opPos == std::string::npos || opPos == 0) { return false; }
+
+    size_t valuePos = opPos + 1;
+    if (valuePos < text.size() && text[valuePos] == '=') { valuePos++; }
+
+    std::string name = text.substr(0, opPos);
+    std::string op = text.substr(opPos, valuePos - opPos);
+    std::string valueText = text.substr(valuePos);
+
+
+    // column
+    unsigned int c = 0;
+    while (c < NUM_QUERY_COLUMNS && name != columnNames[c]) { c++; }
+    if (c == NUM_QUERY_COLUMNS) { return false; }
+    predicate.column = static_cast<QueryColumn>(c);
+
+
+    // value
+    char* end;
+    double value = strtod(valueText.c_str(), &end);
+    if (valueText.empty() || *end != '\0') { return false; }
+
+
+    // operator
+    predicate.low = -HUGE_VAL;
+    predicate.high = HUGE_VAL;
+
+    if (op == "=" || op == "==")
+    {
+        predicate.low = value - QUERY_EQUAL_TOLERANCE;
+        predicate.high = value + QUERY_EQUAL_TOLERANCE;
+    }
+
+    else if (op == "<") { predicate.high = nextafter(value, -HUGE_VAL); }
+    else if (op == "<=") { predicate.high = value; }
+    else if (op == ">") { predicate.low = nextafter(value, HUGE_VAL); }
+    else if (op == ">=") { predicate.low = value; }
+    else { return false; }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to find the index range matching a predicate
+// param:   predicate - predicate to look up
+//          first, last - matching range of m_sortedRows
+void QueryEngine::indexRange(const QueryPredicate &predicate,
+                             size_t &first,
+                             size_t &last) const
+{
+    const std::vector<double> &values = m_sortedValues[predicate.column];
+
+    first = std::lower_bound(values.begin(), values.end(), predicate.low) -
+        values.begin();
+    last = std::upper_bound(values.begin(), values.end(), predicate.high) -
+        values.begin();
+
+    if (last < first) { last = first; }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,143 @@
+//    Cardmatic card generator - cardmatic_query.h file
+//    C++11 header file
+
+//    Parameter-range query engine over the tube catalogue.  Electrical
+//      parameters and derived card properties are kept in sorted per-column
+//      indexes; the most selective predicate drives the scan and the others
+//      are evaluated on the candidates only.  A tube matches if one of its
+//      catalogue rows does, and is reported once
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_QUERY_H
+#define CARDMATIC_QUERY_H
+
+#include "cardmatic_catalogue.h"
+#include <string>
+#include <vector>
+
+
+
+//------------------------------------------------------------------------------
+//  enums and structs
+//------------------------------------------------------------------------------
+
+// queryable columns.  The first six follow VCM163Param_double
+typedef enum QueryColumn
+{
+    Q_HEATER,       // heater volts
+    Q_V_GRID1,      // grid 1 bias volts
+    Q_V_ANODE,      // anode volts
+    Q_V_GRID2,      // screen volts
+    Q_I_ANODE,      // anode current in mA
+    Q_GM,           // mutual conductance in umho
+    Q_NUM_PINS,     // number of pins on the base
+    Q_NUM_CARDS,    // number of cards the tube needs over all its rows, see
+                    // DataConverter::cardsRequired
+    Q_TOP_CAP,      // TopCapStatus
+    NUM_QUERY_COLUMNS,
+}QueryColumn;
+
+
+// inclusive range predicate low <= column <= high
+typedef struct QueryPredicate
+{
+    QueryColumn column;
+    double low;
+    double high;
+}QueryPredicate;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class QueryEngine
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // pre: catalogue is loaded and outlives the engine
+        // post: derived columns are computed and every column is indexed
+        explicit QueryEngine(const TubeCatalogue &catalogue);
+
+        ~QueryEngine();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to select all tubes with a row matching every predicate
+        // param: predicates - conjunction of predicates, empty selects all
+        // returns: first catalogue row of each matching tube, in ascending
+        //          order
+        std::vector<unsigned int> select(
+            const std::vector<QueryPredicate> &predicates) const;
+
+
+        // function to count the rows matching a single predicate
+        // returns: number of matching rows, found by binary search
+        size_t count(const QueryPredicate &predicate) const;
+
+
+        // helper to parse a predicate such as "gm>5000", "heater=6.3",
+        //  "pins<=7" or "cards=1".  Column names are heater, vg1, va, vg2,
+        //  ia, gm, pins, cards and topcap
+        // param:   text - predicate
+        //          predicate - parsed predicate
+        // returns: true if parsing is successful, false otherwise
+        static bool parsePredicate(const std::string &text,
+                                   QueryPredicate &predicate);
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors
+        //----------------------------------------------------------------------
+
+        double getValue(size_t row,
+                        QueryColumn column) const
+        {
+            return m_columns[column][row];
+        }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        const TubeCatalogue &m_catalogue;
+
+        std::vector<double> m_columns[NUM_QUERY_COLUMNS];   // by row
+
+        std::vector<unsigned int> m_tubeRows;   // first row of the tube of
+                                                // each row
+
+        // rows sorted by column value, and the sorted values.  Rows with a
+        // missing value are left out
+        std::vector<unsigned int> m_sortedRows[NUM_QUERY_COLUMNS];
+        std::vector<double> m_sortedValues[NUM_QUERY_COLUMNS];
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // helper to find the index range matching a predicate
+        // param:   predicate - predicate to look up
+        //          first, last - matching range of m_sortedRows
+        void indexRange(const QueryPredicate &predicate,
+                        size_t &first,
+                        size_t &last) const;
+};
+
+#endif // CARDMATIC_QUERY_H
@@ -0,0 +1,523 @@
+//    Cardmatic card generator - cardmatic_render.cpp file
+//    C++11 implementation file
+
+//    Renders generated cards as printable hand punch templates, several
+//      cards per page.  The card background is drawn once per document and
+//      each card only stamps its hole glyphs on it.  Pages are written as
+//      soon as they fill, so memory use does not grow with the number of
+//      cards.
+
+//    PDF objects: 1 catalog, 2 page tree (written last), 3 font,
+//      4 card background form, 5 hole form, then a page and its contents
+//      per page.  Drawing is in mm with y down, as in the SVG output.
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include "cardmatic_render.h"
+#include "../cardmatic_globals.h"
+
+
+#define RENDER_LABEL_SIZE 3.5       // card label font size in mm
+#define RENDER_AXIS_SIZE 3.0        // switch letter and row font size in mm
+#define RENDER_BEZIER_KAPPA 0.5523  // quarter circle Bezier handle
+
+
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// formats a length in mm
+static std::string mm(double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f", value);
+    return text;
+}
+
+//------------------------------------------------------------------------------
+
+// PDF path of a circle
+static std::string pdfCircle(double x,
+                             double y,
+                             double r)
+{
+    double k = r * RENDER_BEZIER_KAPPA;
+    std::ostringstream path;
+
+    path << mm(x + r) << ' ' << mm(y) << " m " <<
+        mm(x + r) << ' ' << mm(y + k) << ' ' << mm(x + k) << ' ' <<
+        mm(y + r) << ' ' << mm(x) << ' ' << mm(y + r) << " c " <<
+        mm(x - k) << ' ' << mm(y + r) << ' ' << mm(x - r) << ' ' <<
+        mm(y + k) << ' ' << mm(x - r) << ' ' << mm(y) << " c " <<
+        mm(x - r) << ' ' << mm(y - k) << ' ' << mm(x - k) << ' ' <<
+        mm(y - r) << ' ' << mm(x) << ' ' << mm(y - r) << " c " <<
+        mm(x + k) << ' ' << mm(y - r) << ' ' << mm(x + r) << ' ' <<
+        mm(y - k) << ' ' << mm(x + r) << ' ' << mm(y) << " c\n";
+
+    return path.str();
+}
+
+//------------------------------------------------------------------------------
+
+// PDF text, upright in the y down page space
+static std::string pdfText(double x,
+                           double y,
+                           double size,
+                           const std::string &text)
+{
+    std::string escaped;
+    for (auto it = text.begin(); it != text.end(); it++)
+    {
+        if (*it == '(' || *it == ')' || *it == '\\') { escaped += '\\'; }
+        escaped += *it;
+    }
+
+    return "BT /F1 " + mm(size) + " Tf 1 0 0 -1 " + mm(x) + ' ' + mm(y) +
+        " Tm (" + escaped + ") Tj ET\n";
+}
+
+//------------------------------------------------------------------------------
+
+// SVG text
+static std::string svgText(double x,
+                           double y,
+                           double size,
+                           const std::string &text)
+{
+    std::string escaped;
+    for (auto it = text.begin(); it != text.end(); it++)
+    {
+        if (*it == '&') { escaped += "&amp;"; }
+        else if (*it == '<') { escaped += "&lt;"; }
+        else if (*it == '>') { escaped += "&gt;"; }
+        else { escaped += *it; }
+    }
+
+    return "<text x=\"" + mm(x) + "\" y=\"" + mm(y) + "\" font-size=\"" +
+        mm(size) + "\">" + escaped + "</text>\n";
+}
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   format - output format
+//          fileName - PDF document, or SVG name of which page n is written to
+//              <name>-<n>.svg, i.e. cards-1.svg
+//          layout - card geometry, cardGap also spaces the cards on a page
+CardRenderer::CardRenderer(RenderFormat format,
+                           const std::string &fileName,
+                           const PunchLayout &layout) :
+    m_format(format),
+    m_fileName(fileName),
+    m_layout(layout),
+    m_planner(layout),
+    m_columns(0),
+    m_rows(0),
+    m_numPages(0),
+    m_ok(true),
+    m_finished(false),
+    m_offset(0)
+{
+    double width = RENDER_PAGE_WIDTH - 2 * RENDER_PAGE_MARGIN + layout.cardGap;
+    double height = RENDER_PAGE_HEIGHT - 2 * RENDER_PAGE_MARGIN +
+        layout.cardGap;
+
+    if (width > 0 && height > 0)
+    {
+        m_columns = std::floor(width / (layout.cardWidth + layout.cardGap));
+        m_rows = std::floor(height / (layout.cardHeight + layout.cardGap));
+    }
+
+    m_ok = m_columns > 0 && m_rows > 0;
+
+
+    if (m_format == RENDER_SVG)
+    {
+        // page n goes to <name>-<n>.svg
+        size_t suffix = m_fileName.rfind(".svg");
+        if (suffix != std::string::npos && suffix + 4 == m_fileName.size())
+        {
+            m_fileName.erase(suffix);
+        }
+
+        m_background = svgBackground();
+    }
+
+    else if (m_ok)
+    {
+        m_pdf.open(m_fileName, std::ios::binary);
+        m_ok = m_pdf.is_open();
+        if (m_ok) { beginPDF(); }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// destructor, calls finish()
+CardRenderer::~CardRenderer()
+{
+    finish();
+}
+
+//------------------------------------------------------------------------------
+
+// function to add a card to the current page, the page is written when it is
+//  full
+// returns: false if the card names a switch the cardreader does not have, or
+//          writing fails
+bool CardRenderer::addCard(const GeneratedCard &card)
+{
+    SwitchMatrix holes;
+    if (!m_ok || m_finished || !SwitchMatrix::fromString(card.closedSW,
+        holes))
+    {
+        return false;
+    }
+
+    m_page.push_back(card);
+    m_holes.push_back(holes);
+
+    if (m_page.size() == getCardsPerPage()) { writePage(); }
+
+    return m_ok;
+}
+
+//------------------------------------------------------------------------------
+
+// function to write the last page and end the document
+// returns: false if writing failed at any point
+bool CardRenderer::finish()
+{
+    if (m_finished) { return m_ok; }
+
+    if (m_ok && !m_page.empty()) { writePage(); }
+    if (m_ok && m_format == RENDER_PDF) { endPDF(); }
+
+    m_finished = true;
+    return m_ok;
+}
+
+//------------------------------------------------------------------------------
+
+// writes m_page as the next page
+void CardRenderer::writePage()
+{
+    m_numPages++;
+
+    if (m_format == RENDER_SVG) { writeSVGPage(); }
+    else { writePDFPage(); }
+
+    m_page.clear();
+    m_holes.clear();
+}
+
+//------------------------------------------------------------------------------
+
+// writes the page as its own SVG document.  The background is a <defs>
+//  group each card <use>s, holes <use> one circle
+void CardRenderer::writeSVGPage()
+{
+    std::ofstream svg(m_fileName + "-" + std::to_string(m_numPages) + ".svg");
+
+    svg << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" <<
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" " <<
+        "xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"" <<
+        RENDER_PAGE_WIDTH << "mm\" height=\"" << RENDER_PAGE_HEIGHT <<
+        "mm\" viewBox=\"0 0 " << RENDER_PAGE_WIDTH << ' ' <<
+        RENDER_PAGE_HEIGHT << "\" font-family=\"Helvetica, Arial, " <<
+        "sans-serif\">\n" <<
+        "<defs>\n" << m_background << "<circle id=\"hole\" r=\"" <<
+        mm(RENDER_HOLE_DIAMETER / 2) << "\"/>\n</defs>\n";
+
+    for (size_t slot = 0; slot < m_page.size(); slot++)
+    {
+        double x, y;
+        cardOrigin(slot, x, y);
+
+        svg << "<g transform=\"translate(" << mm(x) << ',' << mm(y) <<
+            ")\">\n<use xlink:href=\"#card\"/>\n";
+
+        for (int i = 0; i < SW_NUM_SWITCHES; i++)
+        {
+            if (!m_holes[slot].testBit(i)) { continue; }
+
+            double holeX, holeY;
+            m_planner.holePosition(i, holeX, holeY);
+            svg << "<use xlink:href=\"#hole\" x=\"" << mm(holeX) <<
+                "\" y=\"" << mm(holeY) << "\"/>\n";
+        }
+
+        svg << svgText(m_layout.firstHoleX,
+            m_layout.cardHeight - m_layout.firstHoleY / 3, RENDER_LABEL_SIZE,
+            label(m_page[slot])) << "</g>\n";
+    }
+
+    svg << "</svg>\n";
+    m_ok = m_ok && svg.good();
+}
+
+//------------------------------------------------------------------------------
+
+// writes a page and its contents.  Cards draw the background form and stamp
+//  the hole form
+void CardRenderer::writePDFPage()
+{
+    std::ostringstream content;
+
+    // mm, y down from the top of the page
+    content << "q " << mm(RENDER_MM_TO_PT) << " 0 0 " <<
+        mm(-RENDER_MM_TO_PT) << " 0 " <<
+        mm(RENDER_PAGE_HEIGHT * RENDER_MM_TO_PT) << " cm\n";
+
+    for (size_t slot = 0; slot < m_page.size(); slot++)
+    {
+        double x, y;
+        cardOrigin(slot, x, y);
+        content << "q 1 0 0 1 " << mm(x) << ' ' << mm(y) << " cm /C Do\n";
+
+        for (int i = 0; i < SW_NUM_SWITCHES; i++)
+        {
+            if (!m_holes[slot].testBit(i)) { continue; }
+
+            double holeX, holeY;
+            m_planner.holePosition(i, holeX, holeY);
+            content << "q 1 0 0 1 " << mm(holeX) << ' ' << mm(holeY) <<
+                " cm /H Do Q\n";
+        }
+
+        content << pdfText(m_layout.firstHoleX,
+            m_layout.cardHeight - m_layout.firstHoleY / 3, RENDER_LABEL_SIZE,
+            label(m_page[slot])) << "Q\n";
+    }
+
+    content << "Q\n";
+
+
+    unsigned int page = reserveObject();
+    unsigned int contents = reserveObject();
+    m_pageObjects.push_back(page);
+
+    pdfObject(page, "/Type /Page /Parent 2 0 R /MediaBox [0 0 " +
+        mm(RENDER_PAGE_WIDTH * RENDER_MM_TO_PT) + ' ' +
+        mm(RENDER_PAGE_HEIGHT * RENDER_MM_TO_PT) + "] /Resources << " +
+        "/XObject << /C 4 0 R /H 5 0 R >> /Font << /F1 3 0 R >> >> " +
+        "/Contents " + std::to_string(contents) + " 0 R");
+    pdfObject(contents, "", content.str());
+}
+
+//------------------------------------------------------------------------------
+
+// writes the header and the objects shared by all pages
+void CardRenderer::beginPDF()
+{
+    pdfWrite("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+
+    unsigned int catalog = reserveObject();
+    reserveObject();    // page tree, written by endPDF()
+    unsigned int font = reserveObject();
+    unsigned int background = reserveObject();
+    unsigned int hole = reserveObject();
+
+    double r = RENDER_HOLE_DIAMETER / 2;
+
+    pdfObject(catalog, "/Type /Catalog /Pages 2 0 R");
+    pdfObject(font, "/Type /Font /Subtype /Type1 /BaseFont /Helvetica");
+    pdfObject(background, "/Type /XObject /Subtype /Form /BBox [0 0 " +
+        mm(m_layout.cardWidth) + ' ' + mm(m_layout.cardHeight) + "] " +
+        "/Resources << /Font << /F1 3 0 R >> >>", pdfBackground());
+    pdfObject(hole, "/Type /XObject /Subtype /Form /BBox [" + mm(-r) + ' ' +
+        mm(-r) + ' ' + mm(r) + ' ' + mm(r) + "]", pdfCircle(0, 0, r) + "f\n");
+}
+
+//------------------------------------------------------------------------------
+
+// writes the page tree, cross reference table and trailer
+void CardRenderer::endPDF()
+{
+    std::string kids;
+    for (auto it = m_pageObjects.begin(); it != m_pageObjects.end(); it++)
+    {
+        kids += (kids.empty() ? "" : " ") + std::to_string(*it) + " 0 R";
+    }
+
+    pdfObject(2, "/Type /Pages /Kids [" + kids + "] /Count " +
+        std::to_string(m_pageObjects.size()));
+
+
+    unsigned long xref = m_offset;
+    char entry[32];
+
+    pdfWrite("xref\n0 " + std::to_string(m_objectOffsets.size() + 1) +
+        "\n0000000000 65535 f \n");
+
+    for (auto it = m_objectOffsets.begin(); it != m_objectOffsets.end(); it++)
+    {
+        std::snprintf(entry, sizeof(entry), "%010lu 00000 n \n", *it);
+        pdfWrite(entry);
+    }
+
+    pdfWrite("trailer\n<< /Size " + std::to_string(m_objectOffsets.size() + 1)
+        + " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) +
+        "\n%%EOF\n");
+
+    m_pdf.close();
+    m_ok = m_ok && !m_pdf.fail();
+}
+
+//------------------------------------------------------------------------------
+
+void CardRenderer::pdfWrite(const std::string &text)
+{
+    m_pdf.write(text.data(), text.size());
+    m_offset += text.size();
+    m_ok = m_ok && m_pdf.good();
+}
+
+//------------------------------------------------------------------------------
+
+// writes object number.  A stream object gets its /Length added
+void CardRenderer::pdfObject(unsigned int number,
+                             const std::string &dictionary,
+                             const std::string &stream)
+{
+    m_objectOffsets[number - 1] = m_offset;
+
+    if (stream.empty())
+    {
+        pdfWrite(std::to_string(number) + " 0 obj\n<< " + dictionary +
+            " >>\nendobj\n");
+        return;
+    }
+
+    pdfWrite(std::to_string(number) + " 0 obj\n<< " + dictionary +
+        (dictionary.empty() ? "" : " ") + "/Length " +
+        std::to_string(stream.size()) + " >>\nstream\n");
+    pdfWrite(stream);
+    pdfWrite("\nendstream\nendobj\n");
+}
+
+//------------------------------------------------------------------------------
+
+unsigned int CardRenderer::reserveObject()
+{
+    m_objectOffsets.push_back(0);
+    return m_objectOffsets.size();
+}
+
+//------------------------------------------------------------------------------
+
+// card position on the page, the block of cards is centred horizontally
+void CardRenderer::cardOrigin(unsigned int slot,
+                              double &x,
+                              double &y) const
+{
+    double blockWidth = m_columns * (m_layout.cardWidth + m_layout.cardGap) -
+        m_layout.cardGap;
+
+    x = (RENDER_PAGE_WIDTH - blockWidth) / 2 +
+        (slot % m_columns) * (m_layout.cardWidth + m_layout.cardGap);
+    y = RENDER_PAGE_MARGIN +
+        (slot / m_columns) * (m_layout.cardHeight + m_layout.cardGap);
+}
+
+//------------------------------------------------------------------------------
+
+// card label, i.e. "ECC83 1 T"
+std::string CardRenderer::label(const GeneratedCard &card)
+{
+    return card.tubeID + " " + std::to_string(card.testNum) + " " + card.test;
+}
+
+//------------------------------------------------------------------------------
+
+// SVG background group: outline, corner cut, every hole position and the
+//  switch letters and rows
+std::string CardRenderer::svgBackground() const
+{
+    std::ostringstream group;
+    double r = RENDER_HOLE_DIAMETER / 2;
+
+    group << "<g id=\"card\" fill=\"none\" stroke=\"black\">\n" <<
+        "<rect width=\"" << mm(m_layout.cardWidth) << "\" height=\"" <<
+        mm(m_layout.cardHeight) << "\" stroke-width=\"0.3\"/>\n" <<
+        "<path d=\"M0 8L8 0\" stroke-width=\"0.3\"/>\n";
+
+    for (int i = 0; i < SW_NUM_SWITCHES; i++)
+    {
+        double x, y;
+        m_planner.holePosition(i, x, y);
+        group << "<circle cx=\"" << mm(x) << "\" cy=\"" << mm(y) << "\" r=\"" <<
+            mm(r) << "\" stroke-width=\"0.1\"/>\n";
+    }
+
+    group << "<g fill=\"black\" stroke=\"none\">\n";
+
+    for (int column = 0; column < SW_NUM_LETTERS; column++)
+    {
+        double x, y;
+        m_planner.holePosition(column * SW_NUM_MAX, x, y);
+        group << svgText(x - 1, y - r - 2, RENDER_AXIS_SIZE,
+            std::string(1, SwitchMatrix::indexLetter(column * SW_NUM_MAX)));
+    }
+
+    for (int row = 0; row < SW_NUM_MAX; row++)
+    {
+        double x, y;
+        m_planner.holePosition(row, x, y);
+        group << svgText(x - r - 6, y + 1, RENDER_AXIS_SIZE,
+            std::to_string(row + SW_NUM_MIN));
+    }
+
+    group << "</g>\n</g>\n";
+    return group.str();
+}
+
+//------------------------------------------------------------------------------
+
+// PDF background form, the same drawing as svgBackground()
+std::string CardRenderer::pdfBackground() const
+{
+    std::ostringstream form;
+    double r = RENDER_HOLE_DIAMETER / 2;
+
+    form << "0.3 w 0 0 " << mm(m_layout.cardWidth) << ' ' <<
+        mm(m_layout.cardHeight) << " re S\n0 8 m 8 0 l S\n0.1 w\n";
+
+    for (int i = 0; i < SW_NUM_SWITCHES; i++)
+    {
+        double x, y;
+        m_planner.holePosition(i, x, y);
+        form << pdfCircle(x, y, r) << "S\n";
+    }
+
+    for (int column = 0; column < SW_NUM_LETTERS; column++)
+    {
+        double x, y;
+        m_planner.holePosition(column * SW_NUM_MAX, x, y);
+        form << pdfText(x - 1, y - r - 2, RENDER_AXIS_SIZE,
+            std::string(1, SwitchMatrix::indexLetter(column * SW_NUM_MAX)));
+    }
+
+    for (int row = 0; row < SW_NUM_MAX; row++)
+    {
+        double x, y;
+        m_planner.holePosition(row, x, y);
+        form << pdfText(x - r - 6, y + 1, RENDER_AXIS_SIZE,
+            std::to_string(row + SW_NUM_MIN));
+    }
+
+    return form.str();
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,163 @@
+//    Cardmatic card generator - cardmatic_render.h file
+//    C++11 header file
+
+//    Renders generated cards as printable hand punch templates, several
+//      cards per page.  The card background is drawn once per document and
+//      each card only stamps its hole glyphs on it.  Pages are written as
+//      soon as they fill, so memory use does not grow with the number of
+//      cards.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_RENDER_H
+#define CARDMATIC_RENDER_H
+
+#include "cardmatic_punch.h"
+#include <string>
+#include <vector>
+#include <fstream>
+
+
+// page geometry in mm, A4 portrait
+#define RENDER_PAGE_WIDTH 210.0
+#define RENDER_PAGE_HEIGHT 297.0
+#define RENDER_PAGE_MARGIN 10.0
+
+#define RENDER_HOLE_DIAMETER 4.0    // punched hole glyph
+#define RENDER_MM_TO_PT (72.0 / 25.4)
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CardRenderer
+{
+    public:
+        //----------------------------------------------------------------------
+        //  enums
+        //----------------------------------------------------------------------
+
+        typedef enum RenderFormat
+        {
+            RENDER_SVG,     // one document per page
+            RENDER_PDF,     // one document
+        }RenderFormat;
+
+
+
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   format - output format
+        //          fileName - PDF document, or SVG name of which page n is
+        //              written to <name>-<n>.svg, i.e. cards-1.svg
+        //          layout - card geometry, cardGap also spaces the cards on
+        //              a page
+        CardRenderer(RenderFormat format,
+                     const std::string &fileName,
+                     const PunchLayout &layout = PunchPlanner::defaultLayout());
+
+        ~CardRenderer();    // calls finish()
+
+        CardRenderer(const CardRenderer &) = delete;
+        CardRenderer &operator=(const CardRenderer &) = delete;
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to add a card to the current page, the page is written
+        //  when it is full
+        // returns: false if the card names a switch the cardreader does not
+        //          have, or writing fails
+        bool addCard(const GeneratedCard &card);
+
+
+        // function to write the last page and end the document
+        // returns: false if writing failed at any point
+        bool finish();
+
+
+        unsigned int getCardsPerPage() const { return m_columns * m_rows; }
+
+        unsigned int getNumPages() const { return m_numPages; }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        RenderFormat m_format;
+        std::string m_fileName;
+        PunchLayout m_layout;
+        PunchPlanner m_planner;     // hole positions
+
+        unsigned int m_columns;     // cards per page
+        unsigned int m_rows;
+
+        std::vector<GeneratedCard> m_page;  // cards of the page being filled
+        std::vector<SwitchMatrix> m_holes;
+        unsigned int m_numPages;
+        bool m_ok;
+        bool m_finished;
+
+        std::string m_background;           // SVG card group, built once
+
+        // PDF state
+        std::ofstream m_pdf;
+        unsigned long m_offset;             // bytes written so far
+        std::vector<unsigned long> m_objectOffsets;  // xref, by object - 1
+        std::vector<unsigned int> m_pageObjects;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // writes m_page as the next page
+        void writePage();
+
+        void writeSVGPage();
+
+        void writePDFPage();
+
+
+        // helpers to write the PDF header, objects and trailer
+        void beginPDF();
+
+        void endPDF();
+
+        void pdfWrite(const std::string &text);
+
+        // writes an object numbered by reserveObject()
+        void pdfObject(unsigned int number,
+                       const std::string &dictionary,
+                       const std::string &stream = std::string());
+
+        unsigned int reserveObject();
+
+
+        // card position on the page
+        void cardOrigin(unsigned int slot,
+                        double &x,
+                        double &y) const;
+
+        // card label, i.e. "ECC83 1 T"
+        static std::string label(const GeneratedCard &card);
+
+        // card background drawings, in mm with y down
+        std::string svgBackground() const;
+
+        std::string pdfBackground() const;
+};
+
+#endif // CARDMATIC_RENDER_H
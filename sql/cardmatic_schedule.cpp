@@ -0,0 +1,172 @@
+//    Cardmatic card generator - cardmatic_schedule.cpp file
+//    C++11 implementation file
+
+//    Test station scheduler.  The tests of a bin of tubes are grouped by
+//      card, so each distinct card is inserted once, and the cards are
+//      ordered so that each differs from the previous one in few switches.
+
+//    Written by: cathug
+
+
+#include <unordered_map>
+#include "cardmatic_schedule.h"
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+TestScheduler::TestScheduler() :
+    m_switchChanges(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+TestScheduler::~TestScheduler()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to add the test of a tube to the batch.  A tube with several
+//  cards, or several tubes of a type, add several tests
+// param:   card - card of the test
+// returns: false if the card names a switch the cardreader does not have,
+//          the test is not added then
+bool TestScheduler::addTest(const GeneratedCard &card)
+{
+    SwitchMatrix matrix;
+    if (!SwitchMatrix::fromString(card.closedSW, matrix)) { return false; }
+
+    m_tests.push_back(card);
+    m_cards.push_back(matrix);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to schedule the batch.  Tests with the same card are grouped,
+//  then the cards are ordered nearest first by the number of differing
+//  switches, starting from the card of most tests.  Grouping fixes the
+//  number of card changes, the order keeps each change small
+// post: getGroups() holds the cards in test order
+void TestScheduler::schedule()
+{
+    std::vector<CardGroup> groups;
+    std::unordered_map<SwitchMatrix, unsigned int, SwitchMatrixHash> exact;
+
+    for (unsigned int i = 0; i < m_cards.size(); i++)
+    {
+        auto found = exact.insert(std::make_pair(m_cards[i], groups.size()));
+        if (found.second)
+        {
+            groups.push_back(CardGroup());
+            groups.back().card = m_cards[i];
+        }
+
+        groups[found.first->second].tests.push_back(i);
+    }
+
+
+    m_groups.clear();
+    m_groups.reserve(groups.size());
+    m_switchChanges = 0;
+    if (groups.empty()) { return; }
+
+    size_t first = 0;
+    for (size_t g = 1; g < groups.size(); g++)
+    {
+        if (groups[g].tests.size() > groups[first].tests.size()) { first = g; }
+    }
+
+
+    // nearest neighbour.  The cards of unvisited groups are kept in a
+    //  contiguous array, and a removed group is replaced by the last one
+    std::vector<unsigned int> unvisited(groups.size());
+    std::vector<SwitchMatrix> cards(groups.size());
+
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        unvisited[g] = g;
+        cards[g] = groups[g].card;
+    }
+
+    size_t nearest = first;
+    unsigned int distance = cards[first].count();
+
+    while (true)
+    {
+        unsigned int g = unvisited[nearest];
+        groups[g].distance = distance;
+        if (!m_groups.empty()) { m_switchChanges += distance; }
+        m_groups.push_back(std::move(groups[g]));
+
+        SwitchMatrix previous = cards[nearest];
+        unvisited[nearest] = unvisited.back();
+        cards[nearest] = cards.back();
+        unvisited.pop_back();
+        cards.pop_back();
+
+        if (unvisited.empty()) { break; }
+
+
+        // distinct cards differ in at least one switch, ties go to the
+        //  card of more tests
+        nearest = 0;
+        distance = SW_NUM_SWITCHES + 1;
+
+        for (size_t i = 0; i < cards.size() && distance > 1; i++)
+        {
+            unsigned int d = previous.distance(cards[i]);
+            if (d < distance || (d == distance &&
+                groups[unvisited[i]].tests.size() >
+                groups[unvisited[nearest]].tests.size()))
+            {
+                nearest = i;
+                distance = d;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to print the schedule, for each card a line
+//  CARD <position> <distance> <closed switches>
+//  followed by a line per test: <TubeID> <testNum>
+void TestScheduler::print(std::ostream &out) const
+{
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const CardGroup &group = m_groups[g];
+        out << "CARD " << g + 1 << " " << group.distance << " " <<
+            group.card.toString() << "\n";
+
+        for (auto it = group.tests.begin(); it != group.tests.end(); it++)
+        {
+            out << "    " << m_tests[*it].tubeID << " " <<
+                m_tests[*it].testNum << "\n";
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to reset the batch
+void TestScheduler::clear()
+{
+    m_tests.clear();
+    m_cards.clear();
+    m_groups.clear();
+    m_switchChanges = 0;
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
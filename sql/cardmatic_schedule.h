@@ -0,0 +1,113 @@
+//    Cardmatic card generator - cardmatic_schedule.h file
+//    C++11 header file
+
+//    Test station scheduler.  The tests of a bin of tubes are grouped by
+//      card, so each distinct card is inserted once, and the cards are
+//      ordered so that each differs from the previous one in few switches.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_SCHEDULE_H
+#define CARDMATIC_SCHEDULE_H
+
+#include "cardmatic_sql.h"
+#include "../cardmatic_tube.h"
+#include <vector>
+#include <ostream>
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// a card of the schedule and the tests run with it
+typedef struct CardGroup
+{
+    SwitchMatrix card;
+    std::vector<unsigned int> tests;    // positions in getTests()
+    unsigned int distance;      // switches that differ from the previous
+                                // card, the number closed for the first
+}CardGroup;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class TestScheduler
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        TestScheduler();
+
+        ~TestScheduler();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to add the test of a tube to the batch.  A tube with
+        //  several cards, or several tubes of a type, add several tests
+        // param:   card - card of the test
+        // returns: false if the card names a switch the cardreader does not
+        //          have, the test is not added then
+        bool addTest(const GeneratedCard &card);
+
+
+        // function to schedule the batch.  Tests with the same card are
+        //  grouped, then the cards are ordered nearest first by the number
+        //  of differing switches, starting from the card of most tests
+        // post: getGroups() holds the cards in test order
+        void schedule();
+
+
+        // function to print the schedule, for each card a line
+        //  CARD <position> <distance> <closed switches>
+        //  followed by a line per test: <TubeID> <testNum>
+        void print(std::ostream &out) const;
+
+
+        // helper to reset the batch
+        void clear();
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors
+        //----------------------------------------------------------------------
+
+        const std::vector<GeneratedCard> &getTests() const { return m_tests; }
+
+        const std::vector<CardGroup> &getGroups() const { return m_groups; }
+
+        // card changes of the schedule, one per card after the first
+        size_t getNumSwaps() const
+        {
+            return m_groups.empty() ? 0 : m_groups.size() - 1;
+        }
+
+        // switches that differ between consecutive cards, in total
+        unsigned long getSwitchChanges() const { return m_switchChanges; }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        std::vector<GeneratedCard> m_tests;
+        std::vector<SwitchMatrix> m_cards;      // card of each test
+        std::vector<CardGroup> m_groups;
+        unsigned long m_switchChanges;
+};
+
+#endif // CARDMATIC_SCHEDULE_H
@@ -0,0 +1,633 @@
+//    Cardmatic card generator - cardmatic_service.cpp file
+//    C++11 implementation file
+
+//    Long-running card service.  Answers "card for tube X on model Y"
+//      requests on a Unix domain socket.  An epoll event loop owns all
+//      sockets; requests are handed to a pool of worker threads, each with
+//      its own DataConverter, TubeTests and leased database connection.
+
+//    Written by: cathug
+
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "cardmatic_service.h"
+#include "cardmatic_sql.h"
+#include "cardmatic_dataconvert.h"
+#include "cardmatic_translate.h"
+#include "../cardmatic_cardpos.h"
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// helper to make a descriptor non-blocking
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+//------------------------------------------------------------------------------
+
+// default constructor
+CardService::CardService() :
+    m_listenFd(-1),
+    m_epollFd(-1),
+    m_wakeFd(-1),
+    m_nextClientID(0),
+    m_running(false)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor, stops workers and closes sockets
+CardService::~CardService()
+{
+    shutdown();
+}
+
+//------------------------------------------------------------------------------
+
+// function to open the database, bind the socket and start workers
+// pre: service is not started
+// param:   dbFile - tube database, opened read-only
+//          socketPath - path of the Unix domain socket.  A stale socket file
+//              is replaced
+//          numWorkers - number of worker threads, at least 1
+// returns: true if the service is ready to run, false otherwise
+bool CardService::start(const char* dbFile,
+                        const char* socketPath,
+                        unsigned int numWorkers)
+{
+    struct sockaddr_un address;
+    struct epoll_event event;
+
+    if (numWorkers == 0) { numWorkers = 1; }
+
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return false;
+    }
+
+    // one connection per worker, so a worker never waits for a lease
+    if (m_pool.open(dbFile, numWorkers) == false || loadRowIDs() == false)
+    {
+        m_pool.close();
+        return false;
+    }
+
+
+    // listening socket
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath);
+
+    if (m_listenFd < 0 ||
+        bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&address),
+            sizeof(address)) != 0 ||
+        listen(m_listenFd, SOMAXCONN) != 0 ||
+        setNonBlocking(m_listenFd) == false)
+    {
+        std::cerr << "Failed to listen on " << socketPath << ": " <<
+            strerror(errno) << std::endl;
+        shutdown();
+        return false;
+    }
+
+    m_socketPath = socketPath;
+
+
+    // event loop
+    m_epollFd = epoll_create1(0);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK);
+    if (m_epollFd < 0 || m_wakeFd < 0)
+    {
+        std::cerr << "Failed to create event loop: " << strerror(errno) <<
+            std::endl;
+        shutdown();
+        return false;
+    }
+
+    event.events = EPOLLIN;
+    event.data.fd = m_listenFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+
+    // workers
+    m_running = true;
+    for (unsigned int i = 0; i < numWorkers; i++)
+    {
+        m_workers.push_back(std::thread(&CardService::workerLoop, this));
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to run the event loop on the calling thread
+// pre: start() returned true
+// post: returns once stop() is called
+void CardService::run()
+{
+    struct epoll_event events[SERVICE_MAX_EVENTS];
+
+    while (m_running)
+    {
+        int numEvents = epoll_wait(m_epollFd, events, SERVICE_MAX_EVENTS, -1);
+        if (numEvents < 0)
+        {
+            if (errno == EINTR) { continue; }
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < numEvents; i++)
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == m_listenFd) { acceptClients(); }
+
+            else if (fd == m_wakeFd) { collectReplies(); }
+
+            else if (events[i].events & EPOLLERR) { closeClient(fd); }
+
+            // a hang up reads as end of file, so requests received before
+            //  it are still answered
+            else
+            {
+                if (events[i].events & (EPOLLIN | EPOLLHUP))
+                {
+                    readClient(fd);
+                }
+
+                if (events[i].events & (EPOLLOUT | EPOLLHUP))
+                {
+                    flushClient(fd);
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to make run() return, may be called from any thread and from a
+//  signal handler.  Workers are stopped by shutdown()
+void CardService::stop()
+{
+    uint64_t one = 1;
+
+    m_running = false;
+    if (write(m_wakeFd, &one, sizeof(one)) < 0) { /* loop is awake */ }
+}
+
+//------------------------------------------------------------------------------
+
+// function to answer a single request line
+// param:   request - request without line terminator
+//          converter, tests - scratch objects of the calling worker
+// returns: response lines, each terminated by '\n'
+std::string CardService::handleRequest(const std::string &request,
+                                       DataConverter &converter,
+                                       TubeTests &tests)
+{
+    std::istringstream fields(request);
+    std::string command, tubeID, model;
+    std::vector<std::string> text;
+    std::vector<double> values;
+    std::string response;
+    int numCards = 0;
+    int testNum = 0;
+
+    fields >> command >> tubeID >> model;
+
+    if (command != "CARD" || tubeID.empty())
+    {
+        return "ERR usage: CARD <TubeID> [model]\n";
+    }
+
+    // cards are generated for CARDMATIC_MODEL and translated to the model
+    //  asked for
+    CardTranslator translator(CARDMATIC_MODEL, model.empty() ? 
+        CARDMATIC_MODEL : std::atoi(model.c_str()));
+    if (!translator.isValid())
+    {
+        return "ERR model " + model + " not supported\n";
+    }
+
+
+    auto rowIDs = m_rowIDs.find(tubeID);
+    if (rowIDs == m_rowIDs.end())
+    {
+        return "ERR tube " + tubeID + " not found\n";
+    }
+
+    int numRows = rowIDs->second.size();
+    text.resize(numRows * NUM_TEXT_COLS_PER_ROW);
+    values.resize(numRows * NUM_DOUBLE_COLS_PER_ROW);
+
+    {
+        ConnectionPool::Lease lease = m_pool.acquire();
+        sqlite3_stmt* query = lease.statement(std::string("select * from ") +
+            SERVICE_TABLE + " where rowid = $rowid");
+        if (query == NULL) { return "ERR database error\n"; }
+
+        for (int row = 0; row < numRows; row++)
+        {
+            sqlite3_reset(query);
+            sqlite3_bind_int64(query, 1, rowIDs->second[row]);
+            if (sqlite3_step(query) != SQLITE_ROW)
+            {
+                return "ERR database error\n";
+            }
+
+            Database::readRow(query, &text[row * NUM_TEXT_COLS_PER_ROW],
+                &values[row * NUM_DOUBLE_COLS_PER_ROW], false);
+        }
+
+        sqlite3_reset(query);   // release read lock
+    }
+
+    for (int row = 0; row < numRows; row++)
+    {
+        const std::string* rowText = &text[row * NUM_TEXT_COLS_PER_ROW];
+        const double* rowValues = &values[row * NUM_DOUBLE_COLS_PER_ROW];
+
+        SwitchMatrix card;
+        if (converter.convertAVOData(rowText, rowValues, row, tests,
+                card) != CONVERT_OK)
+        {
+            continue;
+        }
+
+        testNum++;
+        unsigned int faults = translator.translateCard(card,
+            tests.getTestParam().current);
+        if (faults != 0)
+        {
+            response += "NOCARD " + tubeID + " " + std::to_string(testNum) + 
+                " " + rowText[CLASS] + " " + 
+                CardTranslator::faultNames(faults) + "\n";
+            continue;
+        }
+
+        numCards++;
+        response += "CARD " + tubeID + " " + std::to_string(testNum) + " " +
+            rowText[CLASS] + " " + card.toString() + "\n";
+    }
+
+    if (testNum == 0) { return "ERR tube " + tubeID + " cannot be mapped\n"; }
+
+    return response + "END " + std::to_string(numCards) + "\n";
+}
+
+//------------------------------------------------------------------------------
+
+// helper to fill m_rowIDs
+// returns: true if successful, false otherwise
+bool CardService::loadRowIDs()
+{
+    ConnectionPool::Lease lease = m_pool.acquire();
+    sqlite3_stmt* query = lease.statement(std::string(
+        "select rowid, TubeID from ") + SERVICE_TABLE + " order by rowid");
+    int return_code;
+
+    if (query == NULL) { return false; }
+
+    m_rowIDs.clear();
+    while ((return_code = sqlite3_step(query)) == SQLITE_ROW)
+    {
+        const unsigned char* tubeID = sqlite3_column_text(query, 1);
+        if (tubeID == NULL) { continue; }
+
+        m_rowIDs[reinterpret_cast<const char*>(tubeID)].push_back(
+            sqlite3_column_int64(query, 0));
+    }
+
+    sqlite3_reset(query);
+    return return_code == SQLITE_DONE;
+}
+
+//------------------------------------------------------------------------------
+
+// worker thread body
+void CardService::workerLoop()
+{
+    DataConverter converter;
+    TubeTests tests;
+    uint64_t one = 1;
+
+    converter.setVerbose(false);
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requestReady.wait(lock, [this]()
+                {
+                    return !m_running || !m_requests.empty();
+                });
+
+            if (!m_running) { return; }
+
+            job = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        job.text = handleRequest(job.text, converter, tests);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_replies.push_back(std::move(job));
+        }
+
+        if (write(m_wakeFd, &one, sizeof(one)) < 0) { /* loop is awake */ }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to accept all pending connections
+void CardService::acceptClients()
+{
+    int fd;
+
+    while ((fd = accept(m_listenFd, NULL, NULL)) >= 0)
+    {
+        setNonBlocking(fd);
+
+        Client &client = m_clients[fd];
+        client.id = m_nextClientID++;
+        client.input.clear();
+        client.output.clear();
+        client.busy = false;
+        client.hungUp = false;
+        client.events = 0;
+
+        watchClient(fd);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to read request bytes of a client
+void CardService::readClient(int fd)
+{
+    char buffer[4096];
+    ssize_t numRead;
+
+    auto found = m_clients.find(fd);
+    if (found == m_clients.end()) { return; }
+
+    Client &client = found->second;
+    while ((numRead = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        client.input.append(buffer, numRead);
+
+        // requests may be pipelined, but not without bound
+        if (client.input.size() > SERVICE_MAX_INPUT)
+        {
+            closeClient(fd);
+            return;
+        }
+    }
+
+    if (numRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        closeClient(fd);    // pending replies are dropped
+        return;
+    }
+
+    // end of file, buffered requests are answered before closing
+    if (numRead == 0 && !client.hungUp)
+    {
+        client.hungUp = true;
+        watchClient(fd);
+    }
+
+    dispatchRequest(fd);
+}
+
+//------------------------------------------------------------------------------
+
+// helper to hand the next complete request of a client to the workers.
+//  Requests of a client are answered one at a time, so responses keep the
+//  order of requests
+void CardService::dispatchRequest(int fd)
+{
+    Client &client = m_clients[fd];
+    if (client.busy) { return; }
+
+    size_t end = client.input.find('\n');
+    size_t length = end != std::string::npos ? end : client.input.size();
+
+    if (length > SERVICE_MAX_REQUEST)   // answer and hang up
+    {
+        client.input.clear();
+        client.output += "ERR request longer than " + 
+            std::to_string(SERVICE_MAX_REQUEST) + " bytes\n";
+        client.hungUp = true;
+        flushClient(fd);
+        return;
+    }
+
+    if (end == std::string::npos)
+    {
+        if (!client.hungUp) { return; }     // rest of the line to come
+
+        if (client.input.empty())           // nothing left to answer
+        {
+            flushClient(fd);
+            return;
+        }
+
+        end = client.input.size();          // last request, not terminated
+    }
+
+    Job job;
+    job.fd = fd;
+    job.clientID = client.id;
+    job.text = client.input.substr(0, end);
+    if (!job.text.empty() && job.text.back() == '\r') { job.text.pop_back(); }
+    client.input.erase(0, end + 1);
+    client.busy = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests.push_back(std::move(job));
+    }
+
+    m_requestReady.notify_one();
+}
+
+//------------------------------------------------------------------------------
+
+// helper to queue finished responses for sending
+void CardService::collectReplies()
+{
+    uint64_t count;
+    std::deque<Job> replies;
+
+    if (read(m_wakeFd, &count, sizeof(count)) < 0) { /* already drained */ }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        replies.swap(m_replies);
+    }
+
+    for (auto it = replies.begin(); it != replies.end(); it++)
+    {
+        auto found = m_clients.find(it->fd);
+
+        // client hung up, its descriptor may belong to a new client
+        if (found == m_clients.end() || found->second.id != it->clientID)
+        {
+            continue;
+        }
+
+        found->second.output += it->text;
+        found->second.busy = false;
+        flushClient(it->fd);
+
+        if (m_clients.count(it->fd)) { dispatchRequest(it->fd); }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// helper to send queued response bytes, waits for EPOLLOUT if the socket
+//  buffer is full
+void CardService::flushClient(int fd)
+{
+    auto found = m_clients.find(fd);
+    if (found == m_clients.end()) { return; }
+
+    const Client &client = found->second;
+    std::string &output = found->second.output;
+    while (!output.empty())
+    {
+        ssize_t numSent = send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+        if (numSent < 0) { break; }
+        output.erase(0, numSent);
+    }
+
+    if (!output.empty() && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        closeClient(fd);
+        return;
+    }
+
+    if (output.empty() && client.hungUp && !client.busy && 
+        client.input.empty())
+    {
+        closeClient(fd);    // every request is answered
+        return;
+    }
+
+    watchClient(fd);
+}
+
+//------------------------------------------------------------------------------
+
+// helper to watch the events a client waits for: requests until it hangs
+//  up, and room in the socket buffer while responses are queued.  A client
+//  waiting for neither is removed from epoll, which would otherwise keep
+//  reporting its hang up
+void CardService::watchClient(int fd)
+{
+    struct epoll_event event;
+    Client &client = m_clients[fd];
+
+    event.events = 0;
+    if (!client.hungUp) { event.events |= EPOLLIN; }
+    if (!client.output.empty()) { event.events |= EPOLLOUT; }
+    event.data.fd = fd;
+    if (event.events == client.events) { return; }
+
+    if (client.events == 0)
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    else if (event.events == 0)
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, NULL);
+    }
+
+    else
+    {
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    client.events = event.events;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to disconnect a client
+void CardService::closeClient(int fd)
+{
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    m_clients.erase(fd);
+}
+
+//------------------------------------------------------------------------------
+
+// helper to close all descriptors and join workers
+void CardService::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_requestReady.notify_all();
+
+    for (auto it = m_workers.begin(); it != m_workers.end(); it++)
+    {
+        it->join();
+    }
+    m_workers.clear();
+
+    while (!m_clients.empty()) { closeClient(m_clients.begin()->first); }
+
+    if (m_listenFd >= 0) { close(m_listenFd); }
+    if (m_epollFd >= 0) { close(m_epollFd); }
+    if (m_wakeFd >= 0) { close(m_wakeFd); }
+    m_listenFd = m_epollFd = m_wakeFd = -1;
+
+    if (!m_socketPath.empty()) { unlink(m_socketPath.c_str()); }
+    m_socketPath.clear();
+
+    m_requests.clear();
+    m_replies.clear();
+    m_pool.close();
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
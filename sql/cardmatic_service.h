@@ -0,0 +1,187 @@
+//    Cardmatic card generator - cardmatic_service.h file
+//    C++11 header file
+
+//    Long-running card service.  Answers "card for tube X on model Y"
+//      requests on a Unix domain socket.  An epoll event loop owns all
+//      sockets; requests are handed to a pool of worker threads, each with
+//      its own DataConverter, TubeTests and leased database connection.
+
+//    Protocol, one request per line:
+//      CARD <TubeID> [model]
+//    is answered by one line per card and a terminating line
+//      CARD <TubeID> <testNum> <class> <closed switches>
+//      NOCARD <TubeID> <testNum> <class> <reasons>
+//      END <number of CARD lines>
+//    NOCARD marks a card of CARDMATIC_MODEL without an equivalent on the
+//    model asked for, see CardTranslator
+//    or by
+//      ERR <reason>
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_SERVICE_H
+#define CARDMATIC_SERVICE_H
+
+#include "cardmatic_sqlpool.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+
+class DataConverter;
+class TubeTests;
+
+
+#define SERVICE_DEFAULT_WORKERS 4       // default number of worker threads
+#define SERVICE_MAX_EVENTS 64           // epoll events handled per wakeup
+#define SERVICE_MAX_REQUEST 256         // longest request line accepted
+#define SERVICE_MAX_INPUT 65536         // pending request bytes of a client
+#define SERVICE_TABLE "avocardmatic"    // table holding the tube data
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CardService
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        CardService();      // default constructor
+
+        ~CardService();     // destructor, stops workers and closes sockets
+
+        CardService(const CardService &) = delete;
+        CardService &operator=(const CardService &) = delete;
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to open the database, bind the socket and start workers
+        // pre: service is not started
+        // param:   dbFile - tube database, opened read-only
+        //          socketPath - path of the Unix domain socket.  A stale
+        //              socket file is replaced
+        //          numWorkers - number of worker threads, at least 1
+        // returns: true if the service is ready to run, false otherwise
+        bool start(const char* dbFile,
+                   const char* socketPath,
+                   unsigned int numWorkers = SERVICE_DEFAULT_WORKERS);
+
+
+        // function to run the event loop on the calling thread
+        // pre: start() returned true
+        // post: returns once stop() is called
+        void run();
+
+
+        // function to make run() return, may be called from any thread and
+        //  from a signal handler.  Workers are stopped by the destructor
+        void stop();
+
+
+        // function to answer a single request line
+        // param:   request - request without line terminator
+        //          converter, tests - scratch objects of the calling worker
+        // returns: response lines, each terminated by '\n'
+        std::string handleRequest(const std::string &request,
+                                  DataConverter &converter,
+                                  TubeTests &tests);
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  structs
+        //----------------------------------------------------------------------
+
+        // state of a connected client
+        typedef struct Client
+        {
+            uint64_t id;            // distinguishes reused descriptors
+            std::string input;      // bytes received, not yet dispatched
+            std::string output;     // bytes not yet sent
+            bool busy;              // a request is with the workers
+            bool hungUp;            // no more requests, close once answered
+            uint32_t events;        // epoll events watched, 0 = none
+        }Client;
+
+
+        // a request handed to the workers, or its response
+        typedef struct Job
+        {
+            int fd;
+            uint64_t clientID;
+            std::string text;
+        }Job;
+
+
+
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        ConnectionPool m_pool;
+        std::string m_socketPath;
+
+        // rowids of the rows of every tube.  The tube table has no index on
+        // TubeID, so requests look rows up by rowid instead of scanning
+        std::unordered_map<std::string, std::vector<sqlite3_int64> > m_rowIDs;
+
+        int m_listenFd;
+        int m_epollFd;
+        int m_wakeFd;                       // eventfd, signals replies and stop
+
+        std::map<int, Client> m_clients;    // owned by the event loop thread
+        uint64_t m_nextClientID;
+
+        std::vector<std::thread> m_workers;
+        std::deque<Job> m_requests;         // guarded by m_mutex
+        std::deque<Job> m_replies;          // guarded by m_mutex
+        std::mutex m_mutex;
+        std::condition_variable m_requestReady;
+
+        std::atomic<bool> m_running;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // helper to fill m_rowIDs
+        // returns: true if successful, false otherwise
+        bool loadRowIDs();
+
+        // worker thread body
+        void workerLoop();
+
+        // helpers of the event loop
+        void acceptClients();
+        void readClient(int fd);
+        void dispatchRequest(int fd);
+        void collectReplies();
+        void flushClient(int fd);
+        void watchClient(int fd);
+        void closeClient(int fd);
+
+        // helper to close all descriptors and join workers
+        void shutdown();
+};
+
+#endif // CARDMATIC_SERVICE_H
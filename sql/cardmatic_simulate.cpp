@@ -0,0 +1,585 @@
+//    Cardmatic card generator - cardmatic_simulate.cpp file
+//    C++11 implementation file
+
+//    Meter simulator.  A card and the AVO test data of its tube are turned
+//      into a netlist of the regulated B+ supply, the bias divider with the
+//      decade resistor, the tube, and the meter with its multipliers and
+//      shunts, which is solved by modified nodal analysis.  The plate current
+//      test reads the DC solution, the gm test the rectified signal current
+//      of a small signal solution at the DC operating point, giving the
+//      meter deflection a tester would show for the card.
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <algorithm>
+#include "cardmatic_simulate.h"
+#include "cardmatic_dataconvert.h"
+#include "../cardmatic_cardpos.h"
+#include "../cardmatic_globals.h"
+
+
+// average of a full wave rectified sine over its rms value, the umhometer
+//  reads the rectified signal current
+#define RECTIFIED_AVERAGE (2 * M_SQRT2 / M_PI)
+
+
+// nodes of the netlist.  The meter is in the plate line, B+ through the
+//  movement and multipliers to the anode, with the shunts across
+typedef enum SimNode
+{
+    NODE_GROUND,
+    NODE_BPLUS,
+    NODE_ANODE,
+    NODE_MOVEMENT,          // movement to 100k multiplier
+    NODE_MULT_1070,         // 100k to 1070 ohm multiplier
+    NODE_MULT_25340,        // 1070 to 25,340 ohm multiplier
+    NODE_CATHODE,
+    NODE_GRID,
+    NODE_DIVIDER,           // bias divider, fixed arm to decade resistor
+    NODE_BIAS_SUPPLY,
+    NUM_SIM_NODES,
+}SimNode;
+
+
+static const char* SIM_STATUS_NAMES[] = {
+    "ok",
+    "not modelled",
+    "no test data",
+    "invalid decade",
+    "no convergence",
+};
+
+
+
+//------------------------------------------------------------------------------
+// SparseSystem implementation
+//------------------------------------------------------------------------------
+
+// constructor
+SparseSystem::SparseSystem()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+SparseSystem::~SparseSystem()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// helper to clear to a system of numUnknowns unknowns
+void SparseSystem::reset(size_t numUnknowns)
+{
+    m_rows.resize(numUnknowns);
+    for (auto it = m_rows.begin(); it != m_rows.end(); it++) { it->clear(); }
+    m_rhs.assign(numUnknowns, 0);
+}
+
+//------------------------------------------------------------------------------
+
+// helper to add value to an entry of the matrix, keeping the row sorted
+void SparseSystem::add(size_t row, size_t column, double value)
+{
+    std::vector<SparseEntry> &entries = m_rows[row];
+    auto it = std::lower_bound(entries.begin(), entries.end(), column,
+        [](const SparseEntry &entry, size_t c) { return entry.column < c; });
+
+    if (it != entries.end() && it->column == column) { it->value += value; }
+    else { entries.insert(it, SparseEntry{column, value}); }
+}
+
+//------------------------------------------------------------------------------
+
+// function to solve the system, which is left eliminated.  Rows below the
+//  pivot start at the pivot column, so a row takes part in a step only if
+//  its first entry is in that column, and fill in is merged into the row
+// param:   x - set to the solution
+// returns: false if the matrix is singular
+bool SparseSystem::solve(std::vector<double> &x)
+{
+    const size_t n = m_rows.size();
+    std::vector<SparseEntry> merged;
+
+    for (size_t k = 0; k < n; k++)
+    {
+        // partial pivoting among the rows with an entry in column k
+        size_t pivot = n;
+        double largest = 0;
+        for (size_t r = k; r < n; r++)
+        {
+            if (!m_rows[r].empty() && m_rows[r].front().column == k &&
+                std::fabs(m_rows[r].front().value) > largest)
+            {
+                pivot = r;
+                largest = std::fabs(m_rows[r].front().value);
+            }
+        }
+
+        if (pivot == n) { return false; }
+        std::swap(m_rows[k], m_rows[pivot]);
+        std::swap(m_rhs[k], m_rhs[pivot]);
+
+        const std::vector<SparseEntry> &pivotRow = m_rows[k];
+        for (size_t r = k + 1; r < n; r++)
+        {
+            std::vector<SparseEntry> &row = m_rows[r];
+            if (row.empty() || row.front().column != k) { continue; }
+
+            double factor = row.front().value / pivotRow.front().value;
+            m_rhs[r] -= factor * m_rhs[k];
+
+            // row - factor * pivotRow, both sorted, without column k
+            merged.clear();
+            auto a = row.begin() + 1;
+            auto b = pivotRow.begin() + 1;
+            while (a != row.end() || b != pivotRow.end())
+            {
+                if (b == pivotRow.end() ||
+                    (a != row.end() && a->column < b->column))
+                {
+                    merged.push_back(*a++);
+                }
+                else if (a == row.end() || b->column < a->column)
+                {
+                    merged.push_back(SparseEntry{b->column,
+                        -factor * b->value});
+                    b++;
+                }
+                else
+                {
+                    merged.push_back(SparseEntry{a->column,
+                        a->value - factor * b->value});
+                    a++;
+                    b++;
+                }
+            }
+
+            row.swap(merged);
+        }
+    }
+
+
+    // back substitution
+    x.assign(n, 0);
+    for (size_t k = n; k-- > 0; )
+    {
+        double sum = m_rhs[k];
+        for (auto it = m_rows[k].begin() + 1; it != m_rows[k].end(); it++)
+        {
+            sum -= it->value * x[it->column];
+        }
+        x[k] = sum / m_rows[k].front().value;
+    }
+
+    return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+// MeterSimulator implementation
+//------------------------------------------------------------------------------
+
+// constructor
+MeterSimulator::MeterSimulator() :
+    m_numSources(0),
+    m_perveance(0),
+    m_mu(1),
+    m_gridWeight(0),
+    m_gm(0),
+    m_gc(0)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+MeterSimulator::~MeterSimulator()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to predict the meter reading of a card.  The meter is read from
+//  the card: the test from the bridge and plate line switches, the range
+//  from L7 and L12 and the shunts from row 12, as umho_meterShunt() and
+//  ma_meterShunt() set them
+// param:   card - closed switches
+//          values - AVO test data of the tested section, Vh, Vg1, Va, Vg2,
+//              Ia, gm, NaN if missing
+//          reading - set to the prediction if successful
+// returns: SIM_OK if successful, otherwise why there is no prediction
+SimStatus MeterSimulator::simulate(const SwitchMatrix &card,
+                                   const double* values,
+                                   MeterReading &reading)
+{
+    MeterMode mode = METER_MODE_NONE;
+
+    if (card.isClosed('H', ROW_15) && card.isClosed('H', ROW_13) &&
+        card.isClosed('K', ROW_17))
+    {
+        mode = METER_MODE_GM;
+    }
+
+    // auxiliary B+ (L5) and the rectifier load (L17) are not modelled
+    else if (card.isClosed('J', ROW_17) && card.isClosed('A', ROW_13) &&
+        card.isClosed('C', ROW_13) && !card.isClosed('L', ROW_5) &&
+        !card.isClosed('L', ROW_17))
+    {
+        mode = METER_MODE_PLATE;
+    }
+
+    if (mode == METER_MODE_NONE) { return SIM_NOT_MODELLED; }
+
+
+    // the grid is biased if gridBias() connected the grid supply and chose
+    //  fixed (L14, C16) or self (K14) bias, which diodeTest() does not, and
+    //  the screen is fed from B+ by J15
+    bool grid = card.isClosed('H', ROW_14) &&
+        (card.isClosed('K', ROW_13) || card.isClosed('L', ROW_13)) &&
+        ((card.isClosed('L', ROW_14) && card.isClosed('C', ROW_16)) ||
+            card.isClosed('K', ROW_14)) &&
+        (mode == METER_MODE_GM || values[GM] > 0);
+    bool screen = card.isClosed('J', ROW_15) && values[V_GRID2] > 0;
+
+    if ((mode == METER_MODE_GM && !grid) || !fitTube(values, grid, screen))
+    {
+        return SIM_NO_PARAMS;
+    }
+
+    unsigned long decadeOhms = 0;
+    bool decade = card.isClosed('H', ROW_14);
+    if (decade && !TubeTests::cardDecadeOhms(card, decadeOhms))
+    {
+        return SIM_INVALID_CARD;
+    }
+
+
+    // netlist
+    m_netlist.clear();
+    m_numSources = 0;
+
+    addElement(ELEMENT_SOURCE, NODE_BPLUS, NODE_GROUND,
+        TubeTests::cardBPlus(card));
+
+    // meter, multipliers shorted by A13, L12 and L7
+    double multiplierOhms = 0;
+    addElement(ELEMENT_RESISTOR, NODE_BPLUS, NODE_MOVEMENT,
+        METER_MOVEMENT_RES);
+    addElement(ELEMENT_RESISTOR, NODE_MOVEMENT, NODE_MULT_1070,
+        METER_MULT_RES_100K);
+    addElement(ELEMENT_RESISTOR, NODE_MULT_1070, NODE_MULT_25340,
+        METER_MULT_RES_1070);
+    addElement(ELEMENT_RESISTOR, NODE_MULT_25340, NODE_ANODE,
+        METER_MULT_RES_25340);
+
+    if (card.isClosed('A', ROW_13))
+    {
+        addElement(ELEMENT_RESISTOR, NODE_MOVEMENT, NODE_MULT_1070,
+            SIM_SWITCH_RES);
+    }
+    else { multiplierOhms += METER_MULT_RES_100K; }
+
+    if (card.isClosed('L', ROW_12))
+    {
+        addElement(ELEMENT_RESISTOR, NODE_MULT_1070, NODE_ANODE,
+            SIM_SWITCH_RES);
+    }
+    else if (card.isClosed('L', ROW_7))
+    {
+        addElement(ELEMENT_RESISTOR, NODE_MULT_25340, NODE_ANODE,
+            SIM_SWITCH_RES);
+        multiplierOhms += METER_MULT_RES_1070;
+    }
+    else { multiplierOhms += METER_MULT_RES_1070 + METER_MULT_RES_25340; }
+
+    unsigned int choice = TubeTests::cardMeterShunt(card);
+    for (unsigned int weight = PRIMARY_CHOICE_MAX; weight != 0; weight /= 2)
+    {
+        if (choice & weight)
+        {
+            addElement(ELEMENT_RESISTOR, NODE_BPLUS, NODE_ANODE,
+                METER_SHUNT_UNIT_RES / weight);
+        }
+    }
+
+    // cathode, grounded by L14 for fixed bias, or through the decade
+    //  resistor for self bias and current limiting
+    bool fixedBias = card.isClosed('L', ROW_14) || !decade;
+    if (fixedBias)
+    {
+        addElement(ELEMENT_RESISTOR, NODE_CATHODE, NODE_GROUND,
+            SIM_SWITCH_RES);
+    }
+    else
+    {
+        addElement(ELEMENT_RESISTOR, NODE_CATHODE, NODE_GROUND,
+            std::max<double>(decadeOhms, SIM_SWITCH_RES));
+    }
+
+    // grid, from the bias divider with the decade resistor as lower arm, or
+    //  from ground for self bias.  The gm signal is in series
+    if (grid)
+    {
+        double signal = mode == METER_MODE_GM && card.isClosed('L', ROW_13) ?
+            GM_SIGNAL_VOLTS : 0;
+
+        if (fixedBias)
+        {
+            addElement(ELEMENT_SOURCE, NODE_BIAS_SUPPLY, NODE_GROUND,
+                -V_BIAS_SUPPLY);
+            addElement(ELEMENT_RESISTOR, NODE_BIAS_SUPPLY, NODE_DIVIDER,
+                BIAS_DIVIDER_RES);
+            addElement(ELEMENT_RESISTOR, NODE_DIVIDER, NODE_CATHODE,
+                std::max<double>(decadeOhms, SIM_SWITCH_RES));
+            addElement(ELEMENT_SOURCE, NODE_GRID, NODE_DIVIDER, 0, signal);
+        }
+        else { addElement(ELEMENT_SOURCE, NODE_GRID, NODE_GROUND, 0, signal); }
+    }
+
+    CircuitElement tube = CircuitElement();
+    tube.kind = ELEMENT_TUBE;
+    tube.nodes[0] = NODE_ANODE;
+    tube.nodes[1] = NODE_CATHODE;
+    tube.nodes[2] = grid ? NODE_GRID : NODE_CATHODE;
+    tube.nodes[3] = screen ? NODE_BPLUS : NODE_ANODE;
+    m_netlist.push_back(tube);
+
+
+    // DC solution by Newton's method.  The tube law is convex, so starting
+    //  from no plate current the iterates approach from above
+    m_x.assign(NUM_SIM_NODES - 1 + m_numSources, 0);
+    std::vector<double> next;
+    bool converged = false;
+
+    for (unsigned int i = 0; i < SIM_MAX_ITERATIONS && !converged; i++)
+    {
+        stamp(false);
+        if (!m_system.solve(next)) { return SIM_NO_CONVERGENCE; }
+
+        double step = 0;
+        for (size_t n = 0; n < NUM_SIM_NODES - 1; n++)
+        {
+            step = std::max(step, std::fabs(next[n] - m_x[n]));
+        }
+
+        m_x.swap(next);
+        converged = step < SIM_TOLERANCE;
+    }
+
+    if (!converged) { return SIM_NO_CONVERGENCE; }
+
+    // stamp once more so m_gm and m_gc are at the solution
+    stamp(false);
+    reading.mode = mode;
+    reading.vAnode = nodeVolts(NODE_ANODE) - nodeVolts(NODE_CATHODE);
+    reading.vGrid = grid ? nodeVolts(NODE_GRID) - nodeVolts(NODE_CATHODE) : 0;
+
+    double movementAmps = (nodeVolts(NODE_BPLUS) - nodeVolts(NODE_MOVEMENT)) /
+        METER_MOVEMENT_RES;
+    double fullScaleAmps = METER_MOVEMENT_UA * 1e-6 * (1 + choice *
+        (METER_MOVEMENT_RES + multiplierOhms) / METER_SHUNT_UNIT_RES);
+
+    if (mode == METER_MODE_PLATE)
+    {
+        // the plate current leaves B+ through the meter
+        reading.value = -m_x[NUM_SIM_NODES - 1] * 1e6;
+        reading.fullScale = fullScaleAmps * 1e6;
+    }
+
+    else
+    {
+        // small signal solution, the meter reads the rectified signal
+        //  current through the movement
+        stamp(true);
+        if (!m_system.solve(m_x)) { return SIM_NO_CONVERGENCE; }
+
+        movementAmps = RECTIFIED_AVERAGE * (nodeVolts(NODE_BPLUS) -
+            nodeVolts(NODE_MOVEMENT)) / METER_MOVEMENT_RES;
+        reading.value = m_gm * 1e6;
+        reading.fullScale = fullScaleAmps * 1e6 /
+            (RECTIFIED_AVERAGE * GM_SIGNAL_VOLTS);
+    }
+
+    reading.deflection = std::fabs(movementAmps) * 1e6 / METER_MOVEMENT_UA;
+    return SIM_OK;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: name of a status, i.e. "not modelled"
+const char* MeterSimulator::statusName(SimStatus status)
+{
+    return SIM_STATUS_NAMES[status];
+}
+
+//------------------------------------------------------------------------------
+
+// adds an element to the netlist
+void MeterSimulator::addElement(ElementKind kind,
+                                unsigned int node0,
+                                unsigned int node1,
+                                double value,
+                                double ac)
+{
+    CircuitElement element = CircuitElement();
+    element.kind = kind;
+    element.nodes[0] = node0;
+    element.nodes[1] = node1;
+    element.value = value;
+    element.ac = ac;
+    m_netlist.push_back(element);
+
+    if (kind == ELEMENT_SOURCE) { m_numSources++; }
+}
+
+//------------------------------------------------------------------------------
+
+// fits the tube law Ia = K * e^1.5, e = Vgk + Vck / mu, through the AVO
+//  operating point.  With a grid, gm = 1.5 * Ia / e fixes e and mu.  The
+//  control grid is the screen if fed from B+, else the anode.  Without a
+//  grid e is Vck, the 3/2 power law DataConverter scales the current by
+// returns: false if the current or the control grid volts are missing
+bool MeterSimulator::fitTube(const double* values, bool grid, bool screen)
+{
+    double iAnode = values[I_ANODE] * 1e-3;
+    double vControl = screen ? values[V_GRID2] : values[V_ANODE];
+    if (!(iAnode > 0 && vControl > 0)) { return false; }
+
+    double e = vControl;
+    m_mu = 1;
+    m_gridWeight = 0;
+
+    if (grid)
+    {
+        if (!(values[GM] > 0)) { return false; }
+
+        double vGrid = std::isnan(values[V_GRID1]) ? 0 :
+            -std::fabs(values[V_GRID1]);
+        e = 1.5 * iAnode / (values[GM] * 1e-3);
+        m_mu = vControl / (e - vGrid);
+        m_gridWeight = 1;
+    }
+
+    m_perveance = iAnode / std::pow(e, 1.5);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// stamps the netlist into m_system.  The tube is linearized at m_x for the
+//  DC solution, and replaced by its transconductances for the small signal
+//  solution, which takes the ac value of every source
+void MeterSimulator::stamp(bool ac)
+{
+    const size_t numNodes = NUM_SIM_NODES - 1;
+    m_system.reset(numNodes + m_numSources);
+
+    // rows and columns of the nodes, ground has none
+    auto conductance = [&](unsigned int out, unsigned int outRef,
+                           unsigned int in, unsigned int inRef, double g)
+    {
+        if (out != NODE_GROUND && in != NODE_GROUND)
+        {
+            m_system.add(out - 1, in - 1, g);
+        }
+        if (out != NODE_GROUND && inRef != NODE_GROUND)
+        {
+            m_system.add(out - 1, inRef - 1, -g);
+        }
+        if (outRef != NODE_GROUND && in != NODE_GROUND)
+        {
+            m_system.add(outRef - 1, in - 1, -g);
+        }
+        if (outRef != NODE_GROUND && inRef != NODE_GROUND)
+        {
+            m_system.add(outRef - 1, inRef - 1, g);
+        }
+    };
+
+    for (size_t n = 0; n < numNodes; n++) { m_system.add(n, n, SIM_GMIN); }
+
+    size_t source = numNodes;
+    for (auto it = m_netlist.begin(); it != m_netlist.end(); it++)
+    {
+        const unsigned int* nodes = it->nodes;
+
+        switch (it->kind)
+        {
+            case ELEMENT_RESISTOR:
+                conductance(nodes[0], nodes[1], nodes[0], nodes[1],
+                    1 / it->value);
+                break;
+
+            case ELEMENT_SOURCE:
+                if (nodes[0] != NODE_GROUND)
+                {
+                    m_system.add(nodes[0] - 1, source, 1);
+                    m_system.add(source, nodes[0] - 1, 1);
+                }
+                if (nodes[1] != NODE_GROUND)
+                {
+                    m_system.add(nodes[1] - 1, source, -1);
+                    m_system.add(source, nodes[1] - 1, -1);
+                }
+                m_system.addRhs(source, ac ? it->ac : it->value);
+                source++;
+                break;
+
+            case ELEMENT_TUBE:
+            {
+                double current = 0;
+                if (!ac)
+                {
+                    double vgk = nodeVolts(nodes[2]) - nodeVolts(nodes[1]);
+                    double vck = nodeVolts(nodes[3]) - nodeVolts(nodes[1]);
+                    double e = m_gridWeight * vgk + vck / m_mu;
+                    double slope = 0;
+
+                    if (e > 0)
+                    {
+                        slope = 1.5 * m_perveance * std::sqrt(e);
+                        current = m_perveance * e * std::sqrt(e);
+                    }
+
+                    m_gm = m_gridWeight * slope;
+                    m_gc = slope / m_mu;
+                    current -= m_gm * vgk + m_gc * vck;
+                }
+
+                // plate current from anode to cathode
+                conductance(nodes[0], nodes[1], nodes[2], nodes[1], m_gm);
+                conductance(nodes[0], nodes[1], nodes[3], nodes[1], m_gc);
+                if (nodes[0] != NODE_GROUND)
+                {
+                    m_system.addRhs(nodes[0] - 1, -current);
+                }
+                if (nodes[1] != NODE_GROUND)
+                {
+                    m_system.addRhs(nodes[1] - 1, current);
+                }
+                break;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// voltage of a node in m_x
+double MeterSimulator::nodeVolts(unsigned int node) const
+{
+    return node == NODE_GROUND ? 0 : m_x[node - 1];
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
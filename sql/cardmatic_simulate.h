@@ -0,0 +1,212 @@
+//    Cardmatic card generator - cardmatic_simulate.h file
+//    C++11 header file
+
+//    Meter simulator.  A card and the AVO test data of its tube are turned
+//      into a netlist of the regulated B+ supply, the bias divider with the
+//      decade resistor, the tube, and the meter with its multipliers and
+//      shunts, which is solved by modified nodal analysis.  The plate current
+//      test reads the DC solution, the gm test the rectified signal current
+//      of a small signal solution at the DC operating point, giving the
+//      meter deflection a tester would show for the card.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_SIMULATE_H
+#define CARDMATIC_SIMULATE_H
+
+#include "../cardmatic_tube.h"
+#include <vector>
+#include <cstddef>
+
+
+#define SIM_MAX_ITERATIONS 100      // Newton iterations of the DC solution
+#define SIM_TOLERANCE 1e-9          // Newton step to stop at, in volts
+#define SIM_SWITCH_RES 0.01         // closed switch, in ohms
+#define SIM_GMIN 1e-12              // leak of every node to ground, in mhos
+
+// deflections a sensibly scaled card reads, nominal is half scale
+#define SIM_DEFLECTION_MIN 0.25
+#define SIM_DEFLECTION_MAX 0.75
+
+
+
+//------------------------------------------------------------------------------
+//  enum and struct
+//------------------------------------------------------------------------------
+
+typedef enum SimStatus
+{
+    SIM_OK,
+    SIM_NOT_MODELLED,       // card does not meter from the regulated B+
+    SIM_NO_PARAMS,          // test data lack the current, anode or gm
+    SIM_INVALID_CARD,       // decade switches hold no resistor value
+    SIM_NO_CONVERGENCE,     // DC solution did not converge
+}SimStatus;
+
+
+typedef enum MeterMode
+{
+    METER_MODE_NONE,
+    METER_MODE_GM,          // gm bridge, umhometer
+    METER_MODE_PLATE,       // plate current from regulated B+, mA meter
+}MeterMode;
+
+
+// prediction of a card
+typedef struct MeterReading
+{
+    MeterMode mode;
+    double deflection;      // meter current / METER_MOVEMENT_UA
+    double fullScale;       // of the shunts, in umho or uA
+    double value;           // gm in umho or plate current in uA
+    double vAnode;          // DC operating point, in volts
+    double vGrid;
+}MeterReading;
+
+
+typedef enum ElementKind
+{
+    ELEMENT_RESISTOR,       // nodes 0 - 1, value in ohms
+    ELEMENT_SOURCE,         // + node 0, - node 1, value DC, ac rms volts
+    ELEMENT_TUBE,           // anode, cathode, grid, control grid nodes
+}ElementKind;
+
+
+typedef struct CircuitElement
+{
+    ElementKind kind;
+    unsigned int nodes[4];
+    double value;
+    double ac;
+}CircuitElement;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+// sparse linear system, one sorted row of nonzero entries per unknown,
+//  solved by Gaussian elimination with partial pivoting
+class SparseSystem
+{
+    public:
+        SparseSystem();
+
+        ~SparseSystem();
+
+
+        // helper to clear to a system of numUnknowns unknowns
+        void reset(size_t numUnknowns);
+
+        // helper to add value to an entry of the matrix
+        void add(size_t row, size_t column, double value);
+
+        // helper to add value to an entry of the right hand side
+        void addRhs(size_t row, double value) { m_rhs[row] += value; }
+
+
+        // function to solve the system, which is left eliminated
+        // param:   x - set to the solution
+        // returns: false if the matrix is singular
+        bool solve(std::vector<double> &x);
+
+
+
+    private:
+        typedef struct SparseEntry
+        {
+            size_t column;
+            double value;
+        }SparseEntry;
+
+        std::vector<std::vector<SparseEntry> > m_rows;
+        std::vector<double> m_rhs;
+};
+
+
+
+class MeterSimulator
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        MeterSimulator();
+
+        ~MeterSimulator();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to predict the meter reading of a card
+        // param:   card - closed switches
+        //          values - AVO test data of the tested section, Vh, Vg1,
+        //              Va, Vg2, Ia, gm, NaN if missing
+        //          reading - set to the prediction if successful
+        // returns: SIM_OK if successful, otherwise why there is no
+        //          prediction
+        SimStatus simulate(const SwitchMatrix &card,
+                           const double* values,
+                           MeterReading &reading);
+
+
+        // returns: name of a status, i.e. "not modelled"
+        static const char* statusName(SimStatus status);
+
+
+        // netlist of the last simulate()
+        const std::vector<CircuitElement> &getNetlist() const
+        {
+            return m_netlist;
+        }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        std::vector<CircuitElement> m_netlist;
+        size_t m_numSources;
+        SparseSystem m_system;
+        std::vector<double> m_x;            // node volts, then source amps
+
+        // tube, Ia = m_perveance * e^1.5 where
+        //  e = m_gridWeight * Vgk + Vck / m_mu
+        double m_perveance;
+        double m_mu;
+        double m_gridWeight;
+        double m_gm;                        // dIa/dVgk at the DC solution
+        double m_gc;                        // dIa/dVck at the DC solution
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // adds an element to the netlist
+        void addElement(ElementKind kind,
+                        unsigned int node0,
+                        unsigned int node1,
+                        double value,
+                        double ac = 0);
+
+        // fits the tube law through the AVO operating point
+        bool fitTube(const double* values, bool grid, bool screen);
+
+        // stamps the netlist into m_system, the tube linearized at m_x
+        void stamp(bool ac);
+
+        // voltage of a node in m_x
+        double nodeVolts(unsigned int node) const;
+};
+
+#endif // CARDMATIC_SIMULATE_H
@@ -28,7 +28,13 @@
 //------------------------------------------------------------------------------
 
 // default constructor
-Database::Database()  
+Database::Database() :
+    database(NULL),
+    statement(NULL),
+    return_code(SQLITE_OK),
+    tubeData_str(NULL),
+    tubeData_double(NULL),
+    num_rows_returned(0)
 {
 
 }
@@ -39,13 +45,27 @@ Database::Database()
 Database::~Database()
 {
 //    if (database != NULL) { dbClose(); }
+    freeRows();
+}
+
+//------------------------------------------------------------------------------
+
+// helper to free rows of a previous query
+void Database::freeRows()
+{
     if (tubeData_double != NULL) { delete[] tubeData_double; }
     if (tubeData_str != NULL) { delete[] tubeData_str; }
+    
+    tubeData_double = NULL;
+    tubeData_str = NULL;
+    num_rows_returned = 0;
 }
 
 //------------------------------------------------------------------------------
 
-// open database file in read-only mode
+// open database file in read-only mode.  A writable file has the current
+//  column added to its CARD_TABLE_PREFIX tables made before the column
+//  existed
 // param:   filename - name of database file in UTF-8
 //          flag - i.e. SQLITE_OPEN_READONLY, 
 //                    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE ...
@@ -63,6 +83,13 @@ bool Database::dbOpen(const char* fileName, int flag)
         return false;
     }
 
+    if ((flag & SQLITE_OPEN_READWRITE) && migrateCardTables() == false)
+    {
+        sqlite3_close(database);
+        database = NULL;
+        return false;
+    }
+
     std::cout << "Database opened successfully." << std::endl;
     return true;
 }
@@ -103,13 +130,16 @@ bool Database::selectPredefinedQuery(SQLops operation,
     switch (operation)
     {
         case CREATE_TABLE:
-            sql = "create table " + tableName + " (TubeID TEXT PRIMARY KEY,"
-                  " closedSW TEXT, test TEXT, testNum INTEGER PRIMARY KEY);";
+            sql = "create table if not exists " + tableName + 
+                  " (TubeID TEXT NOT NULL, closedSW TEXT, test TEXT,"
+                  " testNum INTEGER NOT NULL, current REAL,"
+                  " primary key (TubeID, testNum));";
             break;
         
-        case INSERT_INTO_TABLE:
-            sql = "insert into " + tableName + 
-                " (TubeID, closedSW) values($tubeID, $closedSW);";
+        case INSERT_INTO_TABLE:     // upsert on (TubeID, testNum)
+            sql = "insert or replace into " + tableName + 
+                " (TubeID, closedSW, test, testNum, current)"
+                " values($tubeID, $closedSW, $test, $testNum, $current);";
             break;
         
         case SELECT_TABLE:
@@ -124,6 +154,41 @@ bool Database::selectPredefinedQuery(SQLops operation,
             sql = "select count(*) as count from " + tableName + 
                 " where TubeID = $tubeID";
             break;
+            
+        case SELECT_ALL:
+            sql = "select * from " + tableName;
+            break;
+            
+        case COUNT_ALL:
+            sql = "select count(*) as count from " + tableName;
+            break;
+        
+        case SELECT_CARD_LIST:
+            sql = "select tubeID, numCards from " + tableName;
+            break;
+        
+        case SELECT_CARDS:
+            sql = "select TubeID, closedSW, test, testNum, current from " + 
+                tableName + " order by TubeID, testNum";
+            break;
+        
+        case SELECT_CARDS_NO_CURRENT:
+            sql = "select TubeID, closedSW, test, testNum, NULL from " + 
+                tableName + " order by TubeID, testNum";
+            break;
+        
+        case ADD_CURRENT:
+            sql = "alter table " + tableName + " add column current REAL;";
+            break;
+        
+        case TABLE_INFO:
+            sql = "pragma table_info(" + tableName + ");";
+            break;
+        
+        case CARD_TABLES:
+            sql = "select name from sqlite_master where type = 'table'"
+                " and name like '" + tableName + "%'";
+            break;
         
         default:
             return false;
@@ -216,11 +281,7 @@ void Database::dbQuery(const char* param[],
                        int paramSize,
                        std::string tableName)
 {
-    int i, num_columns, type_check;
-    unsigned int j = 0;
-    unsigned int k = 0;
-    
-    
+    freeRows();
     
     // get row count
     selectPredefinedQuery(COUNT, tableName);
@@ -247,9 +308,335 @@ void Database::dbQuery(const char* param[],
         return; 
     }  
     
+    fetchRows(true);
+}
+
+//------------------------------------------------------------------------------
+
+// execute static query returning every row of a table
+// i.e. dbQueryAll("avocardmatic") loads the whole AVO catalogue
+// post: rows of a previous query are freed, rows are not echoed
+void Database::dbQueryAll(std::string tableName)
+{
+    freeRows();
+    
+    // get row count
+    selectPredefinedQuery(COUNT_ALL, tableName);
+    if (prepareQuery() == false) { return; }
+    if (evaluateQuery() < 1)
+    { 
+        if (statement != NULL) { sqlite3_finalize(statement); }
+        return; 
+    }    
+    
+    num_rows_returned = sqlite3_column_int(statement, 0);
+    sqlite3_finalize(statement);     // finalize statement to deallocate
+    if (num_rows_returned  == 0 ) { return; }
+    
+    
+    
+    // if row count > 0
+    selectPredefinedQuery(SELECT_ALL, tableName);
+    if (prepareQuery() == false) { return; }
+    if (evaluateQuery() < 1)
+    { 
+        if (statement != NULL) { sqlite3_finalize(statement); }
+        return; 
+    }
+    
+    fetchRows(false);
+}
+
+//------------------------------------------------------------------------------
+
+// function to stream every row of a table without buffering them.  Memory use
+//  does not depend on the number of rows
+// param:   tableName - table in AVOcardmatic format
+//          callback - called with NUM_TEXT_COLS_PER_ROW strings and
+//              NUM_DOUBLE_COLS_PER_ROW doubles per row.  The arrays are reused
+//              for the next row
+// returns: number of rows passed to callback, or -1 on failure
+long Database::dbForEachRow(std::string tableName,
+                            const RowCallback &callback)
+{
+    std::string text[NUM_TEXT_COLS_PER_ROW];
+    double values[NUM_DOUBLE_COLS_PER_ROW];
+    long numRows = 0;
+    int evaluated;
+    
+    selectPredefinedQuery(SELECT_ALL, tableName);
+    if (prepareQuery() == false) { return -1; }
+    
+    while ((evaluated = evaluateQuery()) == 1)
+    {
+        readRow(statement, text, values, false);
+        numRows++;
+        
+        if (callback(text, values) == false) { break; }
+    }
+    
+    sqlite3_finalize(statement);
+    statement = NULL;
+    
+    return evaluated < 0 ? -1 : numRows;
+}
+
+//------------------------------------------------------------------------------
+
+// function to stream the rows of an official card list, i.e. ListWETubes,
+//  List118Cards or List123Cards.  numCards is converted to an integer, some
+//  lists store it as text
+// param:   tableName - table with tubeID and numCards columns
+//          callback - called once per row
+// returns: number of rows passed to callback, or -1 on failure
+long Database::dbForEachCardListRow(std::string tableName,
+                                    const CardListCallback &callback)
+{
+    long numRows = 0;
+    int evaluated;
+    
+    selectPredefinedQuery(SELECT_CARD_LIST, tableName);
+    if (prepareQuery() == false) { return -1; }
+    
+    while ((evaluated = evaluateQuery()) == 1)
+    {
+        const unsigned char* tubeID = sqlite3_column_text(statement, 0);
+        numRows++;
+        
+        if (callback(tubeID != NULL ? (const char*) tubeID : "", 
+                sqlite3_column_int(statement, 1)) == false) 
+        { 
+            break; 
+        }
+    }
+    
+    sqlite3_finalize(statement);
+    statement = NULL;
+    
+    return evaluated < 0 ? -1 : numRows;
+}
+
+//------------------------------------------------------------------------------
+
+// function to stream the cards stored by dbStoreCards().  Cards of a table
+//  without the current column have a NaN current
+// param:   tableName - table of generated cards
+//          callback - called once per card, in (TubeID, testNum) order
+// returns: number of cards passed to callback, or -1 on failure
+long Database::dbForEachCard(std::string tableName,
+                             const CardCallback &callback)
+{
+    GeneratedCard card;
+    long numCards = 0;
+    int evaluated;
+    int hasCurrent = hasCurrentColumn(tableName);
+    
+    if (hasCurrent < 0) { return -1; }
+    
+    selectPredefinedQuery(hasCurrent ? SELECT_CARDS : SELECT_CARDS_NO_CURRENT, 
+        tableName);
+    if (prepareQuery() == false) { return -1; }
+    
+    while ((evaluated = evaluateQuery()) == 1)
+    {
+        const unsigned char* text[3];
+        for (int column = 0; column < 3; column++)
+        {
+            text[column] = sqlite3_column_text(statement, column);
+        }
+        
+        card.tubeID = text[0] != NULL ? (const char*) text[0] : "";
+        card.closedSW = text[1] != NULL ? (const char*) text[1] : "";
+        card.test = text[2] != NULL ? (const char*) text[2] : "";
+        card.testNum = sqlite3_column_int(statement, 3);
+        card.current = sqlite3_column_type(statement, 4) == SQLITE_NULL ?
+            nan("null entry") : sqlite3_column_double(statement, 4);
+        numCards++;
+        
+        if (callback(card) == false) { break; }
+    }
+    
+    sqlite3_finalize(statement);
+    statement = NULL;
+    
+    return evaluated < 0 ? -1 : numCards;
+}
+
+//------------------------------------------------------------------------------
+
+// function to persist generated cards.  The first time a tube is stored
+//  through this Database, its old rows are deleted in the transaction
+//  inserting its cards, so the stored cards of a tube are replaced, while
+//  later calls add to the cards already replaced.  A single prepared
+//  statement is reused for all rows, and rows are written in transactions of
+//  batchSize rows
+// pre: database is opened SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+// param:   cards - cards to store
+//          tableName - table to store cards in, created if missing
+//          batchSize - rows per transaction, 0 = one transaction
+// returns: true if all cards are committed, false otherwise.  The failed
+//          batch is rolled back
+bool Database::dbStoreCards(const std::vector<GeneratedCard> &cards,
+                            std::string tableName,
+                            size_t batchSize)
+{
+    size_t i = 0;
+    
+    if (batchSize == 0) { batchSize = cards.size(); }
+    
+    
+    // create table
+    selectPredefinedQuery(CREATE_TABLE, tableName);
+    if (prepareQuery() == false) { return false; }
+    return_code = sqlite3_step(statement);
+    sqlite3_finalize(statement);
+    statement = NULL;
+    if (return_code != SQLITE_DONE)
+    {
+        std::cerr << "Failed to create table. " 
+            << sqlite3_errmsg(database) << std::endl;
+        return false;
+    }
+    
+    
+    // prepare delete and insert once, then bind and step them for every row
+    selectPredefinedQuery(DELETE_TABLE, tableName);
+    if (prepareQuery() == false) { return false; }
+    sqlite3_stmt* deleteTube = statement;
+    statement = NULL;
+    
+    selectPredefinedQuery(INSERT_INTO_TABLE, tableName);
+    if (prepareQuery() == false)
+    {
+        sqlite3_finalize(deleteTube);
+        return false;
+    }
+    
+    std::unordered_set<std::string> batchTubes; // replaced by open batch
+    
+    while (i < cards.size())
+    {
+        size_t batchEnd = i + batchSize < cards.size() ? 
+            i + batchSize : cards.size();
+        
+        if (executeStatement("begin immediate;") == false) { break; }
+        batchTubes.clear();
+        
+        for (; i < batchEnd; i++)
+        {
+            const GeneratedCard &card = cards[i];
+            std::string key = tableName + '/' + card.tubeID;
+            
+            // old rows of the tube go in the batch of its first card
+            if (replacedTubes.count(key) == 0 && 
+                batchTubes.insert(key).second)
+            {
+                sqlite3_bind_text(deleteTube, 1, card.tubeID.c_str(), 
+                    card.tubeID.length(), SQLITE_STATIC);
+                return_code = sqlite3_step(deleteTube);
+                sqlite3_reset(deleteTube);
+                
+                if (return_code != SQLITE_DONE)
+                {
+                    std::cerr << "Failed to delete cards of " << 
+                        card.tubeID << ". " << sqlite3_errmsg(database) << 
+                        std::endl;
+                    break;
+                }
+            }
+            
+            // SQLITE_STATIC, card outlives sqlite3_step below
+            sqlite3_bind_text(statement, 1, card.tubeID.c_str(), 
+                card.tubeID.length(), SQLITE_STATIC);
+            sqlite3_bind_text(statement, 2, card.closedSW.c_str(), 
+                card.closedSW.length(), SQLITE_STATIC);
+            sqlite3_bind_text(statement, 3, card.test.c_str(), 
+                card.test.length(), SQLITE_STATIC);
+            sqlite3_bind_int(statement, 4, card.testNum);
+            sqlite3_bind_double(statement, 5, card.current);
+            
+            return_code = sqlite3_step(statement);
+            sqlite3_reset(statement);
+            
+            if (return_code != SQLITE_DONE)
+            {
+                std::cerr << "Failed to insert card " << card.tubeID << ". "
+                    << sqlite3_errmsg(database) << std::endl;
+                break;
+            }
+        }
+        
+        if (i < batchEnd)   // batch failed
+        {
+            executeStatement("rollback;");
+            break;
+        }
+        
+        if (executeStatement("commit;") == false) { break; }
+        replacedTubes.insert(batchTubes.begin(), batchTubes.end());
+    }
+    
+    sqlite3_finalize(deleteTube);
+    sqlite3_finalize(statement);
+    statement = NULL;
+    
+    return i == cards.size();
+}
+
+//------------------------------------------------------------------------------
+
+// function to tune a writable database for bulk inserts: WAL journal,
+//  synchronous=NORMAL, in-memory temp store and a large page cache
+// pre: database is writable.  Do not call for the read-only cardmatic.sqlite,
+//      WAL mode is stored in the database file
+// returns: true if all pragmas succeed, false otherwise
+bool Database::dbSetWritePragmas()
+{
+    std::string cacheSize = "pragma cache_size = -" + 
+        std::to_string(STORE_CARDS_SQLITE_CACHE_KB) + ";";
+    
+    return executeStatement("pragma journal_mode = WAL;") &&
+           executeStatement("pragma synchronous = NORMAL;") &&
+           executeStatement("pragma temp_store = MEMORY;") &&
+           executeStatement(cacheSize.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+// function to execute a statement without parameters and results,
+//  i.e. "begin immediate", "commit"
+// returns: true if successful, false otherwise
+bool Database::executeStatement(const char* statementText)
+{
+    char* errorMessage = NULL;
+    
+    return_code = sqlite3_exec(database, statementText, NULL, NULL, 
+        &errorMessage);
+    if (return_code != SQLITE_OK)
+    {
+        std::cerr << "Failed to execute " << statementText << " " << 
+            (errorMessage != NULL ? errorMessage : "") << std::endl;
+        sqlite3_free(errorMessage);
+        return false;
+    }
+    
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to copy the rows of an evaluated query into tubeData_str
+//  and tubeData_double
+// pre: evaluateQuery() returned 1, num_rows_returned is set
+// param:   echo - print every column to stdout
+// post: statement is finalized
+void Database::fetchRows(bool echo)
+{
+    unsigned int k = 0;
+    
+    
     
     // process rows returned
-    num_columns = sqlite3_column_count(statement);
     tubeData_str = new std::string[num_rows_returned * NUM_TEXT_COLS_PER_ROW];
     if (!tubeData_str) { return; }
     
@@ -262,65 +649,146 @@ void Database::dbQuery(const char* param[],
     // Second condition check (k) is probably redundant and can be removed
     while (return_code == SQLITE_ROW && k < num_rows_returned)          
     {
-        // print entry
-        j = 0;
-        for (i = 0; i < num_columns; i++)
+        readRow(statement, &tubeData_str[k * NUM_TEXT_COLS_PER_ROW],
+            &tubeData_double[k * NUM_DOUBLE_COLS_PER_ROW], echo);
+        
+//        std::cout << "---end of entry---" << std::endl;
+        evaluateQuery();    // process next row
+        k++;
+    }
+
+    sqlite3_finalize(statement);     // finalize statement to deallocate
+    statement = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+// function to copy the current row of a statement stepped to SQLITE_ROW
+// pre: statement selects all columns of an AVOcardmatic formatted table
+// param:   statement - statement returning the row
+//          text - NUM_TEXT_COLS_PER_ROW strings, see VCM163Param_text
+//          values - NUM_DOUBLE_COLS_PER_ROW doubles, see VCM163Param_double
+//          echo - print every column to stdout
+void Database::readRow(sqlite3_stmt* statement,
+                       std::string* text,
+                       double* values,
+                       bool echo)
+{
+    int i, num_columns, type_check;
+    unsigned int j = 0;
+    
+    num_columns = sqlite3_column_count(statement);
+    for (i = 0; i < num_columns; i++)
+    {
+        type_check = sqlite3_column_type(statement, i);
+        // makes sure no out of bounce error in case table is appended
+        if (i >= 3 && i <= 8 && i - 3 < NUM_DOUBLE_COLS_PER_ROW)    
+        {
+            if (type_check == SQLITE_FLOAT || type_check == SQLITE_INTEGER)
+            {
+                values[i - 3] = sqlite3_column_double(statement, i);       
+            }
+            
+            else    // SQLITE_NULL, or text such as "4(5)" in Vh column
+            {
+                values[i - 3] = nan("null entry");                
+            }
+            
+            if (echo) { std::cout << values[i - 3] << std::endl; }
+        }
+        
+        else
         {
-            type_check = sqlite3_column_type(statement, i);
             // makes sure no out of bounce error in case table is appended
-            if (i >= 3 && i <= 8 && i - 3 < NUM_DOUBLE_COLS_PER_ROW)    
+            if (j < NUM_TEXT_COLS_PER_ROW)  
             {
-                if (type_check == SQLITE_FLOAT)
-                {
-                    tubeData_double[i - 3 + k * NUM_DOUBLE_COLS_PER_ROW] = 
-                        sqlite3_column_double(statement, i);       
-                }
-                
-                else if (type_check == SQLITE_NULL)
+                // the following two lines are not really needed
+                // as columns have to be non-null,
+                // but included to deal with type affinity in SQLite
+                if (type_check == SQLITE_NULL)
                 {
-                    tubeData_double[i - 3 + k * NUM_DOUBLE_COLS_PER_ROW] = 
-                        nan("null entry");                
+                    text[j] = "";
                 }
                 
-                std::cout << 
-                    tubeData_double[i - 3 + k * NUM_DOUBLE_COLS_PER_ROW] << 
-                    std::endl;
-            }
-            
-            else
-            {
-                // makes sure no out of bounce error in case table is appended
-                if (j < NUM_TEXT_COLS_PER_ROW)  
+                else if (type_check == SQLITE_TEXT)
                 {
-                    // the following two lines are not really needed
-                    // as columns have to be non-null,
-                    // but included to deal with type affinity in SQLite
-                    if (type_check == SQLITE_NULL)
-                    {
-                        tubeData_str[j + k * NUM_TEXT_COLS_PER_ROW] = "";
-                    }
+                    text[j] = reinterpret_cast<char*>(
+                        const_cast<unsigned char*>(
+                            sqlite3_column_text(statement, i) ) );
                     
-                    else if (type_check == SQLITE_TEXT)
-                    {
-                        tubeData_str[j + k * NUM_TEXT_COLS_PER_ROW] = 
-                            reinterpret_cast<char*>(const_cast<unsigned char*>(
-                                sqlite3_column_text(statement, i) ) );
-                        std::cout << 
-                            tubeData_str[j + k * NUM_TEXT_COLS_PER_ROW] << 
-                            std::endl;
-                    }
-                                              
-                    j++;
+                    if (echo) { std::cout << text[j] << std::endl; }
                 }
+                                          
+                j++;
             }
         }
-        
-//        std::cout << "---end of entry---" << std::endl;
-        evaluateQuery();    // process next row
-        k++;
     }
+}
 
-    sqlite3_finalize(statement);     // finalize statement to deallocate
+//------------------------------------------------------------------------------
+
+// helper to check a table for the current column of GeneratedCard
+// param:   tableName - table of generated cards
+// returns: 1 if the table has the column, 0 if not, or -1 if failed to
+//          evaluate query
+int Database::hasCurrentColumn(std::string tableName)
+{
+    int evaluated;
+    int found = 0;
+    
+    selectPredefinedQuery(TABLE_INFO, tableName);
+    if (prepareQuery() == false) { return -1; }
+    
+    // one row per column, name in column 1
+    while ((evaluated = evaluateQuery()) == 1)
+    {
+        const unsigned char* name = sqlite3_column_text(statement, 1);
+        if (name != NULL && strcmp((const char*) name, "current") == 0)
+        {
+            found = 1;
+        }
+    }
+    
+    sqlite3_finalize(statement);
+    statement = NULL;
+    
+    return evaluated < 0 ? -1 : found;
+}
+
+//------------------------------------------------------------------------------
+
+// helper to add the current column to the CARD_TABLE_PREFIX tables made
+//  before it existed
+// pre: database is writable
+// returns: true if every table has the column, false otherwise
+bool Database::migrateCardTables()
+{
+    std::vector<std::string> tableNames;
+    int evaluated;
+    
+    selectPredefinedQuery(CARD_TABLES, CARD_TABLE_PREFIX);
+    if (prepareQuery() == false) { return false; }
+    
+    while ((evaluated = evaluateQuery()) == 1)
+    {
+        tableNames.push_back((const char*) sqlite3_column_text(statement, 0));
+    }
+    
+    sqlite3_finalize(statement);
+    statement = NULL;
+    if (evaluated < 0) { return false; }
+    
+    for (auto &tableName : tableNames)
+    {
+        int hasCurrent = hasCurrentColumn(tableName);
+        if (hasCurrent < 0) { return false; }
+        if (hasCurrent == 1) { continue; }
+        
+        selectPredefinedQuery(ADD_CURRENT, tableName);
+        if (executeStatement(sql.c_str()) == false) { return false; }
+    }
+    
+    return true;
 }
 
 //------------------------------------------------------------------------------
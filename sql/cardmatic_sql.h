@@ -13,6 +13,9 @@
 
 #include <sqlite3.h>
 #include <string>
+#include <vector>
+#include <unordered_set>
+#include <functional>
 //#include "cardmatic_tube.h"
 //#include "cardmatic_globals.h"
 
@@ -23,6 +26,10 @@
 #define NUM_TEXT_COLS_PER_ROW 5
 #define NUM_DOUBLE_COLS_PER_ROW 6
 
+#define STORE_CARDS_SQLITE_CACHE_KB 16384   // page cache during bulk writes
+#define STORE_CARDS_BATCH_SIZE 1024         // cards per streamed transaction
+#define CARD_TABLE_PREFIX "generatedCards"  // tables made by dbStoreCards()
+
 //------------------------------------------------------------------------------
 //  enum
 //------------------------------------------------------------------------------
@@ -34,10 +41,37 @@ typedef enum sqlops
 	SELECT_TABLE,
 	DELETE_TABLE,
 	COUNT,
+	SELECT_ALL,
+	COUNT_ALL,
+	SELECT_CARD_LIST,
+	SELECT_CARDS,
+	SELECT_CARDS_NO_CURRENT,    // SELECT_CARDS, NULL for the current
+	ADD_CURRENT,        // current column of tables made before it existed
+	TABLE_INFO,         // columns of a table
+	CARD_TABLES,        // names of the tables starting with tableName
 }SQLops;
 
 
 
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+// a generated test card, one row of the table made by CREATE_TABLE
+typedef struct GeneratedCard
+{
+    std::string tubeID;
+    std::string closedSW;   // closed switches, i.e. "A7 A13 B6"
+    std::string test;       // test performed with the card
+    int testNum;            // card number of the tube, starting at 1
+    double current;         // plate current expected at the card's B+, in
+                            // mA, 0 if the test data list none, NaN if
+                            // unknown, i.e. NULL or the table has no
+                            // current column
+}GeneratedCard;
+
+
+
 //------------------------------------------------------------------------------
 //  Class
 //------------------------------------------------------------------------------
@@ -54,11 +88,19 @@ class Database
         ~Database();                            // destructor
 
 
+        // a Database owns its rows and its sqlite3 handle, share it between
+        // threads through a ConnectionPool instead of copying it
+        Database(const Database &) = delete;
+        Database &operator=(const Database &) = delete;
+
+
         //----------------------------------------------------------------------                                                          
         //  member functions
         //----------------------------------------------------------------------
        
-        // open database file in read-only mode
+        // open database file in read-only mode.  A writable file has the
+        //  current column added to its CARD_TABLE_PREFIX tables made
+        //  before the column existed
         // param:   filename - name of database file in UTF-8
         //          flag - i.e. SQLITE_OPEN_READONLY, 
         //                    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE ...
@@ -79,6 +121,97 @@ class Database
         void dbQuery(const char* param[], 
                      int paramSize,
                      std::string tableName);
+
+
+        // execute static query returning every row of a table
+        // i.e. dbQueryAll("avocardmatic") loads the whole AVO catalogue
+        // post: rows of a previous query are freed, rows are not echoed
+        void dbQueryAll(std::string tableName);
+
+
+        // callback receiving one row, returns false to stop
+        typedef std::function<bool(const std::string* text, 
+                                   const double* values)> RowCallback;
+
+
+        // function to stream every row of a table without buffering them.
+        //  Memory use does not depend on the number of rows
+        // param:   tableName - table in AVOcardmatic format
+        //          callback - called with NUM_TEXT_COLS_PER_ROW strings and
+        //              NUM_DOUBLE_COLS_PER_ROW doubles per row.  The arrays
+        //              are reused for the next row
+        // returns: number of rows passed to callback, or -1 on failure
+        long dbForEachRow(std::string tableName,
+                          const RowCallback &callback);
+
+
+        // callback receiving one card list row, returns false to stop
+        typedef std::function<bool(const std::string &tubeID,
+                                   int numCards)> CardListCallback;
+
+
+        // function to stream the rows of an official card list, i.e.
+        //  ListWETubes, List118Cards or List123Cards
+        // param:   tableName - table with tubeID and numCards columns
+        //          callback - called once per row
+        // returns: number of rows passed to callback, or -1 on failure
+        long dbForEachCardListRow(std::string tableName,
+                                  const CardListCallback &callback);
+
+
+        // callback receiving one stored card, returns false to stop
+        typedef std::function<bool(const GeneratedCard &card)> CardCallback;
+
+
+        // function to stream the cards stored by dbStoreCards().  Cards
+        //  of a table without the current column have a NaN current
+        // param:   tableName - table of generated cards
+        //          callback - called once per card, in (TubeID, testNum)
+        //              order
+        // returns: number of cards passed to callback, or -1 on failure
+        long dbForEachCard(std::string tableName,
+                           const CardCallback &callback);
+
+
+        // function to persist generated cards.  The first time a tube is
+        //  stored through this Database, its old rows are deleted in the
+        //  transaction inserting its cards, so the stored cards of a tube
+        //  are replaced, while later calls add to the cards already
+        //  replaced.  A single prepared statement is reused for all rows,
+        //  and rows are written in transactions of batchSize rows
+        // pre: database is opened SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+        // param:   cards - cards to store
+        //          tableName - table to store cards in, created if missing
+        //          batchSize - rows per transaction, 0 = one transaction
+        // returns: true if all cards are committed, false otherwise.  The
+        //          failed batch is rolled back
+        bool dbStoreCards(const std::vector<GeneratedCard> &cards,
+                          std::string tableName,
+                          size_t batchSize = 0);
+
+
+        // function to tune a writable database for bulk inserts: WAL
+        //  journal, synchronous=NORMAL, in-memory temp store and a large
+        //  page cache
+        // pre: database is writable.  Do not call for the read-only
+        //      cardmatic.sqlite, WAL mode is stored in the database file
+        // returns: true if all pragmas succeed, false otherwise
+        bool dbSetWritePragmas();
+
+
+        // function to copy the current row of a statement stepped to 
+        //  SQLITE_ROW
+        // pre: statement selects all columns of an AVOcardmatic formatted 
+        //      table
+        // param:   statement - statement returning the row
+        //          text - NUM_TEXT_COLS_PER_ROW strings, see VCM163Param_text
+        //          values - NUM_DOUBLE_COLS_PER_ROW doubles, see 
+        //              VCM163Param_double
+        //          echo - print every column to stdout
+        static void readRow(sqlite3_stmt* statement,
+                            std::string* text,
+                            double* values,
+                            bool echo);
         
         
         
@@ -89,7 +222,7 @@ class Database
         double getTubeData_doubleAttribute(unsigned int row, 
                                            unsigned int column) const
         { 
-            return tubeData_double[column + NUM_TEXT_COLS_PER_ROW * row];
+            return tubeData_double[column + NUM_DOUBLE_COLS_PER_ROW * row];
         }
         
         
@@ -121,6 +254,7 @@ class Database
         std::string* tubeData_str;
         double* tubeData_double;
         unsigned int num_rows_returned;
+        std::unordered_set<std::string> replacedTubes;  // by dbStoreCards()
         
         
         
@@ -162,6 +296,38 @@ class Database
         // returns: 0 if no rows returned, 1 if at least one row returned, or 
         //          -1 if failed to evaluate query
         int evaluateQuery();
+
+
+        // function to execute a statement without parameters and results,
+        //  i.e. "begin immediate", "commit"
+        // returns: true if successful, false otherwise
+        bool executeStatement(const char* statementText);
+
+
+        // function to copy the rows of an evaluated query into tubeData_str
+        //  and tubeData_double
+        // pre: evaluateQuery() returned 1, num_rows_returned is set
+        // param:   echo - print every column to stdout
+        // post: statement is finalized
+        void fetchRows(bool echo);
+
+
+        // helper to free rows of a previous query
+        void freeRows();
+
+
+        // helper to check a table for the current column of GeneratedCard
+        // param:   tableName - table of generated cards
+        // returns: 1 if the table has the column, 0 if not, or -1 if
+        //          failed to evaluate query
+        int hasCurrentColumn(std::string tableName);
+
+
+        // helper to add the current column to the CARD_TABLE_PREFIX tables
+        //  made before it existed
+        // pre: database is writable
+        // returns: true if every table has the column, false otherwise
+        bool migrateCardTables();
 };        
 
 
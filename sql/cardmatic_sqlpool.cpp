@@ -0,0 +1,267 @@
+//    Cardmatic card generator - cardmatic_sqlpool.cpp file
+//    C++11 implementation file
+
+//    Pool of read-only SQLite connections to "cardmatic.sqlite" for
+//      concurrent readers.  A thread leases a connection, uses its cached
+//      prepared statements without locking, and returns it when the lease
+//      goes out of scope.
+
+//    Written by: cathug
+
+
+#include <iostream>
+#include <algorithm>
+#include "cardmatic_sqlpool.h"
+#include "cardmatic_sql.h"
+
+
+
+// connection last leased by the calling thread.  Handing it out again keeps
+// the statement cache of a thread warm
+static thread_local const void* t_lastPool = NULL;
+static thread_local const void* t_lastConnection = NULL;
+
+
+
+//------------------------------------------------------------------------------
+// Lease implementation
+//------------------------------------------------------------------------------
+
+// constructor, only called by ConnectionPool::acquire()
+ConnectionPool::Lease::Lease(ConnectionPool* pool,
+                             Connection* connection) :
+    m_pool(pool),
+    m_connection(connection)
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// move constructor
+ConnectionPool::Lease::Lease(Lease &&other) :
+    m_pool(other.m_pool),
+    m_connection(other.m_connection)
+{
+    other.m_pool = NULL;
+    other.m_connection = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+// destructor, returns the connection to the pool
+ConnectionPool::Lease::~Lease()
+{
+    if (m_pool != NULL) { m_pool->release(m_connection); }
+}
+
+//------------------------------------------------------------------------------
+
+// function to get a prepared statement from the cache of this connection,
+//  preparing it on first use
+// param: sql - sql query, may contain placeholders
+// returns: statement ready for binding, or NULL on failure
+sqlite3_stmt* ConnectionPool::Lease::statement(const std::string &sql)
+{
+    auto cached = m_connection->statements.find(sql);
+    if (cached != m_connection->statements.end())
+    {
+        sqlite3_reset(cached->second);
+        sqlite3_clear_bindings(cached->second);
+        return cached->second;
+    }
+
+    sqlite3_stmt* prepared = NULL;
+    if (sqlite3_prepare_v2(m_connection->database, sql.c_str(), sql.length(),
+            &prepared, NULL) != SQLITE_OK)
+    {
+        std::cerr << "Failed to prepare query. "
+            << sqlite3_errmsg(m_connection->database) << std::endl;
+        return NULL;
+    }
+
+    m_connection->statements.insert(std::make_pair(sql, prepared));
+    return prepared;
+}
+
+//------------------------------------------------------------------------------
+
+// function to query all rows of a tube
+// pre: table is in AVOcardmatic format
+// param:   tableName - i.e. "avocardmatic"
+//          tubeID - tube nomenclature
+//          text - NUM_TEXT_COLS_PER_ROW strings per row
+//          values - NUM_DOUBLE_COLS_PER_ROW doubles per row
+// returns: number of rows returned, or -1 on failure
+int ConnectionPool::Lease::queryTube(const std::string &tableName,
+                                     const std::string &tubeID,
+                                     std::vector<std::string> &text,
+                                     std::vector<double> &values)
+{
+    int numRows = 0;
+    int return_code;
+
+    sqlite3_stmt* query = statement("select * from " + tableName +
+        " where TubeID = $tubeID");
+    if (query == NULL) { return -1; }
+
+    // SQLITE_TRANSIENT, tubeID may not outlive the statement
+    if (sqlite3_bind_text(query, 1, tubeID.c_str(), tubeID.length(),
+            SQLITE_TRANSIENT) != SQLITE_OK)
+    {
+        return -1;
+    }
+
+    text.clear();
+    values.clear();
+
+    while ((return_code = sqlite3_step(query)) == SQLITE_ROW)
+    {
+        text.resize(text.size() + NUM_TEXT_COLS_PER_ROW);
+        values.resize(values.size() + NUM_DOUBLE_COLS_PER_ROW);
+
+        Database::readRow(query,
+            &text[numRows * NUM_TEXT_COLS_PER_ROW],
+            &values[numRows * NUM_DOUBLE_COLS_PER_ROW], false);
+        numRows++;
+    }
+
+    sqlite3_reset(query);   // release read lock
+
+    if (return_code != SQLITE_DONE)
+    {
+        std::cerr << "Failed to evaluate query. "
+            << sqlite3_errmsg(m_connection->database) << std::endl;
+        return -1;
+    }
+
+    return numRows;
+}
+
+//------------------------------------------------------------------------------
+
+
+
+//------------------------------------------------------------------------------
+// ConnectionPool implementation
+//------------------------------------------------------------------------------
+
+// default constructor
+ConnectionPool::ConnectionPool()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor, closes all connections
+ConnectionPool::~ConnectionPool()
+{
+    close();
+}
+
+//------------------------------------------------------------------------------
+
+// function to open read-only connections.  Each connection is opened with
+//  SQLITE_OPEN_NOMUTEX, as a lease is used by one thread only
+// pre: SQLite library is thread safe, pool is not open
+// param:   fileName - name of database file in UTF-8
+//          numConnections - number of connections, at least 1
+// returns: true if all connections open, false otherwise
+bool ConnectionPool::open(const char* fileName,
+                          unsigned int numConnections)
+{
+    if (sqlite3_threadsafe() == 0)
+    {
+        std::cerr << "SQLite library is not thread safe." << std::endl;
+        return false;
+    }
+
+    if (numConnections == 0) { numConnections = 1; }
+
+    for (unsigned int i = 0; i < numConnections; i++)
+    {
+        Connection* connection = new Connection();
+
+        if (sqlite3_open_v2(fileName, &connection->database,
+                SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+        {
+            std::cerr << "Failed to open database: " <<
+                sqlite3_errmsg(connection->database) << std::endl;
+            sqlite3_close(connection->database);
+            delete connection;
+            close();
+            return false;
+        }
+
+        m_connections.push_back(connection);
+    }
+
+    m_idle = m_connections;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// function to finalize cached statements and close all connections
+// pre: no leases are outstanding
+void ConnectionPool::close()
+{
+    for (auto it = m_connections.begin(); it != m_connections.end(); it++)
+    {
+        for (auto st = (*it)->statements.begin();
+            st != (*it)->statements.end(); st++)
+        {
+            sqlite3_finalize(st->second);
+        }
+
+        sqlite3_close((*it)->database);
+        delete *it;
+    }
+
+    m_connections.clear();
+    m_idle.clear();
+}
+
+//------------------------------------------------------------------------------
+
+// function to lease a connection, waits until one is free.  The connection
+//  last leased by the calling thread is preferred
+// pre: pool is open
+ConnectionPool::Lease ConnectionPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_released.wait(lock, [this]() { return !m_idle.empty(); });
+
+    auto it = m_idle.end() - 1;
+    if (t_lastPool == this)
+    {
+        auto last = std::find(m_idle.begin(), m_idle.end(), t_lastConnection);
+        if (last != m_idle.end()) { it = last; }
+    }
+
+    Connection* connection = *it;
+    m_idle.erase(it);
+
+    t_lastPool = this;
+    t_lastConnection = connection;
+
+    return Lease(this, connection);
+}
+
+//------------------------------------------------------------------------------
+
+// helper to return a connection to the pool
+void ConnectionPool::release(Connection* connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(connection);
+    }
+
+    m_released.notify_one();
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
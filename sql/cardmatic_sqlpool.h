@@ -0,0 +1,157 @@
+//    Cardmatic card generator - cardmatic_sqlpool.h file
+//    C++11 header file
+
+//    Pool of read-only SQLite connections to "cardmatic.sqlite" for
+//      concurrent readers.  A thread leases a connection, uses its cached
+//      prepared statements without locking, and returns it when the lease
+//      goes out of scope.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_SQLPOOL_H
+#define CARDMATIC_SQLPOOL_H
+
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+
+
+#define SQLPOOL_DEFAULT_SIZE 4      // default number of connections
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class ConnectionPool
+{
+    private:
+        // a connection and the statements prepared on it
+        typedef struct Connection
+        {
+            sqlite3* database;
+            std::unordered_map<std::string, sqlite3_stmt*> statements;
+        }Connection;
+
+
+    public:
+        //----------------------------------------------------------------------
+        //  lease
+        //----------------------------------------------------------------------
+
+        // exclusive use of one connection, returned to the pool on
+        // destruction.  Leases can be moved but not copied
+        class Lease
+        {
+            public:
+                Lease(Lease &&other);
+                ~Lease();
+
+                Lease(const Lease &) = delete;
+                Lease &operator=(const Lease &) = delete;
+
+
+                // function to get a prepared statement from the cache of
+                //  this connection, preparing it on first use
+                // param: sql - sql query, may contain placeholders
+                // returns: statement ready for binding, or NULL on failure
+                sqlite3_stmt* statement(const std::string &sql);
+
+
+                // function to query all rows of a tube
+                // pre: table is in AVOcardmatic format
+                // param:   tableName - i.e. "avocardmatic"
+                //          tubeID - tube nomenclature
+                //          text - NUM_TEXT_COLS_PER_ROW strings per row
+                //          values - NUM_DOUBLE_COLS_PER_ROW doubles per row
+                // returns: number of rows returned, or -1 on failure
+                int queryTube(const std::string &tableName,
+                              const std::string &tubeID,
+                              std::vector<std::string> &text,
+                              std::vector<double> &values);
+
+
+                sqlite3* handle() const { return m_connection->database; }
+
+
+            private:
+                friend class ConnectionPool;
+
+                Lease(ConnectionPool* pool,
+                      Connection* connection);
+
+                ConnectionPool* m_pool;
+                Connection* m_connection;
+        };
+
+
+
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        ConnectionPool();   // default constructor
+
+        ~ConnectionPool();  // destructor, closes all connections
+
+        ConnectionPool(const ConnectionPool &) = delete;
+        ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to open read-only connections.  Each connection is opened
+        //  with SQLITE_OPEN_NOMUTEX, as a lease is used by one thread only
+        // pre: SQLite library is thread safe, pool is not open
+        // param:   fileName - name of database file in UTF-8
+        //          numConnections - number of connections, at least 1
+        // returns: true if all connections open, false otherwise
+        bool open(const char* fileName,
+                  unsigned int numConnections = SQLPOOL_DEFAULT_SIZE);
+
+
+        // function to finalize cached statements and close all connections
+        // pre: no leases are outstanding
+        void close();
+
+
+        // function to lease a connection, waits until one is free.  The
+        //  connection last leased by the calling thread is preferred
+        // pre: pool is open
+        Lease acquire();
+
+
+        unsigned int getNumConnections() const { return m_connections.size(); }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        std::vector<Connection*> m_connections;     // all connections
+        std::vector<Connection*> m_idle;            // connections not leased
+
+        std::mutex m_mutex;                         // guards m_idle
+        std::condition_variable m_released;
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // helper to return a connection to the pool
+        void release(Connection* connection);
+};
+
+#endif // CARDMATIC_SQLPOOL_H
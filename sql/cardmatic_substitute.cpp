@@ -0,0 +1,244 @@
+//    Cardmatic card generator - cardmatic_substitute.cpp file
+//    C++11 implementation file
+
+//    Substitute tube finder.  Ranks catalogue tubes by base, pinout and
+//      normalized electrical parameters to answer "what card can I test this
+//      tube with" queries.
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include "cardmatic_substitute.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+
+// relative importance of the parameters, the heater voltage has to match
+static const double PARAMETER_WEIGHTS[NUM_DOUBLE_COLS_PER_ROW] = {
+    4.0,    // HEATER
+    1.0,    // V_GRID1
+    1.0,    // V_ANODE
+    1.0,    // V_GRID2
+    1.0,    // I_ANODE
+    1.0,    // GM
+};
+
+// added to the distance of tubes with another pinout or base.  Larger than
+// any weighted parameter distance
+#define PINOUT_MISMATCH_PENALTY 2e6
+#define BASE_MISMATCH_PENALTY 1e6
+
+#define MISSING_PARAMETER -1.0
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// helper to compress parameters spanning several decades
+static double signedLog(double value)
+{
+    return value < 0 ? -log1p(-value) : log1p(value);
+}
+
+//------------------------------------------------------------------------------
+
+// constructor
+// pre: catalogue is loaded and outlives the finder
+// post: parameters of every tube are normalized
+SubstituteFinder::SubstituteFinder(const TubeCatalogue &catalogue) :
+    m_catalogue(catalogue),
+    m_paddedSize((catalogue.size() + SUBSTITUTE_LANES - 1) /
+        SUBSTITUTE_LANES * SUBSTITUTE_LANES)
+{
+    for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+    {
+        const double* column = m_catalogue.getColumn(
+            static_cast<VCM163Param_double>(c));
+        double lowest = HUGE_VAL;
+        double highest = -HUGE_VAL;
+
+        for (size_t row = 0; row < m_catalogue.size(); row++)
+        {
+            if (std::isnan(column[row])) { continue; }
+            lowest = std::min(lowest, signedLog(column[row]));
+            highest = std::max(highest, signedLog(column[row]));
+        }
+
+        double range = highest > lowest ? highest - lowest : 1.0;
+
+        m_normalized[c].assign(m_paddedSize, MISSING_PARAMETER);
+        for (size_t row = 0; row < m_catalogue.size(); row++)
+        {
+            if (std::isnan(column[row])) { continue; }
+            m_normalized[c][row] = (signedLog(column[row]) - lowest) / range;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+SubstituteFinder::~SubstituteFinder()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to find the nearest tubes to a tube.  Tubes with the same pinout
+//  and base rank first, then tubes with the same pinout, then the same base;
+//  ties are broken by parameter distance.  Every row of the tube is compared
+//  with every row of the candidates, a candidate ranks by its nearest pair
+// param:   tubeID - tube to replace
+//          maxResults - maximum number of substitutes returned
+// returns: substitutes, one per tube, nearest first.  Empty if tube is not
+//          listed
+std::vector<SubstituteMatch> SubstituteFinder::findSubstitutes(
+    const std::string &tubeID,
+    unsigned int maxResults) const
+{
+    std::vector<SubstituteMatch> matches;
+
+    std::vector<unsigned int> queryRows;
+    for (size_t row = 0; row < m_catalogue.size(); row++)
+    {
+        if (m_catalogue.getText(row, TUBE_ID) == tubeID)
+        {
+            queryRows.push_back(row);
+        }
+    }
+
+    if (queryRows.empty()) { return matches; }
+
+
+    // rank pinout and base ahead of the parameters, against the nearest
+    //  section of the tube
+    const unsigned int* baseCodes = m_catalogue.getBaseCodes();
+    const unsigned int* pinoutCodes = m_catalogue.getPinoutCodes();
+    std::vector<double> scores(m_paddedSize, HUGE_VAL);
+    std::vector<double> sectionScores(m_paddedSize);
+
+    for (auto it = queryRows.begin(); it != queryRows.end(); it++)
+    {
+        double query[NUM_DOUBLE_COLS_PER_ROW];
+        for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+        {
+            query[c] = m_normalized[c][*it];
+        }
+
+        distanceKernel(query, sectionScores.data());
+
+        for (size_t row = 0; row < m_catalogue.size(); row++)
+        {
+            double score = sectionScores[row] +
+                (baseCodes[row] != baseCodes[*it]) * BASE_MISMATCH_PENALTY +
+                (pinoutCodes[row] != pinoutCodes[*it]) *
+                PINOUT_MISMATCH_PENALTY;
+            scores[row] = std::min(scores[row], score);
+        }
+    }
+
+
+    // the nearest row of each tube stands for it, a tube is not a
+    //  substitute for itself
+    std::unordered_map<std::string, unsigned int> nearestRows;
+    for (size_t row = 0; row < m_catalogue.size(); row++)
+    {
+        const std::string &candidateID = m_catalogue.getText(row, TUBE_ID);
+        if (candidateID == tubeID) { continue; }
+
+        auto found = nearestRows.insert(std::make_pair(candidateID, row));
+        if (scores[row] < scores[found.first->second])
+        {
+            found.first->second = row;
+        }
+    }
+
+    std::vector<unsigned int> candidates;
+    for (auto it = nearestRows.begin(); it != nearestRows.end(); it++)
+    {
+        candidates.push_back(it->second);
+    }
+
+    // rows break ties so the order does not depend on the hash map
+    size_t numResults = std::min<size_t>(maxResults, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + numResults,
+        candidates.end(),
+        [&scores](unsigned int a, unsigned int b)
+        {
+            return scores[a] != scores[b] ? scores[a] < scores[b] : a < b;
+        });
+
+
+    for (size_t i = 0; i < numResults; i++)
+    {
+        unsigned int row = candidates[i];
+        SubstituteMatch match;
+
+        match.tubeID = m_catalogue.getText(row, TUBE_ID);
+        match.samePinout = scores[row] < PINOUT_MISMATCH_PENALTY;
+        match.sameBase = fmod(scores[row], PINOUT_MISMATCH_PENALTY) <
+            BASE_MISMATCH_PENALTY;
+        match.distance = sqrt(fmod(scores[row], BASE_MISMATCH_PENALTY));
+        matches.push_back(match);
+    }
+
+    return matches;
+}
+
+//------------------------------------------------------------------------------
+
+// computes the weighted squared distance of every row to the query
+// param:   query - normalized parameters of the queried tube
+//          distances - m_paddedSize results
+void SubstituteFinder::distanceKernel(const double* query,
+                                      double* distances) const
+{
+    size_t row = 0;
+
+    #if defined(__AVX2__)
+    // four rows per iteration, columns are padded to a multiple of four
+    for (; row + SUBSTITUTE_LANES <= m_paddedSize; row += SUBSTITUTE_LANES)
+    {
+        __m256d sum = _mm256_setzero_pd();
+
+        for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+        {
+            __m256d diff = _mm256_sub_pd(
+                _mm256_loadu_pd(&m_normalized[c][row]),
+                _mm256_set1_pd(query[c]));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(
+                _mm256_set1_pd(PARAMETER_WEIGHTS[c]),
+                _mm256_mul_pd(diff, diff)));
+        }
+
+        _mm256_storeu_pd(&distances[row], sum);
+    }
+    #endif
+
+    // scalar fallback
+    for (; row < m_paddedSize; row++)
+    {
+        double sum = 0.0;
+
+        for (unsigned int c = 0; c < NUM_DOUBLE_COLS_PER_ROW; c++)
+        {
+            double diff = m_normalized[c][row] - query[c];
+            sum += PARAMETER_WEIGHTS[c] * (diff * diff);
+        }
+
+        distances[row] = sum;
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
@@ -0,0 +1,101 @@
+//    Cardmatic card generator - cardmatic_substitute.h file
+//    C++11 header file
+
+//    Substitute tube finder.  Ranks catalogue tubes by base, pinout and
+//      normalized electrical parameters to answer "what card can I test this
+//      tube with" queries.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_SUBSTITUTE_H
+#define CARDMATIC_SUBSTITUTE_H
+
+#include "cardmatic_catalogue.h"
+#include <string>
+#include <vector>
+
+
+#define SUBSTITUTE_MAX_RESULTS 10       // default number of substitutes
+#define SUBSTITUTE_LANES 4              // doubles per AVX2 register
+
+
+
+//------------------------------------------------------------------------------
+//  struct
+//------------------------------------------------------------------------------
+
+typedef struct SubstituteMatch
+{
+    std::string tubeID;
+    bool sameBase;
+    bool samePinout;    // same AVO switch settings and top caps
+    double distance;    // weighted distance of normalized parameters
+}SubstituteMatch;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class SubstituteFinder
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // pre: catalogue is loaded and outlives the finder
+        // post: parameters of every tube are normalized
+        explicit SubstituteFinder(const TubeCatalogue &catalogue);
+
+        ~SubstituteFinder();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to find the nearest tubes to a tube.  Tubes with the same
+        //  pinout and base rank first, then tubes with the same pinout, then
+        //  the same base; ties are broken by parameter distance.  All
+        //  sections of both tubes are compared, see cardmatic_substitute.cpp
+        // param:   tubeID - tube to replace
+        //          maxResults - maximum number of substitutes returned
+        // returns: substitutes, one per tube, nearest first.  Empty if tube
+        //          is not listed
+        std::vector<SubstituteMatch> findSubstitutes(
+            const std::string &tubeID,
+            unsigned int maxResults = SUBSTITUTE_MAX_RESULTS) const;
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        const TubeCatalogue &m_catalogue;
+
+        size_t m_paddedSize;    // rows rounded up to SUBSTITUTE_LANES
+
+        // signed log scaled parameters mapped to 0...1, missing values are
+        // placed at -1.  Columns are padded to m_paddedSize
+        std::vector<double> m_normalized[NUM_DOUBLE_COLS_PER_ROW];
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // computes the weighted squared distance of every row to the query
+        // param:   query - normalized parameters of the queried tube
+        //          distances - m_paddedSize results
+        void distanceKernel(const double* query,
+                            double* distances) const;
+};
+
+#endif // CARDMATIC_SUBSTITUTE_H
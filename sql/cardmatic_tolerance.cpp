@@ -0,0 +1,396 @@
+//    Cardmatic card generator - cardmatic_tolerance.cpp file
+//    C++11 implementation file
+
+//    Monte Carlo tolerance analysis of generated cards.  The heater, bias,
+//      anode, plate current and gm of every catalogue row are perturbed
+//      within datasheet tolerances and the card is converted again the way
+//      the card pipeline does.  Quantization makes cards follow their data
+//      in steps, which is jitter; a trial is fragile when the tube becomes
+//      testable or untestable, or when the B+ step is lowered for the
+//      plate current rating a different number of times, so rows whose
+//      card depends on where the data fall against a limit are found.
+//      Random numbers are drawn four lanes at a time with AVX2 when
+//      compiled with -mavx2, with a scalar fallback giving identical results.
+
+//    Written by: cathug
+
+
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include "cardmatic_tolerance.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+#define RANDOM_LANES 4
+#define RANDOM_GOLDEN 0x9E3779B97F4A7C15ULL
+#define RANDOM_ONE 0x3FF0000000000000ULL    // bits of 1.0
+
+
+// xorshift128+ state of four independent lanes.  Each row seeds its own
+//  lanes, so a row draws the same numbers on any thread
+typedef struct RandomLanes
+{
+    uint64_t s0[RANDOM_LANES];
+    uint64_t s1[RANDOM_LANES];
+}RandomLanes;
+
+
+// test data column of each perturbed parameter
+static const VCM163Param_double TOL_COLUMNS[TOL_NUM_PARAMS] = {
+    HEATER, V_GRID1, V_ANODE, I_ANODE, GM,
+};
+
+// names of the counted changes in the printed table
+static const char* CHANGE_NAMES[CHANGE_FRAGILE] = {
+    "status", "rating", "card",
+};
+
+
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// splitmix64, spreads a counter to a well mixed seed
+static uint64_t splitMix64(uint64_t &x)
+{
+    uint64_t z = (x += RANDOM_GOLDEN);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+//------------------------------------------------------------------------------
+
+// steps B+ was lowered from the nearest step of the anode volts for the
+//  current rating, see CatalogueQuantizer::quantizeRow()
+// param:   vAnode - anode volts, NaN if missing
+//          bPlus - B+ of the card, 0 if the anode volts are missing
+static unsigned int ratingSteps(double vAnode, unsigned int bPlus)
+{
+    if (bPlus == 0) { return 0; }
+
+    long nearest = std::min<long>(std::max<long>(
+        lround(vAnode / V_REGBPLUS_INC) * V_REGBPLUS_INC, V_REGBPLUS_MIN),
+        V_REGBPLUS_MAX);
+
+    return (nearest - bPlus) / V_REGBPLUS_INC;
+}
+
+//------------------------------------------------------------------------------
+
+// seeds the lanes of a row.  Each row takes its own 8 splitmix64 counters
+static void seedLanes(RandomLanes &rng, uint64_t seed, uint64_t row)
+{
+    uint64_t x = seed + row * 2 * RANDOM_LANES * RANDOM_GOLDEN;
+
+    for (unsigned int lane = 0; lane < RANDOM_LANES; lane++)
+    {
+        rng.s0[lane] = splitMix64(x);
+        rng.s1[lane] = splitMix64(x);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// fills out with numValues values drawn uniformly within
+//  value * (1 +- tolerance), a value per lane and step.  Both paths take the
+//  top 52 bits of a draw as the mantissa of [1, 2) and do the same double
+//  operations, so they agree bit for bit.  A NaN value stays NaN
+// pre: numValues is a multiple of RANDOM_LANES
+static void perturb(RandomLanes &rng,
+                    double value,
+                    double tolerance,
+                    double* out,
+                    size_t numValues)
+{
+    const double spread = value * tolerance;
+    size_t i = 0;
+
+    #if defined(__AVX2__)
+    const __m256i one = _mm256_set1_epi64x(RANDOM_ONE);
+    const __m256d oneD = _mm256_set1_pd(1.0);
+    const __m256d twoD = _mm256_set1_pd(2.0);
+    const __m256d valueD = _mm256_set1_pd(value);
+    const __m256d spreadD = _mm256_set1_pd(spread);
+
+    __m256i s0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(rng.s0));
+    __m256i s1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(rng.s1));
+
+    for (; i < numValues; i += RANDOM_LANES)
+    {
+        __m256i x = s0;
+        __m256i y = s1;
+        __m256i draw = _mm256_add_epi64(x, y);
+        s0 = y;
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+        s1 = _mm256_xor_si256(_mm256_xor_si256(x, y),
+            _mm256_xor_si256(_mm256_srli_epi64(x, 17),
+                _mm256_srli_epi64(y, 26)));
+
+        __m256d u = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(
+            _mm256_srli_epi64(draw, 12), one)), oneD);
+        __m256d offset = _mm256_mul_pd(spreadD,
+            _mm256_sub_pd(_mm256_mul_pd(u, twoD), oneD));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(valueD, offset));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rng.s0), s0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rng.s1), s1);
+    #endif
+
+    // scalar fallback, lane by lane
+    for (; i < numValues; i += RANDOM_LANES)
+    {
+        for (unsigned int lane = 0; lane < RANDOM_LANES; lane++)
+        {
+            uint64_t x = rng.s0[lane];
+            uint64_t y = rng.s1[lane];
+            uint64_t draw = x + y;
+            rng.s0[lane] = y;
+            x ^= x << 23;
+            rng.s1[lane] = x ^ y ^ (x >> 17) ^ (y >> 26);
+
+            uint64_t bits = (draw >> 12) | RANDOM_ONE;
+            double u;
+            std::memcpy(&u, &bits, sizeof(u));
+            u -= 1.0;
+
+            out[i + lane] = value + spread * (u * 2.0 - 1.0);
+        }
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   numTrials - trials per row, rounded up to a multiple of 4
+//          numThreads - threads running the rows, 0 = one per core
+//          seed - seed of the random numbers.  A row draws the same numbers
+//              for any number of threads
+ToleranceAnalyzer::ToleranceAnalyzer(unsigned int numTrials,
+                                     unsigned int numThreads,
+                                     uint64_t seed) :
+    m_numTrials((std::max(1u, numTrials) + RANDOM_LANES - 1) /
+        RANDOM_LANES * RANDOM_LANES),
+    m_numThreads(numThreads > 0 ? numThreads :
+        std::max(1u, std::thread::hardware_concurrency())),
+    m_seed(seed)
+{
+    m_tolerance[TOL_HEATER] = TOLERANCE_HEATER;
+    m_tolerance[TOL_V_GRID1] = TOLERANCE_V_GRID1;
+    m_tolerance[TOL_V_ANODE] = TOLERANCE_V_ANODE;
+    m_tolerance[TOL_I_ANODE] = TOLERANCE_I_ANODE;
+    m_tolerance[TOL_GM] = TOLERANCE_GM;
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+ToleranceAnalyzer::~ToleranceAnalyzer()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to set the relative tolerance of a parameter
+// param:   param - parameter perturbed
+//          tolerance - i.e. 0.05 for +-5%
+void ToleranceAnalyzer::setTolerance(ToleranceParam param, double tolerance)
+{
+    m_tolerance[param] = tolerance;
+}
+
+//------------------------------------------------------------------------------
+
+// function to analyze every row of a catalogue.  Rows of a tube are its
+//  sections in order, as in the card pipeline, and the rows are run in
+//  contiguous blocks, one per thread
+void ToleranceAnalyzer::analyze(const TubeCatalogue &catalogue)
+{
+    size_t numRows = catalogue.size();
+
+    m_sections.resize(numRows);
+    for (size_t row = 0; row < numRows; row++)
+    {
+        m_sections[row] = row > 0 && catalogue.getText(row, TUBE_ID) ==
+            catalogue.getText(row - 1, TUBE_ID) ? m_sections[row - 1] + 1 : 0;
+    }
+
+    for (unsigned int c = 0; c < CHANGE_NUM_COUNTS; c++)
+    {
+        m_counts[c].assign(numRows, 0);
+    }
+
+    if (numRows == 0) { return; }
+
+    unsigned int numThreads = std::min<size_t>(m_numThreads, numRows);
+    size_t blockSize = (numRows + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+
+    for (size_t begin = 0; begin < numRows; begin += blockSize)
+    {
+        threads.push_back(std::thread(&ToleranceAnalyzer::analyzeRange, this,
+            std::cref(catalogue), begin, std::min(begin + blockSize,
+            numRows)));
+    }
+
+    for (auto it = threads.begin(); it != threads.end(); it++) { it->join(); }
+}
+
+//------------------------------------------------------------------------------
+
+// runs the trials of rows begin to end - 1.  Rows whose card fails before
+//  the test conditions are derived, i.e. pins that cannot be mapped, fail
+//  the same way for any values and are not run
+void ToleranceAnalyzer::analyzeRange(const TubeCatalogue &catalogue,
+                                     size_t begin,
+                                     size_t end)
+{
+    DataConverter converter;
+    TubeTests tests;
+    std::string text[NUM_TEXT_COLS_PER_ROW];
+    double nominal[NUM_DOUBLE_COLS_PER_ROW];
+    double values[NUM_DOUBLE_COLS_PER_ROW];
+    std::vector<double> trials[TOL_NUM_PARAMS];
+
+    converter.setVerbose(false);
+    for (unsigned int p = 0; p < TOL_NUM_PARAMS; p++)
+    {
+        trials[p].resize(m_numTrials);
+    }
+
+    for (size_t row = begin; row < end; row++)
+    {
+        catalogue.getRow(row, text, nominal);
+
+        SwitchMatrix card;
+        ConvertStatus status = converter.convertAVOData(text, nominal,
+            m_sections[row], tests, card);
+        if (status != CONVERT_OK && status != CONVERT_OUT_OF_RANGE)
+        {
+            continue;
+        }
+
+        unsigned int steps = ratingSteps(nominal[V_ANODE],
+            tests.getTestParam().bPlus);
+
+        RandomLanes rng;
+        seedLanes(rng, m_seed, row);
+
+        for (unsigned int p = 0; p < TOL_NUM_PARAMS; p++)
+        {
+            perturb(rng, nominal[TOL_COLUMNS[p]], m_tolerance[p],
+                trials[p].data(), m_numTrials);
+        }
+
+
+        uint32_t counts[CHANGE_NUM_COUNTS] = {0};
+        std::copy(nominal, nominal + NUM_DOUBLE_COLS_PER_ROW, values);
+
+        for (unsigned int t = 0; t < m_numTrials; t++)
+        {
+            for (unsigned int p = 0; p < TOL_NUM_PARAMS; p++)
+            {
+                values[TOL_COLUMNS[p]] = trials[p][t];
+            }
+
+            SwitchMatrix trialCard;
+            ConvertStatus trialStatus = converter.convertAVOData(text,
+                values, m_sections[row], tests, trialCard);
+
+            bool statusChanged = trialStatus != status;
+            bool ratingChanged = ratingSteps(values[V_ANODE],
+                tests.getTestParam().bPlus) != steps;
+            bool cardChanged = statusChanged ||
+                (status == CONVERT_OK && trialCard != card);
+
+            counts[CHANGE_STATUS] += statusChanged;
+            counts[CHANGE_RATING] += ratingChanged;
+            counts[CHANGE_CARD] += cardChanged;
+            counts[CHANGE_FRAGILE] += statusChanged | ratingChanged;
+        }
+
+        for (unsigned int c = 0; c < CHANGE_NUM_COUNTS; c++)
+        {
+            m_counts[c][row] = counts[c];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// function to print rows fragile in minFraction of trials or more, most
+//  fragile first, one per line:
+//  <TubeID> <test> <fragile%> status <%> rating <%> card <%>
+//  then the number of rows at or above minFraction per change
+// pre: catalogue was analyzed
+void ToleranceAnalyzer::print(std::ostream &out,
+                              const TubeCatalogue &catalogue,
+                              double minFraction) const
+{
+    const uint32_t* fragile = m_counts[CHANGE_FRAGILE].data();
+    const double minCount = minFraction * m_numTrials;
+    std::vector<unsigned int> rows;
+
+    for (size_t row = 0; row < size(); row++)
+    {
+        if (fragile[row] > 0 && fragile[row] >= minCount)
+        {
+            rows.push_back(row);
+        }
+    }
+
+    // stable, so rows of a count stay in catalogue order
+    std::stable_sort(rows.begin(), rows.end(),
+        [fragile](unsigned int a, unsigned int b)
+        {
+            return fragile[a] > fragile[b];
+        });
+
+    const double percent = 100.0 / m_numTrials;
+    out << std::fixed << std::setprecision(1);
+
+    for (auto it = rows.begin(); it != rows.end(); it++)
+    {
+        out << catalogue.getText(*it, TUBE_ID) << " " <<
+            m_sections[*it] + 1 << " " << fragile[*it] * percent;
+        for (unsigned int c = 0; c < CHANGE_FRAGILE; c++)
+        {
+            out << " " << CHANGE_NAMES[c] << " " <<
+                m_counts[c][*it] * percent;
+        }
+        out << "\n";
+    }
+
+    out << rows.size() << " of " << size() << " rows are fragile in " <<
+        minFraction * 100 << "% of " << m_numTrials << " trials or more:";
+    for (unsigned int c = 0; c < CHANGE_FRAGILE; c++)
+    {
+        size_t numRows = std::count_if(m_counts[c].begin(),
+            m_counts[c].end(),
+            [minCount](uint32_t count)
+            {
+                return count > 0 && count >= minCount;
+            });
+        out << " " << CHANGE_NAMES[c] << " " << numRows;
+    }
+    out << "\n";
+    out << std::defaultfloat;
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
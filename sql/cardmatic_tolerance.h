@@ -0,0 +1,167 @@
+//    Cardmatic card generator - cardmatic_tolerance.h file
+//    C++11 header file
+
+//    Monte Carlo tolerance analysis of generated cards.  The heater, bias,
+//      anode, plate current and gm of every catalogue row are perturbed
+//      within datasheet tolerances and the card is converted again the way
+//      the card pipeline does.  Quantization makes cards follow their data
+//      in steps, which is jitter; a trial is fragile when the tube becomes
+//      testable or untestable, or when the B+ step is lowered for the
+//      plate current rating a different number of times, so rows whose
+//      card depends on where the data fall against a limit are found.
+//      Random numbers are drawn four lanes at a time with AVX2 when
+//      compiled with -mavx2, with a scalar fallback giving identical results.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_TOLERANCE_H
+#define CARDMATIC_TOLERANCE_H
+
+#include "cardmatic_catalogue.h"
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+
+// default relative tolerances, a value is drawn uniformly within
+//  nominal * (1 +- tolerance)
+#define TOLERANCE_HEATER 0.01       // heater rating
+#define TOLERANCE_V_GRID1 0.02      // bias of the test conditions
+#define TOLERANCE_V_ANODE 0.02      // anode of the test conditions
+#define TOLERANCE_I_ANODE 0.05      // plate current of the test conditions
+#define TOLERANCE_GM 0.05           // gm of the test conditions
+
+#define TOLERANCE_TRIALS 200        // trials per row
+#define TOLERANCE_SEED 0x5DEECE66DULL
+#define TOLERANCE_MIN_FRAGILE 0.05  // printed rows are fragile in this share
+                                    // of trials or more
+
+
+
+//------------------------------------------------------------------------------
+//  enum
+//------------------------------------------------------------------------------
+
+// perturbed parameters
+typedef enum ToleranceParam
+{
+    TOL_HEATER,
+    TOL_V_GRID1,
+    TOL_V_ANODE,
+    TOL_I_ANODE,
+    TOL_GM,
+    TOL_NUM_PARAMS,
+}ToleranceParam;
+
+
+// counted changes of a row
+typedef enum ToleranceChange
+{
+    CHANGE_STATUS,          // card converts or fails to, unlike the nominal
+    CHANGE_RATING,          // B+ lowered for the current rating by another
+                            // number of steps
+    CHANGE_CARD,            // any switch, quantization jitter included
+    CHANGE_FRAGILE,         // status or rating
+    CHANGE_NUM_COUNTS,
+}ToleranceChange;
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class ToleranceAnalyzer
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   numTrials - trials per row, rounded up to a multiple of 4
+        //          numThreads - threads running the rows, 0 = one per core
+        //          seed - seed of the random numbers.  A row draws the same
+        //              numbers for any number of threads
+        ToleranceAnalyzer(unsigned int numTrials = TOLERANCE_TRIALS,
+                          unsigned int numThreads = 0,
+                          uint64_t seed = TOLERANCE_SEED);
+
+        ~ToleranceAnalyzer();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // function to set the relative tolerance of a parameter
+        // param:   param - parameter perturbed
+        //          tolerance - i.e. 0.05 for +-5%
+        void setTolerance(ToleranceParam param, double tolerance);
+
+
+        // function to analyze every row of a catalogue.  Rows of a tube
+        //  are its sections in order, as in the card pipeline
+        void analyze(const TubeCatalogue &catalogue);
+
+
+        // function to print rows fragile in minFraction of trials or more,
+        //  most fragile first, one per line:
+        //  <TubeID> <test> <fragile%> status <%> rating <%> card <%>
+        //  then the number of rows at or above minFraction per change
+        // pre: catalogue was analyzed
+        void print(std::ostream &out,
+                   const TubeCatalogue &catalogue,
+                   double minFraction = TOLERANCE_MIN_FRAGILE) const;
+
+
+
+        //----------------------------------------------------------------------
+        //  accessors
+        //----------------------------------------------------------------------
+
+        size_t size() const { return m_counts[CHANGE_FRAGILE].size(); }
+
+        unsigned int getNumTrials() const { return m_numTrials; }
+
+        double getTolerance(ToleranceParam param) const
+        {
+            return m_tolerance[param];
+        }
+
+        // trials of each row with the change
+        const uint32_t* getCounts(ToleranceChange change) const
+        {
+            return m_counts[change].data();
+        }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        unsigned int m_numTrials;
+        unsigned int m_numThreads;
+        uint64_t m_seed;
+        double m_tolerance[TOL_NUM_PARAMS];
+
+        std::vector<unsigned int> m_sections;   // of each row
+        std::vector<uint32_t> m_counts[CHANGE_NUM_COUNTS];
+
+
+
+        //----------------------------------------------------------------------
+        //  helpers
+        //----------------------------------------------------------------------
+
+        // runs the trials of rows begin to end - 1
+        void analyzeRange(const TubeCatalogue &catalogue,
+                          size_t begin,
+                          size_t end);
+};
+
+#endif // CARDMATIC_TOLERANCE_H
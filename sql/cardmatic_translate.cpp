@@ -0,0 +1,172 @@
+//    Cardmatic card generator - cardmatic_translate.cpp file
+//    C++11 implementation file
+
+//    Translates cards between tester models.  The KS15784, 1234 and USM118
+//      share the cardreader and the function of every switch, and differ in
+//      their limits: the grid bias supply and the regulated B+ ratings.  A
+//      card is read back to its bias and B+, and its bias and plate current
+//      are checked against the limits of the target model, so a card
+//      translates to the same switches, or is flagged when the other model
+//      has no equivalent.
+
+//    Written by: cathug
+
+
+#include <cmath>
+#include <limits>
+#include "cardmatic_translate.h"
+#include "../cardmatic_globals.h"
+
+
+// names of the fault bits
+static const struct
+{
+    unsigned int bit;
+    const char* name;
+} TRANSLATE_FAULT_NAMES[] = {
+    {TRANSLATE_BIAS, "bias"},
+    {TRANSLATE_BPLUS_CURRENT, "B+current"},
+    {TRANSLATE_INVALID_CARD, "switch"},
+    {TRANSLATE_UNKNOWN_CURRENT, "current"},
+};
+
+
+
+//------------------------------------------------------------------------------
+// Implementation
+//------------------------------------------------------------------------------
+
+// constructor
+// param:   fromModel - model the cards were generated for
+//          toModel - model to translate to, see ModelLimits
+CardTranslator::CardTranslator(unsigned int fromModel,
+                               unsigned int toModel) :
+    m_from(TubeTests::modelLimits(fromModel)),
+    m_to(TubeTests::modelLimits(toModel))
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// destructor
+CardTranslator::~CardTranslator()
+{
+
+}
+
+//------------------------------------------------------------------------------
+
+// function to translate a batch of cards, i.e. a card archive.  Cards are
+//  parsed in one pass, then checked in a second pass that only reads the
+//  parsed matrices
+// pre: isValid()
+// param:   cards - cards of fromModel
+//          translated - set to the cards of toModel, in card order, one per
+//              card with an equivalent
+//          faults - set to the TRANSLATE_* bits of each card, 0 if it has an
+//              equivalent
+// returns: number of cards translated
+size_t CardTranslator::translate(const std::vector<GeneratedCard> &cards,
+                                 std::vector<GeneratedCard> &translated,
+                                 std::vector<uint8_t> &faults) const
+{
+    std::vector<SwitchMatrix> matrices(cards.size());
+    faults.assign(cards.size(), 0);
+
+    for (size_t i = 0; i < cards.size(); i++)
+    {
+        if (!SwitchMatrix::fromString(cards[i].closedSW, matrices[i]))
+        {
+            faults[i] = TRANSLATE_INVALID_CARD;
+        }
+    }
+
+    for (size_t i = 0; i < cards.size(); i++)
+    {
+        if (faults[i] == 0)
+        {
+            faults[i] = translateCard(matrices[i], cards[i].current);
+        }
+    }
+
+
+    translated.clear();
+    for (size_t i = 0; i < cards.size(); i++)
+    {
+        if (faults[i] == 0) { translated.push_back(cards[i]); }
+    }
+
+    return translated.size();
+}
+
+//------------------------------------------------------------------------------
+
+// function to check one card against the target model.  The card held the
+//  source model's limits when it was generated, so only limits the target
+//  lowers are checked.  Leakage shunts are not checked: leakageShunt() sets
+//  at most I_NOM_HC_LEAKAGE_150, which every model has
+// pre: isValid()
+// param:   card - closed switches
+//          current - plate current expected at the card's B+ in mA, see
+//              GeneratedCard
+// returns: TRANSLATE_* bits, 0 if the card has the same switches on toModel
+unsigned int CardTranslator::translateCard(const SwitchMatrix &card,
+                                           double current) const
+{
+    unsigned int faults = 0;
+    double bias;
+
+    if (m_to->vBiasMax < m_from->vBiasMax &&
+        TubeTests::cardGridBias(card, bias) &&
+        bias > m_to->vBiasMax + TRANSLATE_BIAS_TOLERANCE)
+    {
+        faults |= TRANSLATE_BIAS;
+    }
+
+    // NaN, negative or out of range currents cannot be checked against the
+    //  B+ ratings, and would not convert to unsigned int
+    if (!(current >= 0 &&
+          current <= std::numeric_limits<unsigned int>::max()))
+    {
+        return faults | TRANSLATE_UNKNOWN_CURRENT;
+    }
+
+    // rounded up as TubeTests checks the plate current.  A card the source
+    //  ratings do not pass either draws no regulated B+
+    unsigned int bPlus = TubeTests::cardBPlus(card);
+    unsigned int maxCurrent = std::ceil(current);
+
+    if (TubeTests::B_plusCurrentCheck(m_from->bPlusMaxCurrent, bPlus,
+            maxCurrent) &&
+        !TubeTests::B_plusCurrentCheck(m_to->bPlusMaxCurrent, bPlus,
+            maxCurrent))
+    {
+        faults |= TRANSLATE_BPLUS_CURRENT;
+    }
+
+    return faults;
+}
+
+//------------------------------------------------------------------------------
+
+// returns: names of the TRANSLATE_* bits, i.e. "bias,B+current"
+std::string CardTranslator::faultNames(unsigned int faults)
+{
+    std::string names;
+
+    for (auto &fault : TRANSLATE_FAULT_NAMES)
+    {
+        if (faults & fault.bit)
+        {
+            if (!names.empty()) { names += ","; }
+            names += fault.name;
+        }
+    }
+
+    return names;
+}
+
+//------------------------------------------------------------------------------
+// End of implementation
+//------------------------------------------------------------------------------
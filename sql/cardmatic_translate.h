@@ -0,0 +1,106 @@
+//    Cardmatic card generator - cardmatic_translate.h file
+//    C++11 header file
+
+//    Translates cards between tester models.  The KS15784, 1234 and USM118
+//      share the cardreader and the function of every switch, and differ in
+//      their limits: the grid bias supply and the regulated B+ ratings.  A
+//      card is read back to its bias and B+, and its bias and plate current
+//      are checked against the limits of the target model, so a card
+//      translates to the same switches, or is flagged when the other model
+//      has no equivalent.
+
+//    Written by: cathug
+
+
+#ifndef CARDMATIC_TRANSLATE_H
+#define CARDMATIC_TRANSLATE_H
+
+#include "cardmatic_sql.h"
+#include "../cardmatic_cardpos.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// why a card has no equivalent on the target model
+#define TRANSLATE_BIAS 0x01             // grid bias beyond the bias supply
+#define TRANSLATE_BPLUS_CURRENT 0x02    // B+ rated for less current
+#define TRANSLATE_INVALID_CARD 0x04     // switch not on the cardreader
+#define TRANSLATE_UNKNOWN_CURRENT 0x08  // plate current missing or invalid
+
+#define TRANSLATE_BIAS_TOLERANCE 0.05   // half a bias step, in volts
+
+
+
+//------------------------------------------------------------------------------
+//  Class
+//------------------------------------------------------------------------------
+
+class CardTranslator
+{
+    public:
+        //----------------------------------------------------------------------
+        //  constructor and destructor
+        //----------------------------------------------------------------------
+
+        // param:   fromModel - model the cards were generated for
+        //          toModel - model to translate to, see ModelLimits
+        CardTranslator(unsigned int fromModel,
+                       unsigned int toModel);
+
+        ~CardTranslator();
+
+
+
+        //----------------------------------------------------------------------
+        //  member functions
+        //----------------------------------------------------------------------
+
+        // false if a model is unknown
+        bool isValid() const { return m_from != NULL && m_to != NULL; }
+
+
+        // function to translate a batch of cards, i.e. a card archive
+        // pre: isValid()
+        // param:   cards - cards of fromModel
+        //          translated - set to the cards of toModel, in card order,
+        //              one per card with an equivalent
+        //          faults - set to the TRANSLATE_* bits of each card, 0 if
+        //              it has an equivalent
+        // returns: number of cards translated
+        size_t translate(const std::vector<GeneratedCard> &cards,
+                         std::vector<GeneratedCard> &translated,
+                         std::vector<uint8_t> &faults) const;
+
+
+        // function to check one card against the target model
+        // pre: isValid()
+        // param:   card - closed switches
+        //          current - plate current expected at the card's B+ in mA,
+        //              see GeneratedCard
+        // returns: TRANSLATE_* bits, 0 if the card has the same switches on
+        //          toModel
+        unsigned int translateCard(const SwitchMatrix &card,
+                                   double current) const;
+
+
+        // returns: names of the TRANSLATE_* bits, i.e. "bias,B+current"
+        static std::string faultNames(unsigned int faults);
+
+
+        const ModelLimits* getFrom() const { return m_from; }
+
+        const ModelLimits* getTo() const { return m_to; }
+
+
+
+    private:
+        //----------------------------------------------------------------------
+        //  variables
+        //----------------------------------------------------------------------
+
+        const ModelLimits* m_from;
+        const ModelLimits* m_to;
+};
+
+#endif // CARDMATIC_TRANSLATE_H
@@ -9,14 +9,727 @@
 
 #include "cardmatic_sql.h"
 #include "cardmatic_dataconvert.h"
+#include "cardmatic_cardindex.h"
+#include "cardmatic_substitute.h"
+#include "cardmatic_query.h"
+#include "cardmatic_service.h"
+#include "cardmatic_pipeline.h"
+#include "cardmatic_quantize.h"
+#include "cardmatic_punch.h"
+#include "cardmatic_render.h"
+#include "cardmatic_coverage.h"
+#include "cardmatic_translate.h"
+#include "cardmatic_schedule.h"
+#include "cardmatic_tolerance.h"
+#include "cardmatic_simulate.h"
 #include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <csignal>
+#include <chrono>
+
+
+
+// lists tubes that can be tested in place of a tube
+// usage: cardmaticsql -s TubeID [maxResults]
+static int substituteMain(int argc, char* argv[])
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    TubeCatalogue catalogue;
+    catalogue.load(db, "avocardmatic");
+    db.dbClose();
+    
+    SubstituteFinder finder(catalogue);
+    std::vector<SubstituteMatch> matches = finder.findSubstitutes(argv[2],
+        argc > 3 ? std::atoi(argv[3]) : SUBSTITUTE_MAX_RESULTS);
+    
+    if (matches.empty())
+    {
+        std::cout << "Tube " << argv[2] << " not found." << std::endl;
+        return -1;
+    }
+    
+    std::cout << "Substitutes for " << argv[2] << ":" << std::endl;
+    for (auto it = matches.begin(); it != matches.end(); it++)
+    {
+        std::cout << it->tubeID << " distance " << it->distance << 
+            (it->samePinout ? "" : " (other pinout)") << 
+            (it->sameBase ? "" : " (other base)") << std::endl;
+    }
+    
+    return 0;
+}
+
+
+
+// lists tubes matching parameter ranges
+// usage: cardmaticsql -q predicate [predicate...], i.e.
+//      cardmaticsql -q pins=9 heater=6.3 gm>5000 cards=1
+static int queryMain(int argc, char* argv[])
+{
+    std::vector<QueryPredicate> predicates;
+    for (int i = 2; i < argc; i++)
+    {
+        QueryPredicate predicate;
+        if (QueryEngine::parsePredicate(argv[i], predicate) == false)
+        {
+            std::cout << "Invalid predicate " << argv[i] << std::endl;
+            return -1;
+        }
+        
+        predicates.push_back(predicate);
+    }
+    
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    TubeCatalogue catalogue;
+    catalogue.load(db, "avocardmatic");
+    db.dbClose();
+    
+    QueryEngine engine(catalogue);
+    std::vector<unsigned int> tubes = engine.select(predicates);
+    
+    for (auto it = tubes.begin(); it != tubes.end(); it++)
+    {
+        std::cout << catalogue.getText(*it, TUBE_ID) << ",";
+    }
+    std::cout << std::endl << tubes.size() << " tubes found." << std::endl;
+    
+    return 0;
+}
+
+
+
+// quantizes the catalogue to Cardmatic settings and lists rows out of range
+// usage: cardmaticsql --quantize
+static int quantizeMain()
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    TubeCatalogue catalogue;
+    catalogue.load(db, "avocardmatic");
+    db.dbClose();
+    
+    CatalogueQuantizer quantizer;
+    quantizer.quantize(catalogue);
+    
+    const uint8_t* outOfRange = quantizer.getOutOfRange();
+    size_t numOutOfRange = 0;
+    
+    for (size_t row = 0; row < quantizer.size(); row++)
+    {
+        if (outOfRange[row] == 0) { continue; }
+        
+        std::cout << catalogue.getText(row, TUBE_ID) << 
+            (outOfRange[row] & QUANT_HEATER_RANGE ? " heater" : "") << 
+            (outOfRange[row] & QUANT_BPLUS_RANGE ? " B+" : "") << 
+            (outOfRange[row] & QUANT_GM_RANGE ? " gm" : "") << 
+            (outOfRange[row] & QUANT_BIAS_RANGE ? " bias" : "") << 
+            (outOfRange[row] & QUANT_BPLUS_CURRENT ? " B+current" : "") << 
+            std::endl;
+        numOutOfRange++;
+    }
+    
+    std::cout << numOutOfRange << " of " << quantizer.size() << 
+        " rows out of range." << std::endl;
+    
+    return 0;
+}
+
+
+
+// perturbs the catalogue within datasheet tolerances, converts the cards
+//  again and lists the rows whose cards are most fragile
+// usage: cardmaticsql --tolerance [numTrials] [numThreads]
+static int toleranceMain(int argc, char* argv[])
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    TubeCatalogue catalogue;
+    catalogue.load(db, "avocardmatic");
+    db.dbClose();
+    
+    ToleranceAnalyzer analyzer(
+        argc > 2 ? std::atoi(argv[2]) : TOLERANCE_TRIALS, 
+        argc > 3 ? std::atoi(argv[3]) : 0);
+    
+    auto start = std::chrono::steady_clock::now();
+    analyzer.analyze(catalogue);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    
+    analyzer.print(std::cout, catalogue);
+    std::cout << "Analyzed in " << elapsed.count() << " ms." << std::endl;
+    
+    return 0;
+}
+
+
+
+// generates the card of every catalogue row and predicts its meter reading,
+//  listing cards that read outside SIM_DEFLECTION_MIN - SIM_DEFLECTION_MAX
+//  of full scale
+// usage: cardmaticsql --simulate
+static int simulateMain()
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    DataConverter converter;
+    TubeTests tests;
+    MeterSimulator simulator;
+    std::unordered_map<std::string, int> numCards;
+    long numStatus[SIM_NO_CONVERGENCE + 1] = {0};
+    long numOffScale = 0;
+    std::string lastTubeID;
+    unsigned int section = 0;
+    
+    converter.setVerbose(false);
+    auto start = std::chrono::steady_clock::now();
+    
+    long numRows = db.dbForEachRow("avocardmatic", 
+        [&](const std::string* text, const double* values)
+        {
+            // rows of a tube are adjacent
+            section = text[TUBE_ID] == lastTubeID ? section + 1 : 0;
+            lastTubeID = text[TUBE_ID];
+            
+            SwitchMatrix card;
+            if (converter.convertAVOData(text, values, section, tests, 
+                card) != CONVERT_OK)
+            {
+                return true;
+            }
+            
+            int testNum = ++numCards[text[TUBE_ID]];
+            MeterReading reading;
+            SimStatus status = simulator.simulate(card, values, reading);
+            numStatus[status]++;
+            
+            if (status == SIM_OK && 
+                (reading.deflection < SIM_DEFLECTION_MIN || 
+                 reading.deflection > SIM_DEFLECTION_MAX))
+            {
+                std::cout << text[TUBE_ID] << " " << testNum << 
+                    (reading.mode == METER_MODE_GM ? " gm " : " plate ") << 
+                    lround(reading.deflection * 100) << "% of " << 
+                    lround(reading.fullScale) << 
+                    (reading.mode == METER_MODE_GM ? " umho" : " uA") << 
+                    std::endl;
+                numOffScale++;
+            }
+            
+            return true;
+        });
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    db.dbClose();
+    
+    if (numRows < 0) { return -1; }
+    
+    std::cout << numOffScale << " of " << numStatus[SIM_OK] << 
+        " simulated cards read off scale";
+    for (int status = SIM_NOT_MODELLED; status <= SIM_NO_CONVERGENCE; 
+        status++)
+    {
+        std::cout << ", " << numStatus[status] << " " << 
+            MeterSimulator::statusName(SimStatus(status));
+    }
+    std::cout << ", in " << elapsed.count() << " ms." << std::endl;
+    
+    return 0;
+}
+
+
+
+// lists catalogue rows whose pins failed the load-time check
+// usage: cardmaticsql --check-pins
+static int checkPinsMain()
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    TubeCatalogue catalogue;
+    catalogue.load(db, "avocardmatic");
+    db.dbClose();
+    
+    const std::vector<PinFault> &faults = catalogue.getPinFaults();
+    
+    for (auto it = faults.begin(); it != faults.end(); it++)
+    {
+        const Tube::PinDiagnostic &diagnostic = it->diagnostic;
+        
+        std::cout << catalogue.getText(it->row, TUBE_ID) << " section " << 
+            diagnostic.section << ", base " << 
+            catalogue.getText(it->row, BASE) << ": " << 
+            (diagnostic.status == Tube::TUBE_PINS_NOT_UNIQUE ? 
+                "roles collide on" : "invalid");
+        
+        if (diagnostic.pin != '\0') 
+        {
+            std::cout << " pin " << diagnostic.pin;
+        }
+        
+        for (int r = 0; r < Tube::NUM_PIN_ROLES; r++)
+        {
+            if (diagnostic.roles & (1 << r))
+            {
+                std::cout << " " << Tube::roleName(Tube::PinRole(r));
+            }
+        }
+        
+        std::cout << std::endl;
+    }
+    
+    std::cout << faults.size() << " of " << catalogue.size() << 
+        " rows with pin faults." << std::endl;
+    
+    return 0;
+}
+
+
+
+// generates the card of every catalogue tube and stores them in a database
+// usage: cardmaticsql -w outputFile [numWorkers]
+static int writeBackMain(int argc, char* argv[])
+{
+    Database db;
+    Database output;
+    std::vector<GeneratedCard> batch;
+    bool stored = true;
+    
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false ||
+        output.dbOpen(argv[2], SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) 
+            == false)
+    {
+        return -1;
+    }
+    
+    output.dbSetWritePragmas();
+    
+    
+    // cards are stored in batches as they leave the pipeline
+    CardPipeline pipeline(argc > 3 ? std::atoi(argv[3]) : 0);
+    long numCards = pipeline.run(db, "avocardmatic",
+        [&](const GeneratedCard &card)
+        {
+            batch.push_back(card);
+            if (batch.size() == STORE_CARDS_BATCH_SIZE)
+            {
+                stored = output.dbStoreCards(batch, "generatedCards") && 
+                    stored;
+                batch.clear();
+            }
+        });
+    
+    if (!batch.empty())
+    {
+        stored = output.dbStoreCards(batch, "generatedCards") && stored;
+    }
+    
+    db.dbClose();
+    output.dbClose();
+    
+    if (numCards < 0 || stored == false) { return -1; }
+    
+    std::cout << numCards << " cards stored in " << argv[2] << ", " << 
+        pipeline.getNumRejected() << " rows rejected" << std::endl;
+    return 0;
+}
+
+
+
+// generates the card of every catalogue tube and writes the CNC punch
+//  program of the batch
+// usage: cardmaticsql --punch outputFile [numWorkers]
+static int punchMain(int argc, char* argv[])
+{
+    Database db;
+    std::vector<GeneratedCard> cards;
+    
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    CardPipeline pipeline(argc > 3 ? std::atoi(argv[3]) : 0);
+    long numCards = pipeline.run(db, "avocardmatic",
+        [&](const GeneratedCard &card) { cards.push_back(card); });
+    db.dbClose();
+    
+    std::ofstream output(argv[2]);
+    PunchPlanner planner;
+    
+    if (numCards < 0 || !output || !planner.writeGCode(output, cards))
+    {
+        return -1;
+    }
+    
+    std::cout << cards.size() << " cards, " << planner.getNumHoles() << 
+        " holes on " << planner.getNumSheets() << " sheets written to " << 
+        argv[2] << ", " << planner.getTravel() / 1000 << " m head travel" << 
+        std::endl;
+    return 0;
+}
+
+
+
+// generates the card of every catalogue tube and renders them as printable
+//  hand punch templates, PDF or one SVG per page by file name extension
+// usage: cardmaticsql --render outputFile.pdf|outputFile.svg [numWorkers]
+static int renderMain(int argc, char* argv[])
+{
+    Database db;
+    std::string fileName = argv[2];
+    bool svg = fileName.size() > 4 && 
+        fileName.compare(fileName.size() - 4, 4, ".svg") == 0;
+    bool rendered = true;
+    
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    // pages are written as the cards leave the pipeline
+    CardRenderer renderer(svg ? CardRenderer::RENDER_SVG : 
+        CardRenderer::RENDER_PDF, fileName);
+    CardPipeline pipeline(argc > 3 ? std::atoi(argv[3]) : 0);
+    long numCards = pipeline.run(db, "avocardmatic",
+        [&](const GeneratedCard &card)
+        {
+            rendered = renderer.addCard(card) && rendered;
+        });
+    db.dbClose();
+    
+    if (numCards < 0 || !renderer.finish() || rendered == false) 
+    { 
+        return -1; 
+    }
+    
+    std::cout << numCards << " cards rendered on " << 
+        renderer.getNumPages() << " pages, " << 
+        renderer.getCardsPerPage() << " per page" << std::endl;
+    return 0;
+}
+
+
+
+// reports which tubes of the official card lists are in the catalogue, and
+//  whether their generated cards match the official number of cards
+// usage: cardmaticsql --coverage [numWorkers]
+static int coverageMain(int argc, char* argv[])
+{
+    Database db;
+    if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false)
+    {
+        return -1;
+    }
+    
+    CoverageReport report;
+    bool built = report.build(db, "avocardmatic", 
+        argc > 2 ? std::atoi(argv[2]) : 0);
+    db.dbClose();
+    
+    if (built == false) { return -1; }
+    
+    report.print(std::cout);
+    return 0;
+}
+
+
+
+// translates the cards stored by -w to another tester model and stores them
+//  in table generatedCards<toModel> of the same file
+// usage: cardmaticsql --translate fromModel toModel cardFile
+static int translateMain(char* argv[])
+{
+    CardTranslator translator(std::atoi(argv[2]), std::atoi(argv[3]));
+    if (!translator.isValid())
+    {
+        std::cout << "Models are 15784, 1234 and 118." << std::endl;
+        return -1;
+    }
+    
+    Database archive;
+    if (archive.dbOpen(argv[4], SQLITE_OPEN_READWRITE) == false)
+    {
+        return -1;
+    }
+    
+    std::vector<GeneratedCard> cards;
+    long numCards = archive.dbForEachCard("generatedCards", 
+        [&](const GeneratedCard &card) 
+        { 
+            cards.push_back(card); 
+            return true; 
+        });
+    
+    std::vector<GeneratedCard> translated;
+    std::vector<uint8_t> faults;
+    translator.translate(cards, translated, faults);
+    
+    std::string tableName = std::string("generatedCards") + argv[3];
+    bool stored = numCards >= 0 && 
+        archive.dbStoreCards(translated, tableName, STORE_CARDS_BATCH_SIZE);
+    archive.dbClose();
+    
+    if (stored == false) { return -1; }
+    
+    for (size_t i = 0; i < cards.size(); i++)
+    {
+        if (faults[i] == 0) { continue; }
+        
+        std::cout << cards[i].tubeID << " card " << cards[i].testNum << 
+            ": " << CardTranslator::faultNames(faults[i]) << std::endl;
+    }
+    
+    std::cout << translated.size() << " of " << cards.size() << 
+        " cards translated from " << translator.getFrom()->name << " to " << 
+        translator.getTo()->name << " and stored in " << tableName << 
+        std::endl;
+    return 0;
+}
+
+
+
+// orders the tests of a bin of tubes to minimize card changes.  Cards are
+//  looked up in a card file written by -w, or generated from the catalogue
+// usage: cardmaticsql --schedule tubeListFile [cardFile]
+static int scheduleMain(int argc, char* argv[])
+{
+    std::ifstream tubeList(argv[2]);
+    if (!tubeList) { return -1; }
+    
+    std::vector<std::string> tubeIDs;
+    std::unordered_map<std::string, std::vector<GeneratedCard> > cards;
+    std::string tubeID;
+    
+    while (tubeList >> tubeID)
+    {
+        tubeIDs.push_back(tubeID);
+        cards[tubeID];
+    }
+    
+    
+    // keep the cards of the listed tubes
+    auto keep = [&](const GeneratedCard &card)
+        {
+            auto it = cards.find(card.tubeID);
+            if (it != cards.end()) { it->second.push_back(card); }
+            return true;
+        };
+    
+    Database db;
+    long numCards;
+    
+    if (argc > 3)
+    {
+        if (db.dbOpen(argv[3], SQLITE_OPEN_READONLY) == false) { return -1; }
+        numCards = db.dbForEachCard("generatedCards", keep);
+    }
+    
+    else
+    {
+        if (db.dbOpen("cardmatic.sqlite", SQLITE_OPEN_READONLY) == false) 
+        { 
+            return -1; 
+        }
+        
+        CardPipeline pipeline;
+        numCards = pipeline.run(db, "avocardmatic", 
+            [&](const GeneratedCard &card) { keep(card); });
+    }
+    
+    db.dbClose();
+    if (numCards < 0) { return -1; }
+    
+    
+    TestScheduler scheduler;
+    for (auto it = tubeIDs.begin(); it != tubeIDs.end(); it++)
+    {
+        const std::vector<GeneratedCard> &tubeCards = cards[*it];
+        if (tubeCards.empty()) 
+        { 
+            std::cout << "No card for " << *it << std::endl; 
+        }
+        
+        for (auto card = tubeCards.begin(); card != tubeCards.end(); card++)
+        {
+            scheduler.addTest(*card);
+        }
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    scheduler.schedule();
+    std::chrono::duration<double, std::milli> elapsed = 
+        std::chrono::steady_clock::now() - start;
+    
+    scheduler.print(std::cout);
+    std::cout << scheduler.getTests().size() << " tests on " << 
+        scheduler.getGroups().size() << " cards, " << 
+        scheduler.getNumSwaps() << " card changes, " << 
+        scheduler.getSwitchChanges() << " switches changed, scheduled in " << 
+        elapsed.count() << " ms" << std::endl;
+    return 0;
+}
+
+
+
+// service stopped by SIGINT and SIGTERM
+static CardService* g_service = NULL;
+
+static void stopService(int)
+{
+    if (g_service != NULL) { g_service->stop(); }
+}
+
+
+
+// answers card requests on a Unix domain socket until interrupted
+// usage: cardmaticsql --serve socketPath [numWorkers]
+static int serveMain(int argc, char* argv[])
+{
+    CardService service;
+    
+    if (service.start("cardmatic.sqlite", argv[2], 
+            argc > 3 ? std::atoi(argv[3]) : SERVICE_DEFAULT_WORKERS) == false)
+    {
+        return -1;
+    }
+    
+    g_service = &service;
+    signal(SIGINT, stopService);
+    signal(SIGTERM, stopService);
+    
+    std::cout << "Serving cards on " << argv[2] << std::endl;
+    service.run();
+    
+    g_service = NULL;
+    return 0;
+}
+
+
 
 // test!
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if (argc >= 3 && std::string(argv[1]) == "-s")
+    {
+        return substituteMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "-q")
+    {
+        return queryMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "--serve")
     {
-        std::cout << "Two arguments needed." << std::endl;
+        return serveMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "-w")
+    {
+        return writeBackMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "--punch")
+    {
+        return punchMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "--render")
+    {
+        return renderMain(argc, argv);
+    }
+    
+    if (argc >= 3 && std::string(argv[1]) == "--schedule")
+    {
+        return scheduleMain(argc, argv);
+    }
+    
+    if (argc == 5 && std::string(argv[1]) == "--translate")
+    {
+        return translateMain(argv);
+    }
+    
+    if (argc >= 2 && std::string(argv[1]) == "--coverage")
+    {
+        return coverageMain(argc, argv);
+    }
+    
+    if (argc == 2 && std::string(argv[1]) == "--quantize")
+    {
+        return quantizeMain();
+    }
+    
+    if (argc >= 2 && argc <= 4 && std::string(argv[1]) == "--tolerance")
+    {
+        return toleranceMain(argc, argv);
+    }
+    
+    if (argc == 2 && std::string(argv[1]) == "--simulate")
+    {
+        return simulateMain();
+    }
+    
+    if (argc == 2 && std::string(argv[1]) == "--check-pins")
+    {
+        return checkPinsMain();
+    }
+    
+    if (argc != 2 && argc != 3)
+    {
+        std::cout << "Usage: cardmaticsql TubeID [maxSwitchDiff]" << std::endl;
+        std::cout << "       cardmaticsql -s TubeID [maxResults]" << std::endl;
+        std::cout << "       cardmaticsql -q predicate [predicate...]" << 
+            std::endl;
+        std::cout << "       cardmaticsql -w outputFile [numWorkers]" << 
+            std::endl;
+        std::cout << "       cardmaticsql --serve socketPath [numWorkers]" << 
+            std::endl;
+        std::cout << "       cardmaticsql --punch outputFile [numWorkers]" << 
+            std::endl;
+        std::cout << "       cardmaticsql --render outputFile.pdf|.svg " <<
+            "[numWorkers]" << std::endl;
+        std::cout << "       cardmaticsql --coverage [numWorkers]" << 
+            std::endl;
+        std::cout << "       cardmaticsql --translate fromModel toModel " <<
+            "cardFile" << std::endl;
+        std::cout << "       cardmaticsql --schedule tubeListFile " <<
+            "[cardFile]" << std::endl;
+        std::cout << "       cardmaticsql --quantize" << std::endl;
+        std::cout << "       cardmaticsql --tolerance [numTrials] " <<
+            "[numThreads]" << std::endl;
+        std::cout << "       cardmaticsql --simulate" << std::endl;
+        std::cout << "       cardmaticsql --check-pins" << std::endl;
         return -1;
     }
     
@@ -58,7 +771,7 @@ int main(int argc, char* argv[])
     const char* param[] = {
         argv[1]
     };
-    int paramSize = argc - 1;
+    int paramSize = 1;
     
     db.dbQuery(param, paramSize, "avocardmatic");
     
@@ -74,7 +787,45 @@ int main(int argc, char* argv[])
     
     
     
-    
+    // list catalogue tubes with a card within maxSwitchDiff switches of a
+    //  card of the tube
+    if (argc == 3)
+    {
+        std::vector<SwitchMatrix> cards;
+        TubeTests tests;
+        CardIndex index;
+        
+        // cards of the tube's sections, before the catalogue query
+        //  replaces the rows
+        d.setVerbose(false);
+        for (unsigned int row = 0; row < db.getNumRowsReturned(); row++)
+        {
+            SwitchMatrix card;
+            if (d.convertAVOData(
+                    &db.getTubeData_str()[row * NUM_TEXT_COLS_PER_ROW], 
+                    &db.getTubeData_double()[row * NUM_DOUBLE_COLS_PER_ROW],
+                    row, tests, card) == CONVERT_OK)
+            {
+                cards.push_back(card);
+            }
+        }
+        
+        index.addCatalogue(db, d, "avocardmatic");
+        
+        for (unsigned int i = 0; i < cards.size(); i++)
+        {
+            std::vector<CardMatch> matches = 
+                index.findWithin(cards[i], std::atoi(argv[2]));
+            
+            std::cout << "Tubes with cards matching card " << i + 1 << 
+                ":" << std::endl;
+            for (auto it = matches.begin(); it != matches.end(); it++)
+            {
+                std::cout << it->tubeID << "(" << it->distance << "),";
+            }
+            std::cout << std::endl;
+        }
+    }
     
     
     db.dbClose();    // close database
@@ -12,7 +12,502 @@
 #include "cardmatic_cardpos.h"
 #include "cardmatic_globals.h"
 #include "cardmatic_tube.h"
+#include "cardmatic_sweep.h"
+#include "cardmatic_recipe.h"
 #include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+
+
+// decade resistor switches in the order the original encoder tried them,
+//  with the resistance each one puts in series when open
+static const struct { char letter; unsigned int row; unsigned int ohms; }
+LADDER[] = {
+    {'G', 15, 30000}, {'G', 14, 20000}, {'G', 13, 10000},
+    {'F', 16, 4000}, {'F', 15, 3000}, {'F', 14, 2000}, {'F', 13, 1000},
+    {'E', 16, 400}, {'E', 15, 300}, {'E', 14, 200}, {'E', 13, 100},
+    {'D', 16, 40}, {'D', 15, 30}, {'D', 14, 20}, {'D', 13, 10},
+};
+
+static const unsigned int LADDER_SIZE = sizeof(LADDER) / sizeof(LADDER[0]);
+
+
+// checks decadeResistor against the original greedy walk for every value
+//  0 - DECADE_RES_MAX, and the resistance gridBias sets for every bias
+//  0 - V_BIAS_MAX in 0.1V steps
+// usage: cardmatic --check-decade
+static int decadeCheck()
+{
+    unsigned int numFailed = 0;
+    unsigned int numChecked = 0;
+
+    for (unsigned long dVal = 0; dVal <= DECADE_RES_MAX;
+        dVal += DECADE_RES_INC)
+    {
+        TubeTests tests;
+        tests.decadeResistor(dVal);
+
+        unsigned long left = dVal;
+        unsigned long ohms = 0;
+        bool same = true;
+
+        for (unsigned int s = 0; s < LADDER_SIZE; s++)
+        {
+            bool expectOpen = left >= LADDER[s].ohms;
+            if (expectOpen) { left -= LADDER[s].ohms; }
+
+            bool open = !tests.searchSwitch(LADDER[s].letter, LADDER[s].row);
+            if (open) { ohms += LADDER[s].ohms; }
+            if (open != expectOpen) { same = false; }
+        }
+
+        if (!same || ohms != dVal)
+        {
+            std::cout << "decade " << dVal << " set to " << ohms << std::endl;
+            numFailed++;
+        }
+
+        numChecked++;
+    }
+
+    for (unsigned int tenths = 0; tenths <= V_BIAS_MAX * 10; tenths++)
+    {
+        double ec = tenths / 10.0;
+        double exact = ec * BIAS_DIVIDER_RES / (V_BIAS_SUPPLY - ec);
+
+        TubeTests tests;
+        tests.gridBias(-ec, TubeTests::FIXED_BIAS, true);
+
+        unsigned long ohms = 0;
+        for (unsigned int s = 0; s < LADDER_SIZE; s++)
+        {
+            if (!tests.searchSwitch(LADDER[s].letter, LADDER[s].row))
+            {
+                ohms += LADDER[s].ohms;
+            }
+        }
+
+        if (std::fabs(ohms - exact) > DECADE_RES_INC / 2.0)
+        {
+            std::cout << "bias " << -ec << "V set to " << ohms <<
+                " ohms, needs " << exact << std::endl;
+            numFailed++;
+        }
+
+        numChecked++;
+    }
+
+    std::cout << numChecked - numFailed << " of " << numChecked <<
+        " decade settings correct." << std::endl;
+
+    return numFailed == 0 ? 0 : -1;
+}
+
+
+
+// ECC83 twin triode, pins checked against the B9A base at compile time
+constexpr Tube::TubePinout ECC83_PINOUT = BaseB9A::pinout(
+    {Tube::PIN_2, Tube::PIN_3, '\0', '\0', Tube::PIN_1, '\0'},
+    {Tube::PIN_7, Tube::PIN_8, '\0', '\0', Tube::PIN_6, '\0'},
+    Tube::PIN_4, Tube::PIN_5, Tube::PIN_9);
+
+static_assert(BaseB9A::fits(ECC83_PINOUT), "ECC83 pins do not fit B9A base");
+
+
+
+// how a test kind used each subsystem before the standard recipes, the
+//  reference recipeCheck() compares the recipes against
+typedef enum ReferenceBias {REF_BIAS_NONE, REF_BIAS_SIGNAL, REF_BIAS_DC,
+    REF_BIAS_ZERO} ReferenceBias;
+
+typedef enum ReferenceMeter {REF_METER_NONE, REF_METER_GM, REF_METER_PLATE,
+    REF_METER_DIODE, REF_METER_RECTIFIER} ReferenceMeter;
+
+typedef struct RecipeReference
+{
+    bool heater;
+    ReferenceBias bias;
+    ReferenceMeter meter;
+    bool screen;
+    TubeTests::Bplus supply;
+    const char* switchList;
+    unsigned int leakage;       // leakage shunt current, 0 for none
+}RecipeReference;
+
+// index TubeTests::TestKind
+static const RecipeReference RECIPE_REFERENCES[TubeTests::NUM_TEST_KINDS] = {
+    {true, REF_BIAS_SIGNAL, REF_METER_GM, false,
+        TubeTests::REGULATED_BPLUS, "", I_NOM_HC_LEAKAGE_100},
+    {true, REF_BIAS_SIGNAL, REF_METER_GM, true,
+        TubeTests::REGULATED_BPLUS, "", I_NOM_HC_LEAKAGE_100},
+    {true, REF_BIAS_SIGNAL, REF_METER_GM, true,
+        TubeTests::REGULATED_BPLUS, "", I_NOM_HC_LEAKAGE_100},
+    {true, REF_BIAS_ZERO, REF_METER_PLATE, true,
+        TubeTests::REGULATED_BPLUS, "", 0},
+    {true, REF_BIAS_ZERO, REF_METER_PLATE, false,
+        TubeTests::REGULATED_BPLUS, "", 0},
+    {true, REF_BIAS_NONE, REF_METER_RECTIFIER, false,
+        TubeTests::REGULATED_BPLUS, "J14", I_NOM_HC_LEAKAGE_150},
+    {true, REF_BIAS_NONE, REF_METER_DIODE, false,
+        TubeTests::AUXILIARY_BPLUS, "", I_NOM_HC_LEAKAGE_150},
+    {true, REF_BIAS_NONE, REF_METER_DIODE, false,
+        TubeTests::REGULATED_BPLUS, "", I_NOM_HC_LEAKAGE_20},
+    {false, REF_BIAS_NONE, REF_METER_DIODE, false,
+        TubeTests::REGULATED_BPLUS, "", 0},
+    {true, REF_BIAS_NONE, REF_METER_NONE, false,
+        TubeTests::REGULATED_BPLUS, "", 0},
+    {true, REF_BIAS_DC, REF_METER_PLATE, false,
+        TubeTests::REGULATED_BPLUS, "", 0},
+};
+
+static const unsigned int RECIPE_TRIALS = 2000;     // runs per test kind
+
+
+// helper to run one subsystem of a reference test with the TubeTests
+//  functions, on whatever tests holds
+static void runReference(const RecipeReference &reference,
+                         const TestParam &param,
+                         TubeTests::Subsystem subsystem,
+                         TubeTests &tests)
+{
+    bool regulatedBplus = reference.meter == REF_METER_GM ||
+                          reference.meter == REF_METER_PLATE ||
+                          (reference.meter == REF_METER_DIODE &&
+                           reference.supply == TubeTests::REGULATED_BPLUS);
+    TubeTests::Biasing biasType = param.fixedBias ? TubeTests::FIXED_BIAS :
+                                                    TubeTests::SELF_BIAS;
+    double vGrid = reference.bias == REF_BIAS_ZERO ? 0.0 : param.bias;
+    bool gridSignal = reference.bias == REF_BIAS_SIGNAL;
+    SwitchMatrix switchList;
+
+    switch (subsystem)
+    {
+        case TubeTests::SUBSYSTEM_HEATER:
+            if (!reference.heater) { break; }
+            tests.setHeaterVolts(param.heater);
+            tests.heaterSupply(param.dcHeater ? TubeTests::DC_HEATER :
+                                                TubeTests::AC_HEATER);
+            break;
+
+        case TubeTests::SUBSYSTEM_BIAS:
+            if (reference.bias == REF_BIAS_NONE) { break; }
+            if (param.twin)
+            {
+                tests.setTwinTriodeSwitches(vGrid, biasType, gridSignal);
+            }
+
+            else { tests.gridBias(vGrid, biasType, gridSignal); }
+            break;
+
+        case TubeTests::SUBSYSTEM_BPLUS:
+            if (!regulatedBplus) { break; }
+            tests.B_plusVolts(param.bPlus, reference.meter != REF_METER_DIODE &&
+                reference.screen, reference.meter == REF_METER_GM);
+            break;
+
+        case TubeTests::SUBSYSTEM_METER:
+            if (reference.meter == REF_METER_GM)
+            {
+                tests.umho_meterShunt(param.umhoFS);
+            }
+
+            else if (reference.meter == REF_METER_PLATE)
+            {
+                tests.plateCurrentTest(param.maFS);
+            }
+
+            else if (reference.meter == REF_METER_DIODE)
+            {
+                tests.diodeTest(param.maFS, reference.supply, param.load > 0,
+                    param.load);
+            }
+
+            else if (reference.meter == REF_METER_RECTIFIER)
+            {
+                tests.halfWaveRectifierTest(param.load, param.maxInverse,
+                    param.maFS);
+            }
+            break;
+
+        case TubeTests::SUBSYSTEM_SWITCH_LIST:
+            SwitchMatrix::fromString(reference.switchList, switchList);
+            for (int i = 0; i < SW_NUM_SWITCHES; i++)
+            {
+                if (switchList.testBit(i))
+                {
+                    tests.assertKeyClosed(SwitchMatrix::indexLetter(i),
+                        SwitchMatrix::indexNumber(i));
+                }
+            }
+            break;
+
+        case TubeTests::SUBSYSTEM_LEAKAGE:
+            if (param.leakage && reference.leakage != 0)
+            {
+                tests.leakageShunt(reference.leakage);
+            }
+            break;
+
+        default:    // the pin map is set up before the test
+            break;
+    }
+}
+
+
+// helper to find the faults the reference rejects a test for
+static unsigned int referenceFaults(const RecipeReference &reference,
+                                    const TestParam &param)
+{
+    bool regulatedBplus = reference.meter == REF_METER_GM ||
+                          reference.meter == REF_METER_PLATE ||
+                          (reference.meter == REF_METER_DIODE &&
+                           reference.supply == TubeTests::REGULATED_BPLUS);
+    bool usesLoad = reference.meter == REF_METER_RECTIFIER ||
+                    (reference.meter == REF_METER_DIODE && param.load > 0);
+    unsigned int faults = 0;
+
+    // heaters the cardreader has no switch for count as out of range
+    TubeTests heater;
+    runReference(reference, param, TubeTests::SUBSYSTEM_HEATER, heater);
+    const CardReader &switches = heater.getClosedSwitches();
+    for (auto it = switches.begin(); it != switches.end(); it++)
+    {
+        if (SwitchMatrix::switchIndex(it->first, it->second) < 0)
+        {
+            faults |= TEST_FAULT_HEATER;
+        }
+    }
+
+    if (reference.heater && (param.heater < V_HEATER_MIN ||
+        param.heater > (param.dcHeater ? V_HEATER_MAX_DC : V_HEATER_MAX_AC)))
+    {
+        faults |= TEST_FAULT_HEATER;
+    }
+
+    // zero bias tests apply no bias whatever the tube data lists
+    if ((reference.bias == REF_BIAS_SIGNAL || reference.bias == REF_BIAS_DC) &&
+        std::fabs(param.bias) > V_BIAS_MAX)
+    {
+        faults |= TEST_FAULT_BIAS;
+    }
+
+    if (regulatedBplus && (param.bPlus < V_REGBPLUS_MIN ||
+        param.bPlus > V_REGBPLUS_MAX || param.bPlus % V_REGBPLUS_INC != 0))
+    {
+        faults |= TEST_FAULT_BPLUS;
+    }
+
+    else if (regulatedBplus &&
+             !heater.B_plusCurrentCheck(param.bPlus, std::ceil(param.current)))
+    {
+        faults |= TEST_FAULT_BPLUS_CURRENT;
+    }
+
+    if (reference.meter == REF_METER_GM && (param.umhoFS < METER_FS_GM_MIN ||
+        param.umhoFS > METER_FS_GM_MAX_HIGH))
+    {
+        faults |= TEST_FAULT_GM;
+    }
+
+    if (reference.meter != REF_METER_GM && reference.meter != REF_METER_NONE &&
+        (param.maFS < METER_FS_I_MIN || param.maFS > METER_FS_I_MAX_HIGH))
+    {
+        faults |= TEST_FAULT_METER;
+    }
+
+    if (usesLoad && param.load > DECADE_RES_MAX) { faults |= TEST_FAULT_LOAD; }
+
+    return faults;
+}
+
+
+// helper to build the reference card of a test.  Each subsystem runs on an
+//  empty and on a full cardreader to find the switches it closes and opens,
+//  then the subsystems are folded onto the pin map in Subsystem order
+static SwitchMatrix referenceCard(const RecipeReference &reference,
+                                  const TestParam &param,
+                                  const CardReader &pins)
+{
+    SwitchMatrix card(pins);
+
+    for (int s = TubeTests::SUBSYSTEM_PINS + 1; s < TubeTests::NUM_SUBSYSTEMS;
+        s++)
+    {
+        TubeTests empty, full;
+        full.getClosedSwitches() = SwitchMatrix::allClosed().toCardReader();
+
+        runReference(reference, param, static_cast<TubeTests::Subsystem>(s),
+            empty);
+        runReference(reference, param, static_cast<TubeTests::Subsystem>(s),
+            full);
+
+        SwitchMatrix open = SwitchMatrix::allClosed().openAll(
+            SwitchMatrix(full.getClosedSwitches()));
+        card.openAll(open) |= SwitchMatrix(empty.getClosedSwitches());
+    }
+
+    return card;
+}
+
+
+// checks every test kind run on the standard recipes against the TubeTests
+//  functions the recipes stand for, over random test conditions including
+//  ones out of the tester's ranges.  Faults, cards and cards changed by
+//  updateTestParam() must all match
+// usage: cardmatic --check-recipes
+static int recipeCheck()
+{
+    for (int k = 0; k < TubeTests::NUM_TEST_KINDS; k++)
+    {
+        const char* recipe =
+            TubeTests::testRecipe(static_cast<TubeTests::TestKind>(k));
+        if (!TubeTests::hasTest(recipe))
+        {
+            std::cout << "no standard recipe " << recipe << std::endl;
+            return -1;
+        }
+    }
+
+    Tube ECC83("ECC83", ECC83_PINOUT, "B9A");
+    CardReader pins;
+    ECC83.setSingleTubeSectionSwitches(pins, Tube::TRIODE, true, false);
+
+    std::mt19937 generator(RECIPE_TRIALS);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    unsigned int numFailed = 0;
+    unsigned int numChecked = 0;
+    unsigned int numRejected = 0;
+
+    for (int k = 0; k < TubeTests::NUM_TEST_KINDS; k++)
+    {
+        TubeTests::TestKind kind = static_cast<TubeTests::TestKind>(k);
+        const RecipeReference &reference = RECIPE_REFERENCES[k];
+        TubeTests updated;      // kept across trials for updateTestParam()
+        bool updatedRun = false;
+
+        for (unsigned int trial = 0; trial < RECIPE_TRIALS; trial++)
+        {
+            // conditions run past the ends of the tester's ranges
+            TestParam param = TestParam();
+            param.twin = uniform(generator) < 0.5;
+            param.dcHeater = uniform(generator) < 0.5;
+            param.leakage = uniform(generator) < 0.5;
+            param.fixedBias = uniform(generator) < 0.5;
+            param.heater = uniform(generator) * V_HEATER_MAX_AC * 1.05;
+            param.bias = (uniform(generator) - 0.9) * V_BIAS_MAX * 1.1;
+            param.bPlus = lround(uniform(generator) * V_REGBPLUS_MAX * 1.05);
+            if (uniform(generator) < 0.9)
+            {
+                param.bPlus -= param.bPlus % V_REGBPLUS_INC;
+            }
+
+            param.current = uniform(generator) * 50;
+            param.umhoFS = lround(uniform(generator) * METER_FS_GM_MAX_HIGH *
+                1.05);
+            param.maFS = lround(uniform(generator) * METER_FS_I_MAX_HIGH *
+                1.05);
+            param.load = uniform(generator) < 0.5 ? 0 :
+                lround(uniform(generator) * DECADE_RES_MAX * 1.05);
+            param.maxInverse = lround(uniform(generator) * 1000);
+
+            unsigned int expectFaults = referenceFaults(reference, param);
+            unsigned int faults = updated.testParamFaults(kind, param);
+
+            TubeTests tests;
+            tests.getClosedSwitches() = pins;
+            tests.setTestParam(param);
+            bool run = tests.runTest(kind);
+            SwitchMatrix card(tests.getClosedSwitches());
+
+            bool update = updatedRun && updated.updateTestParam(param);
+            if (!updatedRun)
+            {
+                updated.getClosedSwitches() = pins;
+                updated.setTestParam(param);
+                updatedRun = updated.runTest(kind);
+                update = updatedRun;
+            }
+
+            numChecked++;
+            if (expectFaults != 0 && faults == expectFaults && !run &&
+                !update)
+            {
+                numRejected++;
+                continue;
+            }
+
+            SwitchMatrix expected = referenceCard(reference, param, pins);
+            SwitchMatrix updatedCard(updated.getClosedSwitches());
+
+            if (faults != expectFaults || run != (expectFaults == 0) ||
+                update != run || (run && (card != expected ||
+                updatedCard != expected)))
+            {
+                std::cout << "test kind " << k << ": heater " << param.heater <<
+                    " bias " << param.bias << " B+ " << param.bPlus <<
+                    " gm " << param.umhoFS << " maFS " << param.maFS <<
+                    " load " << param.load << "\n  faults:    " << faults <<
+                    ", expected " << expectFaults << "\n  recipe:    " <<
+                    card.toString() << "\n  updated:   " <<
+                    updatedCard.toString() << "\n  TubeTests: " <<
+                    expected.toString() << std::endl;
+                numFailed++;
+            }
+        }
+    }
+
+    std::cout << numChecked - numFailed << " of " << numChecked <<
+        " test runs match TubeTests, " << numRejected << " rejected for "
+        "conditions out of range." << std::endl;
+
+    return numFailed == 0 ? 0 : -1;
+}
+
+
+
+// sweeps B+, bias and gm full scale of an ECC83 triode gm test, printing
+//  the card or the faults of every combination
+// usage: cardmatic --sweep [bPlusMin bPlusMax biasMin biasMax gmMin gmMax]
+static int sweepMain(int argc, char* argv[])
+{
+    SweepRanges ranges = {200, 260, -3.0, -1.0, 1000, 2000};
+
+    if (argc == 8)
+    {
+        ranges.bPlusMin = std::atoi(argv[2]);
+        ranges.bPlusMax = std::atoi(argv[3]);
+        ranges.biasMin = std::atof(argv[4]);
+        ranges.biasMax = std::atof(argv[5]);
+        ranges.umhoFSMin = std::atoi(argv[6]);
+        ranges.umhoFSMax = std::atoi(argv[7]);
+    }
+
+    Tube ECC83("ECC83", ECC83_PINOUT, "B9A");
+    CardReader pins;
+    ECC83.setSingleTubeSectionSwitches(pins, Tube::TRIODE, true, false);
+
+    TestParam base = TestParam();
+    base.heater = 12.6;
+    base.current = 1.2;
+    base.leakage = true;
+
+    ParameterSweep sweep;
+    if (!sweep.run(pins, TubeTests::TRIODE_TEST, base, ranges))
+    {
+        std::cout << "Invalid sweep ranges" << std::endl;
+        return -1;
+    }
+
+    sweep.print(std::cout);
+    std::cout << sweep.numValid() << " of " << sweep.getPoints().size() <<
+        " combinations valid" << std::endl;
+
+    return 0;
+}
 
 
 
@@ -20,6 +515,21 @@
 // TODO: write unit tests
 int main(int argc, char* argv[])
 {
+    if (argc == 2 && std::string(argv[1]) == "--check-decade")
+    {
+        return decadeCheck();
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--check-recipes")
+    {
+        return recipeCheck();
+    }
+
+    if ((argc == 2 || argc == 8) && std::string(argv[1]) == "--sweep")
+    {
+        return sweepMain(argc, argv);
+    }
+
     double heaterVolts = 6.3;
     unsigned int b_plus = 250;
     double current = 1.2;
@@ -29,12 +539,7 @@ int main(int argc, char* argv[])
     CardReader switches;
     TubeTests tests;
     
-    Tube ECC83(
-        "ECC83", 
-        ECC83.PIN_2, ECC83.PIN_3, '\0', '\0', ECC83.PIN_1, '\0', 
-        ECC83.PIN_4, ECC83.PIN_5, ECC83.PIN_9, 
-        "B9A"
-    );
+    Tube ECC83("ECC83", ECC83_PINOUT, "B9A");
 	
 	if ( ECC83.tubePinsAreValid() != ECC83.TUBE_PINS_OK )
 	{
@@ -43,7 +548,6 @@ int main(int argc, char* argv[])
 	}
 	
 	
-    ECC83.appendTubeSection(ECC83.PIN_7, ECC83.PIN_8, '\0', '\0', ECC83.PIN_6, '\0');
     ECC83.setTwinTubeSectionSwitches(
         tests.getClosedSwitches(), 
         ECC83.TRIODE, 